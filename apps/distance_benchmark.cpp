@@ -0,0 +1,88 @@
+//
+// Compares the distances of all circles to a trajectory via
+// `Trajectory::distance` against the kernels of
+// `utils::distances_to_polyline` on the circles as arrays.
+//
+#include "cetsp/common.h"
+#include "cetsp/utils/geometry.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace cetsp;
+
+template <typename F> double measure_us(const int repetitions, F &&f) {
+  using namespace std::chrono;
+  const auto start = high_resolution_clock::now();
+  for (int i = 0; i < repetitions; ++i) {
+    f();
+  }
+  const auto end = high_resolution_clock::now();
+  return duration<double, std::micro>(end - start).count() / repetitions;
+}
+
+int main() {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coord(0, 1000), radius(1, 10);
+  const int repetitions = 200;
+  std::cout << "Default kernel: "
+            << utils::get_name(utils::get_distance_kernel()) << std::endl;
+  std::cout << "n\tm\tkernel\ttime [us]\tspeedup\tmax abs. diff" << std::endl;
+  for (size_t n : {200, 2000, 20000}) {
+    std::vector<Circle> circles;
+    std::vector<double> x, y, r;
+    for (size_t i = 0; i < n; ++i) {
+      circles.emplace_back(Point{coord(rng), coord(rng)}, radius(rng));
+      x.push_back(circles.back().center.x);
+      y.push_back(circles.back().center.y);
+      r.push_back(circles.back().radius);
+    }
+    for (size_t m : {10, 50, 200}) {
+      // a noisy tour around the center
+      std::uniform_real_distribution<double> noise(-50, 50);
+      std::vector<Point> points;
+      std::vector<double> px, py;
+      for (size_t j = 0; j <= m; ++j) {
+        const double angle = 2 * M_PI * j / m;
+        points.emplace_back(500 + 400 * std::cos(angle) + noise(rng),
+                            500 + 400 * std::sin(angle) + noise(rng));
+      }
+      points.back() = points.front();
+      for (const auto &p : points) {
+        px.push_back(p.x);
+        py.push_back(p.y);
+      }
+      Trajectory trajectory(points);
+      std::vector<double> reference(n);
+      const double t_trajectory = measure_us(repetitions, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+          reference[i] = trajectory.distance(circles[i]);
+        }
+      });
+      std::cout << n << "\t" << m << "\tTrajectory::distance\t"
+                << t_trajectory << "\t1\t0" << std::endl;
+      for (auto kernel :
+           {utils::DistanceKernel::SCALAR, utils::DistanceKernel::AVX2,
+            utils::DistanceKernel::AVX512}) {
+        if (!utils::is_supported(kernel)) {
+          continue;
+        }
+        std::vector<double> out(n);
+        const double t_kernel = measure_us(repetitions, [&]() {
+          utils::distances_to_polyline(x.data(), y.data(), r.data(), n,
+                                       px.data(), py.data(), px.size(),
+                                       out.data(), kernel);
+        });
+        double max_diff = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+          max_diff = std::max(max_diff, std::abs(out[i] - reference[i]));
+        }
+        std::cout << n << "\t" << m << "\t" << utils::get_name(kernel) << "\t"
+                  << t_kernel << "\t" << t_trajectory / t_kernel << "\t"
+                  << max_diff << std::endl;
+      }
+    }
+  }
+  return 0;
+}
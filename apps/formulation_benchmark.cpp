@@ -0,0 +1,77 @@
+//
+// Compares the standard Gurobi formulation of the trajectory SOCP against
+// the lean one, i.e., the size of the model, the time to build it, the time
+// to solve it, and the difference of the resulting trajectories.
+//
+#include "cetsp/soc.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace cetsp;
+
+std::vector<Circle> random_sequence(std::mt19937 &rng, unsigned n) {
+  // circles on a noisy circle, such that the order is reasonable
+  std::uniform_real_distribution<double> noise(-1.0, 1.0);
+  std::uniform_real_distribution<double> radius(0.1, 2.0);
+  std::vector<Circle> circles;
+  for (unsigned i = 0; i < n; ++i) {
+    const double angle = 2 * M_PI * i / n;
+    circles.emplace_back(Point{50 * std::cos(angle) + 5 * noise(rng),
+                               50 * std::sin(angle) + 5 * noise(rng)},
+                         radius(rng));
+  }
+  return circles;
+}
+
+int main() {
+#ifdef CETSP_WITHOUT_GUROBI
+  std::cout << "This benchmark needs Gurobi." << std::endl;
+#else
+  using Formulation = GurobiTrajectorySolver::Formulation;
+  std::mt19937 rng(0);
+  const int repetitions = 50;
+  std::cout << "n\tmode\tformulation\tvars\tconstrs\tqconstrs\tbuild "
+               "[us]\tsolve [us]\tmax rel. diff\tspanning diffs"
+            << std::endl;
+  // warm up the environment
+  details::measure_trajectory_model(random_sequence(rng, 10), false,
+                                    Formulation::STANDARD);
+  for (unsigned n : {10, 50, 200}) {
+    for (bool path : {false, true}) {
+      std::vector<std::vector<Circle>> sequences;
+      for (int i = 0; i < repetitions; ++i) {
+        sequences.push_back(random_sequence(rng, n));
+      }
+      std::vector<details::TrajectoryModelMeasurement> standard;
+      for (const auto &seq : sequences) {
+        standard.push_back(
+            details::measure_trajectory_model(seq, path, Formulation::STANDARD));
+      }
+      for (auto formulation : {Formulation::STANDARD, Formulation::LEAN}) {
+        double build_time = 0.0, solve_time = 0.0, max_diff = 0.0;
+        int spanning_diffs = 0;
+        details::TrajectoryModelMeasurement last{};
+        for (int i = 0; i < repetitions; ++i) {
+          last = details::measure_trajectory_model(sequences[i], path,
+                                                   formulation);
+          build_time += last.build_time_us;
+          solve_time += last.solve_time_us;
+          const double reference = standard[i].solution.first.length();
+          max_diff = std::max(
+              max_diff,
+              std::abs(last.solution.first.length() - reference) / reference);
+          spanning_diffs += last.solution.second != standard[i].solution.second;
+        }
+        std::cout << n << "\t" << (path ? "path" : "tour") << "\t"
+                  << (formulation == Formulation::LEAN ? "lean" : "standard")
+                  << "\t" << last.num_vars << "\t" << last.num_constrs << "\t"
+                  << last.num_qconstrs << "\t" << build_time / repetitions
+                  << "\t" << solve_time / repetitions << "\t" << max_diff
+                  << "\t" << spanning_diffs << std::endl;
+      }
+    }
+  }
+#endif
+  return 0;
+}
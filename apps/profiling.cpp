@@ -2,8 +2,10 @@
 // Created by Dominik Krupke on 09.01.23.
 //
 #include "cetsp/bnb.h"
-#include "cetsp/details/missing_disks_lb.h"
 #include "cetsp/heuristics.h"
+#ifndef CETSP_WITHOUT_GUROBI
+#include "cetsp/details/missing_disks_lb.h"
+#endif
 
 int main() {
   using namespace cetsp;
@@ -24,7 +26,9 @@ int main() {
   BranchAndBoundAlgorithm baba(&instance, rns->get_root_node(instance),
                                *branching_strategy, *search_strategy);
   auto initial_solution = compute_tour_by_2opt(instance);
+#ifndef CETSP_WITHOUT_GUROBI
   baba.add_node_callback(std::make_unique<LowerBoundImprovingCallback<ExactInsertionCostCalculator>>(instance));
+#endif
   baba.add_upper_bound(initial_solution);
   baba.optimize(timelimit);
   std::cout << "Solution value " << baba.get_solution()->obj() << std::endl;
@@ -0,0 +1,141 @@
+//
+// Compares the latency of the trajectory computation with pooled models
+// against building a new model for every call and against the native solver.
+// The second table compares the fast paths for small and degenerate
+// sequences against the solvers.
+//
+#include "cetsp/soc.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace cetsp;
+
+std::vector<Circle> random_sequence(std::mt19937 &rng, unsigned n) {
+  // circles on a noisy circle, such that the order is reasonable
+  std::uniform_real_distribution<double> noise(-1.0, 1.0);
+  std::uniform_real_distribution<double> radius(0.1, 2.0);
+  std::vector<Circle> circles;
+  for (unsigned i = 0; i < n; ++i) {
+    const double angle = 2 * M_PI * i / n;
+    circles.emplace_back(Point{50 * std::cos(angle) + 5 * noise(rng),
+                               50 * std::sin(angle) + 5 * noise(rng)},
+                         radius(rng));
+  }
+  return circles;
+}
+
+std::vector<Circle> without_radii(std::vector<Circle> circles) {
+  for (auto &c : circles) {
+    c.radius = 0.0;
+  }
+  return circles;
+}
+
+template <typename F>
+double measure_us(const std::vector<std::vector<Circle>> &sequences, bool path,
+                  F &&f) {
+  using namespace std::chrono;
+  const auto start = high_resolution_clock::now();
+  for (const auto &seq : sequences) {
+    f(seq, path);
+  }
+  const auto end = high_resolution_clock::now();
+  return static_cast<double>(duration_cast<microseconds>(end - start).count()) /
+         sequences.size();
+}
+
+int main() {
+  std::mt19937 rng(0);
+  const int repetitions = 200;
+  NativeTrajectorySolver native;
+  auto solve_native = [&native](const std::vector<Circle> &seq, bool path) {
+    return native.solve(seq, path);
+  };
+#ifndef CETSP_WITHOUT_GUROBI
+  GurobiTrajectorySolver gurobi;
+  auto solve_pooled = [&gurobi](const std::vector<Circle> &seq, bool path) {
+    return gurobi.solve(seq, path);
+  };
+  std::cout << "n\tmode\tnew model [us]\tpooled [us]\tspeedup\tnative "
+               "[us]\tspeedup\tmax rel. diff"
+            << std::endl;
+#else
+  std::cout << "n\tmode\tnative [us]" << std::endl;
+#endif
+  for (unsigned n : {3, 5, 10, 20, 30, 50, 100}) {
+    for (bool path : {false, true}) {
+      std::vector<std::vector<Circle>> sequences;
+      for (int i = 0; i < repetitions; ++i) {
+        sequences.push_back(random_sequence(rng, n));
+      }
+      const auto t_native = measure_us(sequences, path, solve_native);
+#ifndef CETSP_WITHOUT_GUROBI
+      // warm up the environment and the pool
+      solve_pooled(sequences.front(), path);
+      const auto t_new = measure_us(
+          sequences, path, [](const std::vector<Circle> &seq, bool path) {
+            return details::compute_trajectory_with_new_model(seq, path);
+          });
+      const auto t_pooled = measure_us(sequences, path, solve_pooled);
+      double max_diff = 0.0;
+      for (const auto &seq : sequences) {
+        const auto l_gurobi = solve_pooled(seq, path).first.length();
+        const auto l_native = solve_native(seq, path).first.length();
+        max_diff = std::max(max_diff,
+                            std::abs(l_gurobi - l_native) / l_gurobi);
+      }
+      std::cout << n << "\t" << (path ? "path" : "tour") << "\t" << t_new
+                << "\t" << t_pooled << "\t" << t_new / t_pooled << "\t"
+                << t_native << "\t" << t_pooled / t_native << "\t"
+                << max_diff << std::endl;
+#else
+      std::cout << n << "\t" << (path ? "path" : "tour") << "\t" << t_native
+                << std::endl;
+#endif
+    }
+  }
+
+  auto solve_dispatched = [](const std::vector<Circle> &seq, bool path) {
+    return compute_trajectory_with_information(seq, path);
+  };
+  std::cout << std::endl
+            << "n\tradii\tmode\tfast path [us]\tnative [us]\tspeedup";
+#ifndef CETSP_WITHOUT_GUROBI
+  std::cout << "\tpooled [us]\tspeedup";
+#endif
+  std::cout << "\tmax rel. diff" << std::endl;
+  const int small_repetitions = 20000;
+  for (unsigned n : {1, 2, 3, 10, 50}) {
+    for (bool radii : {true, false}) {
+      if (n > 3 && radii) {
+        continue; // no fast path
+      }
+      for (bool path : {false, true}) {
+        std::vector<std::vector<Circle>> sequences;
+        for (int i = 0; i < small_repetitions; ++i) {
+          auto seq = random_sequence(rng, n);
+          sequences.push_back(radii ? seq : without_radii(seq));
+        }
+        const auto t_fast = measure_us(sequences, path, solve_dispatched);
+        const auto t_native = measure_us(sequences, path, solve_native);
+        double max_diff = 0.0;
+        for (size_t i = 0; i < sequences.size(); i += 100) {
+          const auto l_fast = solve_dispatched(sequences[i], path).first.length();
+          const auto l_native = solve_native(sequences[i], path).first.length();
+          max_diff = std::max(max_diff, std::abs(l_fast - l_native) /
+                                            std::max(l_native, 1e-9));
+        }
+        std::cout << n << "\t" << (radii ? "yes" : "no") << "\t"
+                  << (path ? "path" : "tour") << "\t" << t_fast << "\t"
+                  << t_native << "\t" << t_native / t_fast;
+#ifndef CETSP_WITHOUT_GUROBI
+        const auto t_pooled = measure_us(sequences, path, solve_pooled);
+        std::cout << "\t" << t_pooled << "\t" << t_pooled / t_fast;
+#endif
+        std::cout << "\t" << max_diff << std::endl;
+      }
+    }
+  }
+}
@@ -0,0 +1,54 @@
+//
+// Measures the latency from spawning a few tasks until all of them are done,
+// for the persistent thread pool and for creating threads for every batch,
+// as it was done for the child evaluation before.
+//
+#include "cetsp/utils/thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace cetsp;
+
+template <typename F> double measure_us(int repetitions, F &&f) {
+  using namespace std::chrono;
+  const auto start = high_resolution_clock::now();
+  for (int i = 0; i < repetitions; ++i) {
+    f();
+  }
+  const auto end = high_resolution_clock::now();
+  return static_cast<double>(duration_cast<nanoseconds>(end - start).count()) /
+         (1000.0 * repetitions);
+}
+
+int main() {
+  const int repetitions = 20000;
+  std::cout << "threads\ttasks\tnew threads [us]\tpool [us]\tspeedup"
+            << std::endl;
+  for (size_t num_threads : {2, 4, 8}) {
+    utils::ThreadPool pool(num_threads - 1);
+    for (size_t num_tasks : {2, 4, 8, 16}) {
+      std::atomic<size_t> counter{0};
+      auto task = [&counter](size_t) { ++counter; };
+      const auto t_threads = measure_us(repetitions, [&]() {
+        std::vector<std::thread> threads;
+        for (size_t offset = 0; offset < num_threads; ++offset) {
+          threads.emplace_back([&, offset]() {
+            for (auto i = offset; i < num_tasks; i += num_threads) {
+              task(i);
+            }
+          });
+        }
+        for (auto &thread : threads) {
+          thread.join();
+        }
+      });
+      const auto t_pool = measure_us(
+          repetitions, [&]() { pool.parallel_for(num_tasks, task); });
+      std::cout << num_threads << "\t" << num_tasks << "\t" << t_threads
+                << "\t" << t_pool << "\t" << t_threads / t_pool << std::endl;
+    }
+  }
+}
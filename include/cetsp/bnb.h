@@ -7,13 +7,20 @@
 #ifndef CETSP_BNB_H
 #define CETSP_BNB_H
 #include "cetsp/callbacks.h"
+#include "cetsp/details/open_node_budget.h"
 #include "cetsp/details/solution_pool.h"
+#include "cetsp/details/work_stealing_queues.h"
 #include "cetsp/strategies/branching_strategy.h"
 #include "cetsp/strategies/root_node_strategy.h"
 #include "cetsp/strategies/search_strategy.h"
 #include "cetsp/utils/timer.h"
 #include "node.h"
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
 namespace cetsp {
 
 class BranchAndBoundAlgorithm {
@@ -29,6 +36,7 @@ public:
         branching_strategy(branching_strategy) {
     branching_strategy.setup(instance, root, &solution_pool);
     search_strategy.init(root);
+    root->track_lower_bound(&lower_bound_tracker);
   }
 
   void add_node_callback(std::unique_ptr<B2BNodeCallback> &&callback) {
@@ -54,17 +62,33 @@ public:
    * to the optimum.
    * @param lb The lower bound.
    */
-  void add_lower_bound(double lb) { root->add_lower_bound(lb); }
+  void add_lower_bound(double lb) {
+    root->add_lower_bound(lb);
+    lower_bound_tracker.add_lower_bound(lb);
+  }
+
+  /**
+   * Limits the memory of the relaxed solutions of the open nodes. If it is
+   * exceeded, the relaxed solutions of the open nodes with the highest lower
+   * bounds are freed and recomputed when the nodes are explored. Only used
+   * by the sequential search.
+   * @param bytes The (estimated) memory in bytes. Zero means no limit.
+   */
+  void set_memory_budget(size_t bytes) {
+    open_node_budget.set_memory_budget(bytes);
+  }
 
   /**
    * Returns the current best known upper bound.
    */
   double get_upper_bound() { return solution_pool.get_upper_bound(); }
   /**
-   * Returns the current best known lower bound.
+   * Returns the current best known lower bound. It is the minimum over the
+   * open leaves, which is maintained in O(log n) per change, so this does
+   * not need to walk the tree.
    * @return
    */
-  double get_lower_bound() { return root->get_lower_bound(); }
+  double get_lower_bound() { return lower_bound_tracker.get_lower_bound(); }
 
   /**
    * Returns the currently best solution, if one exists.
@@ -88,6 +112,7 @@ public:
       visit_node(next, gap);
       auto lb = get_lower_bound();
       auto ub = get_upper_bound();
+      purge_if_improved(ub, gap, nullptr);
       print_iteration_stats(verbose, lb, ub, timer.seconds());
       if (ub <= (1 + gap) * lb) { // check termination criterion
         break;
@@ -101,15 +126,138 @@ public:
     print_final_stats(verbose);
   }
 
+  /**
+   * Like `optimize` but explores the tree with multiple workers in parallel.
+   * Every worker searches depth first in its own part of the tree and steals
+   * open nodes from the others when it runs out of work. The search strategy
+   * is not used in this mode. The callbacks are called by one worker at a
+   * time, but must not modify the instance. Hence, lazy constraints are not
+   * supported and adding one throws a `std::logic_error`, use `optimize`
+   * for them. An exception of a worker stops the search and is rethrown.
+   * @param timelimit_s The timelimit in seconds, after which it aborts.
+   * @param num_workers The number of threads exploring the tree.
+   * @param gap Allowed optimality gap.
+   * @param verbose Defines if you want to see a progress log.
+   */
+  void optimize_parallel(int timelimit_s, size_t num_workers,
+                         double gap = 0.01, bool verbose = true) {
+    if (num_workers <= 1) {
+      optimize(timelimit_s, gap, verbose);
+      return;
+    }
+    print_start_stats(verbose);
+    parallel_search = true;
+    utils::Timer timer(timelimit_s);
+    details::WorkStealingQueues queues(num_workers);
+    std::atomic<bool> stop{false};
+    std::exception_ptr error; // of the first failed worker
+    root->get_lower_bound(); // evaluate the root before the workers start
+    queues.push(0, root);
+    auto work = [&](size_t worker) {
+      try {
+        while (!stop && !queues.finished()) {
+          auto node = queues.pop(worker);
+          if (!node) {
+            std::this_thread::yield(); // wait for other workers to branch
+            continue;
+          }
+          visit_node(node, gap);
+          push_children(queues, worker, *node);
+          queues.done();
+          auto lb = get_lower_bound();
+          auto ub = get_upper_bound();
+          purge_if_improved(ub, gap, &queues);
+          {
+            std::lock_guard<std::mutex> lock(print_mutex);
+            print_iteration_stats(verbose, lb, ub, timer.seconds());
+          }
+          if (ub <= (1 + gap) * lb) { // check termination criterion
+            stop = true;
+          } else if (timer.timeout()) {
+            if (!stop.exchange(true)) {
+              print_timeout(verbose);
+            }
+          }
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(print_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        stop = true;
+      }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < num_workers; ++i) {
+      workers.emplace_back(work, i);
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    parallel_search = false;
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    print_final_stats(verbose);
+  }
+
   std::unordered_map<std::string, std::string> get_statistics() const {
     std::unordered_map<std::string, std::string> stats;
-    stats["num_iterations"] = std::to_string(num_iterations);
-    stats["num_branches"] = std::to_string(num_branches);
-    stats["num_explored"] = std::to_string(num_explored);
+    stats["num_iterations"] = std::to_string(num_iterations.load());
+    stats["num_branches"] = std::to_string(num_branches.load());
+    stats["num_explored"] = std::to_string(num_explored.load());
+    stats["compacted_bytes"] = std::to_string(compacted_bytes.load());
+    stats["num_refinements"] = std::to_string(num_refinements.load());
+    stats["purged_nodes"] = std::to_string(purged_nodes.load());
+    stats["purged_bytes"] = std::to_string(purged_bytes.load());
+    branching_strategy.add_statistics(stats);
+    open_node_budget.add_statistics(stats);
     return stats;
   }
 
 private:
+  /**
+   * Pushes the children of a node that has just been branched, such that
+   * the most promising child is explored next.
+   */
+  void push_children(details::WorkStealingQueues &queues, size_t worker,
+                     Node &node) {
+    auto children = node.get_children();
+    std::sort(children.begin(), children.end(),
+              [](std::shared_ptr<Node> &a, std::shared_ptr<Node> &b) {
+                const auto lb_a = a->get_lower_bound();
+                const auto lb_b = b->get_lower_bound();
+                if (std::abs(lb_a - lb_b) < 0.001) { // approx equal
+                  return a->get_objective_estimate() >
+                         b->get_objective_estimate();
+                }
+                return lb_a > lb_b;
+              });
+    for (auto &child : children) {
+      queues.push(worker, child);
+    }
+  }
+
+  /**
+   * If the upper bound has improved, the open nodes that are dominated by it
+   * are pruned and dropped at once, instead of waiting for the search to
+   * reach them.
+   * @param queues The open nodes of the parallel search, or nullptr for the
+   * search strategy.
+   */
+  void purge_if_improved(const double ub, const double gap,
+                         details::WorkStealingQueues *queues) {
+    if (!(ub < last_purge_ub.exchange(ub))) {
+      return;
+    }
+    const double limit = (1.0 - gap) * ub;
+    const auto stats = queues != nullptr
+                           ? queues->purge(limit)
+                           : search_strategy.notify_of_upper_bound(limit);
+    purged_nodes += stats.num_nodes;
+    purged_bytes += stats.bytes_freed;
+  }
+
   void print_timeout(bool verbose) const {
     if (verbose) {
       std::cout << "Timeout." << std::endl;
@@ -168,6 +316,24 @@ private:
     return false;
   }
 
+  /**
+   * A loose relaxed solution suffices to branch the node if even its
+   * objective is below the upper bound. Otherwise, only the exact solution
+   * decides if the node can be pruned.
+   * @return True iff the node was pruned after the refinement.
+   */
+  bool refine_if_close_to_ub(std::shared_ptr<Node> &node, const double gap) {
+    const auto &solution = node->get_relaxed_solution();
+    if (!solution.is_computed() || solution.is_exact() ||
+        solution.obj() < (1.0 - gap) * solution_pool.get_upper_bound()) {
+      return false;
+    }
+    if (node->refine()) {
+      ++num_refinements;
+    }
+    return prune_if_above_ub(node, gap);
+  }
+
   /**
    * Executes a step/node exploration in the BnB-algorithm.
    * @return
@@ -178,15 +344,39 @@ private:
     if (prune_if_above_ub(node, gap)) {
       return;
     }
+    if (node->is_deferred()) {
+      // The relaxed solution is only computed now that the node is selected.
+      branching_strategy.evaluate_deferred(*node);
+      if (prune_if_above_ub(node, gap) ||
+          (!parallel_search && search_strategy.notify_of_evaluation(node))) {
+        return;
+      }
+    }
+    if (refine_if_close_to_ub(node, gap)) {
+      return;
+    }
     // Explore  node.
     num_explored += 1;
-    EventContext context{node, root, instance, &solution_pool, num_iterations};
-    for (auto &callback : node_callbacks) {
-      callback->on_entering_node(context);
+    if (!parallel_search) {
+      open_node_budget.on_explore(*node);
+    }
+    EventContext context{node,
+                         root,
+                         instance,
+                         &solution_pool,
+                         num_iterations,
+                         branching_strategy.get_thread_pool(),
+                         parallel_search};
+    {
+      std::lock_guard<std::mutex> lock(callback_mutex);
+      for (auto &callback : node_callbacks) {
+        callback->on_entering_node(context);
+      }
     }
     if (!node->is_pruned()) { // the user callback may have pruned the node
       explore_node(node, context, gap);
     }
+    std::lock_guard<std::mutex> lock(callback_mutex);
     for (auto &callback : node_callbacks) {
       callback->on_leaving_node(context);
     }
@@ -200,6 +390,11 @@ private:
    */
   void explore_node(std::shared_ptr<Node> &node, EventContext &context,
                     const double gap) {
+    // Only exact trajectories enter the solution pool. The refined
+    // trajectory may also turn out to be infeasible.
+    if (node->is_feasible() && node->refine()) {
+      ++num_refinements;
+    }
     add_lazy_constraints_if_feasible(node, context);
     if (node->is_feasible()) {
       process_feasible_node(node, context);
@@ -216,6 +411,7 @@ private:
     if (node->is_feasible()) {
       // If node is feasible, check lazy constraints (the user may decide
       // to add further circles, making it infeasible again).
+      std::lock_guard<std::mutex> lock(callback_mutex);
       for (auto &callback : node_callbacks) {
         callback->add_lazy_constraints(context);
         if (!node->is_feasible()) {
@@ -230,19 +426,43 @@ private:
   void branch_node(std::shared_ptr<Node> &node) {
     if (branching_strategy.branch(*node)) {
       num_branches += 1;
-      search_strategy.notify_of_branch(*node);
+      if (!parallel_search) {
+        search_strategy.notify_of_branch(*node);
+        open_node_budget.add(node->get_children());
+      }
+      compact_node(*node);
     }
   }
 
-  void on_prune(Node &node) { search_strategy.notify_of_prune(node); }
+  /**
+   * The relaxed solution of a branched node is not needed anymore, as the
+   * bounds are propagated via the scalar bounds of the nodes. Freeing it
+   * keeps the memory of deep searches proportional to the open nodes.
+   */
+  void compact_node(Node &node) {
+    if (node.get_children().empty()) {
+      return; // pruned as it has no children
+    }
+    compacted_bytes += node.compact();
+  }
+
+  void on_prune(Node &node) {
+    if (!parallel_search) {
+      search_strategy.notify_of_prune(node);
+    }
+  }
 
   void process_feasible_node(std::shared_ptr<Node> &node,
                              EventContext &context) {
     solution_pool.add_solution(node->get_relaxed_solution());
-    search_strategy.notify_of_feasible(*(context.current_node));
+    node->retire_lower_bound();
+    if (!parallel_search) {
+      search_strategy.notify_of_feasible(*(context.current_node));
+    }
   }
 
   Instance *instance;              // the instance to solve.
+  details::LowerBoundTracker lower_bound_tracker; // minimum of the open leaves
   std::shared_ptr<Node> root;      // the root node to start the search with
   SearchStrategy &search_strategy; // will decide  which node to visit next
   std::vector<std::unique_ptr<B2BNodeCallback>>
@@ -250,9 +470,20 @@ private:
   BranchingStrategy &branching_strategy; // decides how to branch on a node, if
                                          // it is not yet feasible.
   SolutionPool solution_pool;            // Saves all solutions found so far.
-  int num_iterations = 0;                // how many nodes have been looked at
-  int num_explored = 0;                  // how many nodes have been explored
-  int num_branches = 0; // how many of those nodes have been branched upon
+  details::OpenNodeBudget open_node_budget; // frees relaxed solutions if the
+                                            // open nodes use too much memory
+  std::atomic<int> num_iterations{0};    // how many nodes have been looked at
+  std::atomic<int> num_explored{0};      // how many nodes have been explored
+  std::atomic<int> num_branches{0}; // how many of those nodes have been
+                                    // branched upon
+  std::atomic<size_t> compacted_bytes{0}; // freed by compacting branched nodes
+  std::atomic<size_t> num_refinements{0}; // exact re-solves of loose nodes
+  std::atomic<double> last_purge_ub{std::numeric_limits<double>::infinity()};
+  std::atomic<size_t> purged_nodes{0}; // pruned after the UB improved
+  std::atomic<size_t> purged_bytes{0};
+  bool parallel_search = false; // the workers replace the search strategy
+  std::mutex callback_mutex;    // the callbacks are not thread-safe
+  std::mutex print_mutex;
 };
 
 TEST_CASE("Branch and Bound  1") {
@@ -338,5 +569,116 @@ TEST_CASE("Branch and Bound Path") {
                                                     instance.end(), 0.001));
   CHECK(bnb.get_upper_bound() == doctest::Approx(42.0747));
 }
+
+TEST_CASE("Branch and Bound Memory Budget") {
+  Instance instance;
+  for (double x = 0; x <= 10; x += 2.0) {
+    for (double y = 0; y <= 10; y += 2.0) {
+      instance.push_back({{x, y}, 1});
+    }
+  }
+  instance.path = {{0, 0}, {0, 0}};
+  LongestEdgePlusFurthestCircle root_node_strategy{};
+  FarthestCircle branching_strategy;
+  DfsBfs search_strategy;
+  BranchAndBoundAlgorithm bnb(&instance,
+                              root_node_strategy.get_root_node(instance),
+                              branching_strategy, search_strategy);
+  bnb.set_memory_budget(1); // free every open node
+  bnb.optimize(30);
+  CHECK(bnb.get_upper_bound() == doctest::Approx(42.0747));
+  auto stats = bnb.get_statistics();
+  CHECK(std::stoi(stats["open_node_recomputations"]) > 0);
+  CHECK(std::stoul(stats["open_node_bytes_freed"]) > 0);
+}
+
+TEST_CASE("Branch and Bound Deferred Evaluation") {
+  Instance instance;
+  for (double x = 0; x <= 10; x += 2.0) {
+    for (double y = 0; y <= 10; y += 2.0) {
+      instance.push_back({{x, y}, 1});
+    }
+  }
+  instance.path = {{0, 0}, {0, 0}};
+  LongestEdgePlusFurthestCircle root_node_strategy{};
+  FarthestCircle branching_strategy;
+  branching_strategy.set_deferred_evaluation(true);
+  DfsBfs search_strategy;
+  BranchAndBoundAlgorithm bnb(&instance,
+                              root_node_strategy.get_root_node(instance),
+                              branching_strategy, search_strategy);
+  bnb.optimize(30, 0.0);
+  CHECK(bnb.get_upper_bound() == doctest::Approx(42.0747));
+  auto stats = bnb.get_statistics();
+  CHECK(std::stoul(stats["deferred_evaluations"]) > 0);
+  CHECK(std::stoul(stats["saved_socp_calls"]) > 0);
+}
+
+TEST_CASE("Branch and Bound Loose Evaluation") {
+  Instance instance;
+  for (double x = 0; x <= 10; x += 2.0) {
+    for (double y = 0; y <= 10; y += 2.0) {
+      instance.push_back({{x, y}, 1});
+    }
+  }
+  instance.path = {{0, 0}, {0, 0}};
+  auto solver = get_trajectory_solver();
+  set_trajectory_solver(std::make_shared<NativeTrajectorySolver>());
+  LongestEdgePlusFurthestCircle root_node_strategy{};
+  FarthestCircle branching_strategy;
+  branching_strategy.set_loose_evaluation(true);
+  DfsBfs search_strategy;
+  BranchAndBoundAlgorithm bnb(&instance,
+                              root_node_strategy.get_root_node(instance),
+                              branching_strategy, search_strategy);
+  bnb.optimize(30, 0.0);
+  CHECK(bnb.get_upper_bound() == doctest::Approx(42.0747));
+  CHECK(bnb.get_lower_bound() <= bnb.get_upper_bound() + 1e-6);
+  auto stats = bnb.get_statistics();
+  CHECK(std::stoul(stats["num_refinements"]) > 0);
+  set_trajectory_solver(solver);
+}
+
+TEST_CASE("Branch and Bound Incremental Evaluation") {
+  // The sequences stay short, but most children are still only evaluated
+  // around their inserted circle.
+  Instance instance;
+  for (int i = 0; i < 12; ++i) {
+    const double angle = 2 * M_PI * i / 12;
+    instance.push_back(
+        {{10 * std::cos(angle) + (i % 3), 10 * std::sin(angle)}, 0.5});
+  }
+  LongestEdgePlusFurthestCircle root_node_strategy{};
+  FarthestCircle branching_strategy;
+  CheapestChildDepthFirst search_strategy;
+  BranchAndBoundAlgorithm bnb(&instance,
+                              root_node_strategy.get_root_node(instance),
+                              branching_strategy, search_strategy);
+  bnb.optimize(30, 0.0);
+  CHECK(bnb.get_solution());
+  CHECK(bnb.get_solution()->get_trajectory().covers(instance.begin(),
+                                                    instance.end(), 0.001));
+  auto stats = bnb.get_statistics();
+  CHECK(std::stoul(stats["incremental_socps"]) > 0);
+}
+
+TEST_CASE("Branch and Bound Parallel") {
+  Instance instance;
+  for (double x = 0; x <= 10; x += 2.0) {
+    for (double y = 0; y <= 10; y += 2.0) {
+      instance.push_back({{x, y}, 1});
+    }
+  }
+  LongestEdgePlusFurthestCircle root_node_strategy{};
+  FarthestCircle branching_strategy;
+  CheapestChildDepthFirst search_strategy;
+  BranchAndBoundAlgorithm bnb(&instance,
+                              root_node_strategy.get_root_node(instance),
+                              branching_strategy, search_strategy);
+  bnb.optimize_parallel(30, 4, 0.0);
+  CHECK(bnb.get_solution());
+  CHECK(bnb.get_lower_bound() <= bnb.get_upper_bound() + 1e-6);
+  CHECK(bnb.get_upper_bound() <= 41);
+}
 } // namespace cetsp
 #endif // CETSP_BNB_H
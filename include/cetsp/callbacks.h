@@ -9,6 +9,7 @@
 #include "cetsp/strategies/branching_strategy.h"
 #include "cetsp/strategies/root_node_strategy.h"
 #include "cetsp/strategies/search_strategy.h"
+#include <stdexcept>
 namespace cetsp {
 
 struct EventContext {
@@ -21,12 +22,22 @@ struct EventContext {
   Instance *instance;                 //  The instance being solved.
   SolutionPool *solution_pool;        // The already found solutions.
   int num_iterations;                 // number of nodes already investigated.
+  utils::ThreadPool *thread_pool;     // For parallel work, may be nullptr.
+
+  bool parallel_search = false;       // The workers share the instance.
 
   /**
    * Add a lazy constraint. This has to be deterministic and
-   * be satisified by all already found solutions.
+   * be satisified by all already found solutions. Not supported
+   * by the parallel search, as the other workers read the instance.
    */
-  void add_lazy_circle(Circle &circle) { instance->add_circle(circle); }
+  void add_lazy_circle(Circle &circle) {
+    if (parallel_search) {
+      throw std::logic_error("Lazy constraints are not supported by the "
+                             "parallel search. Use `optimize` instead.");
+    }
+    instance->add_circle(circle);
+  }
 
   /**
    * Add a feasible solution. This may help to prune a lot
@@ -7,12 +7,20 @@
 #define CLOSE_ENOUGH_TSP_COMMON_H
 #include "cetsp/details/cgal_kernel.h"
 #include "cetsp/utils/geometry.h"
+#include "cetsp/utils/segment_bvh.h"
 #include "doctest/doctest.h"
 #include <CGAL/squared_distance_2.h> //for 2D functions
+#include <atomic>
 #include <cmath>
+#include <memory>
+#include <mutex>
 #include <utility>
 
 namespace cetsp {
+namespace details {
+class CircleGrid;
+}
+
 class Point {
   /**
    * Represents a single coordinate.
@@ -115,10 +123,20 @@ public:
     revision += 1;
   }
 
+  /**
+   * A spatial index over the circles for the coverage and farthest-circle
+   * queries. It is built on the first call and rebuilt if circles have been
+   * added since.
+   */
+  std::shared_ptr<const details::CircleGrid> get_circle_grid() const;
+
   std::optional<std::pair<Point, Point>> path;
   int revision =
       0; // actually the size  should already say enough about  the revision.
   double eps = 0.01;
+
+private:
+  mutable std::shared_ptr<const details::CircleGrid> circle_grid;
 };
 
 class Trajectory {
@@ -129,6 +147,28 @@ public:
   Trajectory() = default;
   explicit Trajectory(std::vector<Point> points) : points{std::move(points)} {}
 
+  // The copies share the BVH, if it has already been built.
+  Trajectory(const Trajectory &other)
+      : points{other.points}, _length{other._length} {
+    share_bvh(other);
+  }
+  Trajectory(Trajectory &&other) noexcept
+      : points{std::move(other.points)}, _length{other._length} {
+    share_bvh(other);
+  }
+  Trajectory &operator=(const Trajectory &other) {
+    points = other.points;
+    _length = other._length;
+    share_bvh(other);
+    return *this;
+  }
+  Trajectory &operator=(Trajectory &&other) noexcept {
+    points = std::move(other.points);
+    _length = other._length;
+    share_bvh(other);
+    return *this;
+  }
+
   bool is_tour() const { return points[0] == points[points.size() - 1]; }
 
   /**
@@ -154,6 +194,9 @@ public:
   }
 
   double distance(const Circle &circle) const {
+    if (const auto *bvh = _bvh.load(std::memory_order_acquire)) {
+      return bvh->distance(circle.center.x, circle.center.y) - circle.radius;
+    }
     double min_dist = std::numeric_limits<double>::infinity();
     if (points.size() == 1) {
       details::cgPoint tp(points[0].x, points[0].y);
@@ -171,6 +214,55 @@ public:
     return min_dist - circle.radius;
   }
 
+  /**
+   * The distances of many circles, see `distance`. Builds the BVH over the
+   * segments if it pays off.
+   */
+  std::vector<double> distances(const std::vector<Circle> &circles) const {
+    if (circles.size() >= BVH_MIN_QUERIES) {
+      get_segment_bvh();
+    }
+    std::vector<double> result;
+    result.reserve(circles.size());
+    for (const auto &circle : circles) {
+      result.push_back(distance(circle));
+    }
+    return result;
+  }
+
+  /**
+   * The BVH over the segments, which is built on the first call and used by
+   * `distance` from then on. Only worth it for many queries on a trajectory
+   * with more than a few segments. Returns nullptr for short trajectories,
+   * which are scanned linearly.
+   */
+  const utils::SegmentBvh *get_segment_bvh() const {
+    if (points.size() < BVH_MIN_SEGMENTS + 1) {
+      return nullptr;
+    }
+    if (const auto *bvh = _bvh.load(std::memory_order_acquire)) {
+      return bvh;
+    }
+    // Concurrent calls may both build the BVH, but only one is kept.
+    std::vector<double> px, py;
+    px.reserve(points.size());
+    py.reserve(points.size());
+    for (const auto &p : points) {
+      px.push_back(p.x);
+      py.push_back(p.y);
+    }
+    auto bvh = std::make_shared<const utils::SegmentBvh>(px.data(), py.data(),
+                                                         px.size());
+    static std::mutex publish_mutex;
+    std::lock_guard<std::mutex> lock(publish_mutex);
+    if (const auto *published = _bvh.load(std::memory_order_relaxed)) {
+      return published;
+    }
+    _bvh_owner = std::move(bvh);
+    _bvh.store(_bvh_owner.get(), std::memory_order_release);
+    return _bvh_owner.get();
+  }
+
   double length() const {
     if (!_length) {
       double l = 0;
@@ -204,6 +296,9 @@ public:
   template <typename It>
   [[nodiscard]] auto covers(It begin, It end,
                             double FEASIBILITY_TOLERANCE = 0.0) const -> bool {
+    if (static_cast<size_t>(std::distance(begin, end)) >= BVH_MIN_QUERIES) {
+      get_segment_bvh();
+    }
     return std::all_of(begin, end, [&](const Circle &c) {
       return this->covers(c, FEASIBILITY_TOLERANCE);
     });
@@ -229,7 +324,21 @@ private:
     }
     return points_;
   }
+  void share_bvh(const Trajectory &other) {
+    // The owner is set before the BVH is published and never changes
+    // afterwards, so it can be read without the lock.
+    const auto *bvh = other._bvh.load(std::memory_order_acquire);
+    _bvh_owner = bvh ? other._bvh_owner : nullptr;
+    _bvh.store(bvh, std::memory_order_release);
+  }
+
+  // Below, the linear scan is as fast as the BVH.
+  static constexpr size_t BVH_MIN_SEGMENTS = 32;
+  static constexpr size_t BVH_MIN_QUERIES = 32;
   mutable std::optional<double> _length;
+  // `distance` only reads the raw pointer, so the queries never lock.
+  mutable std::shared_ptr<const utils::SegmentBvh> _bvh_owner;
+  mutable std::atomic<const utils::SegmentBvh *> _bvh{nullptr};
 };
 
 TEST_CASE("Trajectory") {
@@ -241,6 +350,31 @@ TEST_CASE("Trajectory") {
   CHECK(traj.length() == 10.0);
 }
 
+TEST_CASE("Trajectory Distances") {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coord(0, 100), radius(0, 3);
+  std::vector<Point> points;
+  for (int j = 0; j < 50; ++j) {
+    points.emplace_back(coord(rng), coord(rng));
+  }
+  points.push_back(points.front());
+  std::vector<Circle> circles;
+  for (int i = 0; i < 100; ++i) {
+    circles.emplace_back(Point{coord(rng), coord(rng)}, radius(rng));
+  }
+  const Trajectory traj(points);
+  std::vector<double> expected;
+  for (const auto &circle : circles) {
+    expected.push_back(traj.distance(circle)); // without the BVH
+  }
+  CHECK(traj.distances(circles) == expected);
+  REQUIRE(traj.get_segment_bvh() != nullptr);
+  CHECK(traj.distance(circles[0]) == expected[0]); // with the BVH
+  const Trajectory copy = traj;
+  CHECK(copy.get_segment_bvh() == traj.get_segment_bvh());
+  CHECK(Trajectory({points[0], points[1]}).get_segment_bvh() == nullptr);
+}
+
 TEST_CASE("Trajectory Sub") {
   Trajectory traj{{{0, 0}, {5, 0}, {5, 5}, {0, 5}, {0, 0}}};
   CHECK(traj.is_tour());
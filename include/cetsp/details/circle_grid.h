@@ -0,0 +1,268 @@
+/**
+ * Checking which circles a trajectory covers and which circle is the
+ * farthest from it needs the distance of every circle to every segment,
+ * i.e., O(n*m) per node. For large instances, this is the most expensive
+ * part of a node after the SOCP.
+ *
+ * The grid is a static spatial index over the circles of the instance. Every
+ * circle is registered in all cells overlapped by its bounding box, such that
+ * the circles close to a segment can be found by only walking the cells
+ * along the segment. For the farthest circle, the cells are combined to a
+ * pyramid of blocks, each knowing the bounding box of the centers of its
+ * circles. The distance of the box's center to the trajectory gives an upper
+ * bound for the distances of the circles in the block. The blocks are
+ * refined best-first by this bound, until no remaining block can contain a
+ * farther circle than the farthest one found. Only the circles of the
+ * refined cells are evaluated.
+ *
+ * The grid keeps the circles as arrays of the coordinates and radii, such
+ * that the distances are computed with the vectorized kernel of
+ * `utils::distances_to_polyline`. It is built once per instance, see
+ * `Instance::get_circle_grid`.
+ */
+#ifndef CETSP_CIRCLE_GRID_H
+#define CETSP_CIRCLE_GRID_H
+#include "cetsp/common.h"
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace cetsp::details {
+class CircleGrid {
+public:
+  /**
+   * A segment of a trajectory that covers a circle.
+   */
+  struct Coverage {
+    unsigned circle;
+    unsigned segment; // a single point is the segment 0
+    double distance;
+  };
+
+  /**
+   * @param circles The circles of the instance.
+   * @param extra_points Further points to be within the grid, e.g., the end
+   * points of a path.
+   */
+  explicit CircleGrid(const std::vector<Circle> &circles,
+                      const std::vector<Point> &extra_points = {});
+
+  /**
+   * The number of circles the grid has been built for.
+   */
+  [[nodiscard]] size_t size() const { return x.size(); }
+
+  /**
+   * Writes the distances of the circles [begin, end) to the trajectory to
+   * `out`.
+   */
+  void compute_distances(const Trajectory &trajectory, size_t begin,
+                         size_t end, double *out) const;
+
+  /**
+   * Sets `covered[i]` for every circle `i` whose distance to the trajectory
+   * is at most `tolerance`. This is exactly
+   * `trajectory.distance(circle) <= tolerance`, but only the circles close to
+   * the trajectory are checked. `covered` has an entry for every circle.
+   */
+  void mark_covered(const Trajectory &trajectory, double tolerance,
+                    char *covered) const;
+
+  /**
+   * Every pair of a circle and a segment of the trajectory with a distance of
+   * at most `tolerance`, see `mark_covered`. Sorted by the segment.
+   */
+  [[nodiscard]] std::vector<Coverage>
+  compute_coverage(const Trajectory &trajectory, double tolerance) const;
+
+  /**
+   * The circle with the largest distance to the trajectory, skipping the
+   * circles `i` with `excluded[i]`. The distances are exactly those of
+   * `Trajectory::distance` and ties are broken by the smaller index, as with
+   * `std::max_element` over all distances.
+   * @return The index of the circle and its distance, or nothing if all
+   * circles are excluded.
+   */
+  [[nodiscard]] std::optional<std::pair<int, double>>
+  farthest(const Trajectory &trajectory,
+           const std::vector<char> &excluded) const;
+
+private:
+  [[nodiscard]] int column_of(double x) const;
+  [[nodiscard]] int row_of(double y) const;
+
+  /**
+   * Calls `f` for every cell that has a distance of at most `margin` to the
+   * segment `ab` (measured per axis).
+   */
+  template <typename F>
+  void for_each_cell_near(const Point &a, const Point &b, double margin,
+                          F &&f) const;
+
+  /**
+   * Calls `f(i, j, distance)` for every circle `i` that may have a distance
+   * of at most `tolerance` to the j-th segment of the trajectory. `distance`
+   * computes the distance of a point to that segment. The segments are
+   * walked in order, but a circle may be passed multiple times per segment.
+   */
+  template <typename F>
+  void for_each_circle_near(const Trajectory &trajectory, double tolerance,
+                            F &&f) const;
+
+  void build_pyramid();
+
+  static void split_coordinates(const Trajectory &trajectory,
+                                std::vector<double> &px,
+                                std::vector<double> &py);
+
+  std::vector<double> x, y, r; // the circles
+  double x0 = 0.0, y0 = 0.0, cell_size = 1.0;
+  int nx = 1, ny = 1;
+  // The circles overlapping a cell are
+  // cell_circles[cell_begin[c]..cell_begin[c+1]).
+  std::vector<unsigned> cell_begin, cell_circles;
+  // The same for the cell that contains the center of the circle.
+  std::vector<unsigned> center_begin, center_circles;
+
+  struct Block {
+    // The bounding box of the centers of the circles. Empty if x0 > x1.
+    double x0, y0, x1, y1;
+    double min_radius;
+  };
+  // Level 0 are the cells, a block of level l+1 combines 2x2 blocks of level
+  // l. The last level is a single block.
+  std::vector<std::vector<Block>> pyramid;
+  std::vector<int> pyramid_width;
+};
+
+TEST_CASE("Circle Grid") {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coord(0, 100), radius(0, 3);
+  std::vector<Circle> circles;
+  for (int i = 0; i < 500; ++i) {
+    circles.emplace_back(Point{coord(rng), coord(rng)}, radius(rng));
+  }
+  // a few identical ones for the tie breaking
+  circles.push_back(circles[3]);
+  circles.push_back(circles[3]);
+  CircleGrid grid(circles);
+  CHECK(grid.size() == circles.size());
+  for (int k = 0; k < 20; ++k) {
+    std::vector<Point> points;
+    const int m = 1 + k % 7;
+    for (int j = 0; j < m; ++j) {
+      points.emplace_back(coord(rng), coord(rng));
+    }
+    if (k % 2 == 0) {
+      points.push_back(points.front()); // a tour
+    }
+    Trajectory trajectory(points);
+    std::vector<char> covered(circles.size(), 0);
+    grid.mark_covered(trajectory, 0.001, covered.data());
+    std::vector<int> num_covering(circles.size(), 0);
+    for (const auto &entry : grid.compute_coverage(trajectory, 0.001)) {
+      ++num_covering[entry.circle];
+      const auto j = entry.segment;
+      REQUIRE(j < std::max<size_t>(1, points.size() - 1));
+      const auto segment =
+          points.size() > 1 ? Trajectory({points[j], points[j + 1]})
+                            : trajectory;
+      CHECK(entry.distance ==
+            doctest::Approx(segment.distance(circles[entry.circle])));
+      CHECK(entry.distance <= 0.001);
+    }
+    std::vector<char> excluded(circles.size(), 0);
+    std::vector<double> distances(circles.size());
+    for (size_t i = 0; i < circles.size(); ++i) {
+      CHECK(static_cast<bool>(covered[i]) ==
+            trajectory.covers(circles[i], 0.001));
+      distances[i] = trajectory.distance(circles[i]);
+      CHECK((num_covering[i] > 0) == static_cast<bool>(covered[i]));
+      excluded[i] = (i % 5 == static_cast<size_t>(k % 5));
+      if (excluded[i]) {
+        distances[i] = -std::numeric_limits<double>::infinity();
+      }
+    }
+    const auto farthest = grid.farthest(trajectory, excluded);
+    REQUIRE(farthest);
+    const auto expected = std::distance(
+        distances.begin(), std::max_element(distances.begin(), distances.end()));
+    CHECK(farthest->first == expected);
+    CHECK(farthest->second == distances[expected]);
+  }
+  // Trajectories may leave the grid, e.g., at the end points of a path.
+  Trajectory outside({Point{-50, -50}, Point{-50, 150}});
+  std::vector<char> none(circles.size(), 0);
+  const auto farthest = grid.farthest(outside, none);
+  REQUIRE(farthest);
+  for (const auto &circle : circles) {
+    CHECK(outside.distance(circle) <= farthest->second + 1e-9);
+  }
+  std::vector<double> distances(circles.size());
+  grid.compute_distances(outside, 0, circles.size(), distances.data());
+  for (size_t i = 0; i < circles.size(); ++i) {
+    CHECK(distances[i] == doctest::Approx(outside.distance(circles[i])));
+  }
+  // Far circles whose distances only differ in the last bits. The farthest
+  // one is decided as by `Trajectory::distance`.
+  std::vector<Circle> near_ties;
+  std::uniform_real_distribution<double> ulps(-1e-13, 1e-13);
+  for (int i = 0; i < 300; ++i) {
+    if (i % 3 == 0) {
+      near_ties.emplace_back(Point{100 + ulps(rng), 100 + ulps(rng)},
+                             1 + ulps(rng));
+    } else {
+      near_ties.emplace_back(Point{coord(rng) / 10, coord(rng) / 10},
+                             radius(rng));
+    }
+  }
+  CircleGrid near_tie_grid(near_ties);
+  std::vector<char> no_excluded(near_ties.size(), 0);
+  for (int k = 0; k < 20; ++k) {
+    std::vector<Point> points;
+    for (int j = 0; j < 1 + k % 4; ++j) {
+      points.emplace_back(coord(rng) / 10, coord(rng) / 10);
+    }
+    Trajectory trajectory(points);
+    std::vector<double> near_tie_distances;
+    for (const auto &circle : near_ties) {
+      near_tie_distances.push_back(trajectory.distance(circle));
+    }
+    const auto expected = std::distance(
+        near_tie_distances.begin(),
+        std::max_element(near_tie_distances.begin(), near_tie_distances.end()));
+    const auto farthest = near_tie_grid.farthest(trajectory, no_excluded);
+    REQUIRE(farthest);
+    CHECK(farthest->first == expected);
+    CHECK(farthest->second == near_tie_distances[expected]);
+  }
+  // A lattice of 10^4 circles, whose four corners are the farthest circles
+  // of symmetric trajectories.
+  std::vector<Circle> lattice;
+  for (int row = 0; row < 100; ++row) {
+    for (int col = 0; col < 100; ++col) {
+      lattice.emplace_back(Point{double(col), double(row)}, 0.5);
+    }
+  }
+  CircleGrid lattice_grid(lattice);
+  std::vector<char> lattice_excluded(lattice.size(), 0);
+  for (const auto &trajectory :
+       {Trajectory({Point{49.5, 49.5}}),
+        Trajectory({Point{49.5, 40}, Point{49.5, 59}})}) {
+    auto farthest = lattice_grid.farthest(trajectory, lattice_excluded);
+    REQUIRE(farthest);
+    CHECK(farthest->first == 0);
+    CHECK(farthest->second ==
+          doctest::Approx(trajectory.distance(lattice[0])));
+    lattice_excluded[0] = 1;
+    farthest = lattice_grid.farthest(trajectory, lattice_excluded);
+    REQUIRE(farthest);
+    CHECK(farthest->first == 99);
+    lattice_excluded[0] = 0;
+  }
+}
+} // namespace cetsp::details
+#endif // CETSP_CIRCLE_GRID_H
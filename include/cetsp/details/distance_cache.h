@@ -1,18 +1,24 @@
 /**
  * Computing the distance to a trajectory seems to be an expensive operation,
- * so we cache it.
+ * so we cache it. Coverage and the farthest circle are answered with the
+ * circle grid of the instance, which only looks at the circles close to or
+ * far from the trajectory. If the coverage of the parent is known, the
+ * coverage is derived from it, see incremental_coverage.h.
  */
 #ifndef CETSP_DISTANCE_CACHE_H
 #define CETSP_DISTANCE_CACHE_H
 #include "cetsp/common.h"
+#include "cetsp/details/circle_grid.h"
+#include "cetsp/details/incremental_coverage.h"
+#include "cetsp/details/slab_allocator.h"
+#include <memory>
+#include <optional>
 #include <vector>
 namespace cetsp::details {
 
 class DistanceCache {
   /**
    * Just a simple cached distance calculator.
-   * TODO: Improve runtime. Current implementation of just using the trajectory
-   * method is slow.
    */
 public:
   explicit DistanceCache(const Instance *instance) : instance{instance} {}
@@ -25,17 +31,76 @@ public:
     return cache[i];
   }
 
+  /**
+   * If the distance of the i-th circle is at most `tolerance`. Uses the
+   * cached distance if there is one, and the grid for all uncached circles
+   * otherwise.
+   */
+  bool is_covered(int i, const Trajectory *trajectory, double tolerance) {
+    assert(i < static_cast<int>(instance->size()));
+    if (i < static_cast<int>(cache.size())) {
+      return cache[i] <= tolerance;
+    }
+    if (i >= static_cast<int>(covered.size())) {
+      covered.assign(instance->size(), 0);
+      if (parent_coverage && parent_coverage->get_tolerance() == tolerance) {
+        mark_covered_incrementally(*instance, *parent_coverage, *trajectory,
+                                   covered.data());
+      } else {
+        instance->get_circle_grid()->mark_covered(*trajectory, tolerance,
+                                                  covered.data());
+      }
+      parent_coverage.reset(); // only needed once
+    }
+    return covered[i];
+  }
+
+  /**
+   * The circle with the largest distance among the circles that are not
+   * excluded, see `CircleGrid::farthest`.
+   */
+  std::optional<std::pair<int, double>>
+  farthest(const Trajectory *trajectory, const std::vector<char> &excluded) {
+    return instance->get_circle_grid()->farthest(*trajectory, excluded);
+  }
+
+  /**
+   * Lets `is_covered` derive the coverage from the coverage of the parent,
+   * see `mark_covered_incrementally`.
+   */
+  void set_parent_coverage(std::shared_ptr<const ParentCoverage> coverage) {
+    parent_coverage = std::move(coverage);
+  }
+
+  /**
+   * Frees the cached distances.
+   */
+  void clear() {
+    Buffer<double>().swap(cache);
+    Buffer<char>().swap(covered);
+    parent_coverage.reset();
+  }
+
+  [[nodiscard]] size_t memory_usage() const {
+    return cache.capacity() * sizeof(double) + covered.capacity();
+  }
+
   const Instance *instance;
 
 private:
+  // The buffers of the nodes come from the slabs, see `PoolAllocator`.
+  template <typename T> using Buffer = std::vector<T, PoolAllocator<T>>;
+
   void fill_cache(const Trajectory *trajectory) {
-    cache.reserve(instance->size());
-    for (unsigned i = cache.size(); i < instance->size(); ++i) {
-      cache.push_back(trajectory->distance((*instance)[i]));
-    }
+    const auto begin = cache.size();
+    cache.resize(instance->size());
+    instance->get_circle_grid()->compute_distances(
+        *trajectory, begin, cache.size(), cache.data() + begin);
   }
 
-  std::vector<double> cache;
+  Buffer<double> cache;
+  Buffer<char> covered; // by the grid, for all circles
+  std::shared_ptr<const ParentCoverage> parent_coverage;
 };
 
 } // namespace cetsp::details
@@ -0,0 +1,201 @@
+/**
+ * A child's trajectory differs from its parent's trajectory mostly around the
+ * inserted circle. The trajectory windows of the incremental computation even
+ * keep all other hitting points of the parent. Thus, the coverage of a child
+ * can mostly be derived from the coverage of its parent.
+ *
+ * The segments of the child that also are segments of the parent are
+ * unchanged. Every other segment of the parent has been replaced, and we
+ * bound how far its points are from the changed segments of the child (its
+ * displacement). For every circle covered by the parent, we know the
+ * segments covering it:
+ *  - If one of them is unchanged, the child covers the circle, too.
+ *  - If one of them covers it at distance d and has the displacement h, the
+ *    circle has at most the distance d+h to the child. It is covered if d+h
+ *    is below the tolerance.
+ *  - Otherwise, no unchanged segment covers the circle.
+ * Only the circles close to the changed segments of the child are checked
+ * exactly. The result is the same as `CircleGrid::mark_covered` for the
+ * child.
+ */
+#ifndef CETSP_INCREMENTAL_COVERAGE_H
+#define CETSP_INCREMENTAL_COVERAGE_H
+#include "cetsp/common.h"
+#include "cetsp/details/circle_grid.h"
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace cetsp::details {
+
+/**
+ * The circles covered by the trajectory of a parent, shared between its
+ * children. The coverage is only computed when the first child needs it, so
+ * nothing is paid for parents whose children are pruned before their
+ * coverage is checked or differ too much from the parent.
+ */
+class ParentCoverage {
+public:
+  ParentCoverage(const Instance &instance, Trajectory trajectory,
+                 double tolerance);
+
+  [[nodiscard]] const Trajectory &get_trajectory() const { return trajectory; }
+
+  [[nodiscard]] double get_tolerance() const { return tolerance; }
+
+  /**
+   * All pairs of a covered circle and a segment covering it, sorted by the
+   * circle. Computed on the first call, which may come from any thread.
+   */
+  [[nodiscard]] const std::vector<CircleGrid::Coverage> &get_coverage() const;
+
+  /**
+   * The number of circles of the instance the coverage has been computed
+   * for. Lazy constraints may add circles after the first child, which the
+   * coverage then does not know about. Call `get_coverage` first.
+   */
+  [[nodiscard]] size_t get_num_circles() const { return num_circles; }
+
+  [[nodiscard]] bool is_computed() const { return computed.load(); }
+
+private:
+  const Instance *instance;
+  Trajectory trajectory;
+  double tolerance;
+  mutable std::once_flag compute_once;
+  mutable std::atomic<bool> computed{false};
+  mutable std::vector<CircleGrid::Coverage> coverage;
+  mutable size_t num_circles = 0;
+};
+
+/**
+ * The difference between a parent's and a child's trajectory.
+ */
+struct TrajectoryChange {
+  // For every segment of the child, if it is no segment of the parent.
+  std::vector<char> changed;
+  // For every segment of the parent, a bound on the distance of its points
+  // to the child's trajectory. Zero only for the unchanged segments.
+  std::vector<double> displacement;
+};
+
+/**
+ * Compares the trajectories segment by segment.
+ * @param max_comparisons The displacements need one comparison per pair of a
+ * replaced and a changed segment. If there are more, e.g., because the child
+ * has been computed completely, nothing is returned.
+ */
+std::optional<TrajectoryChange>
+compare_trajectories(const Trajectory &parent, const Trajectory &child,
+                     size_t max_comparisons);
+
+/**
+ * Sets `covered[i]` for every circle `i` whose distance to `child` is at most
+ * the tolerance of the parent's coverage. Falls back to
+ * `CircleGrid::mark_covered` if the trajectories differ too much or the
+ * instance has changed since the parent's coverage has been computed.
+ * `covered` has an entry for every circle of the instance.
+ */
+void mark_covered_incrementally(const Instance &instance,
+                                const ParentCoverage &parent,
+                                const Trajectory &child, char *covered);
+
+TEST_CASE("Incremental Coverage") {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coord(0, 100), radius(0, 3),
+      noise(-2, 2);
+  std::vector<Circle> circles;
+  for (int i = 0; i < 500; ++i) {
+    circles.emplace_back(Point{coord(rng), coord(rng)}, radius(rng));
+  }
+  Instance instance(circles);
+  const double tolerance = 0.001;
+  auto check = [&](const Trajectory &parent, const Trajectory &child) {
+    const ParentCoverage coverage(instance, parent, tolerance);
+    CHECK(!coverage.is_computed());
+    std::vector<char> covered(instance.size(), 0);
+    mark_covered_incrementally(instance, coverage, child, covered.data());
+    for (size_t i = 0; i < instance.size(); ++i) {
+      CHECK(static_cast<bool>(covered[i]) ==
+            child.covers(instance.at(i), tolerance));
+    }
+    // only computed if the child is derived from it
+    const bool derived =
+        child.points.size() > 1 &&
+        compare_trajectories(parent, child, instance.size()).has_value();
+    CHECK(coverage.is_computed() == derived);
+    const auto &entries = coverage.get_coverage();
+    CHECK(std::is_sorted(
+        entries.begin(), entries.end(),
+        [](const auto &a, const auto &b) { return a.circle < b.circle; }));
+  };
+  for (int k = 0; k < 10; ++k) {
+    std::vector<Point> points;
+    const int m = 3 + k;
+    for (int j = 0; j < m; ++j) {
+      points.emplace_back(coord(rng), coord(rng));
+    }
+    points.push_back(points.front());
+    const Trajectory parent(points);
+    // An insertion that also moves the neighbors, as a window does.
+    auto child_points = points;
+    const int at = 1 + k % (m - 1);
+    child_points[at - 1].x += noise(rng);
+    child_points[at].y += noise(rng);
+    child_points.insert(child_points.begin() + at,
+                        Point{coord(rng), coord(rng)});
+    child_points.back() = child_points.front();
+    const Trajectory child(child_points);
+    const auto change = compare_trajectories(parent, child, 1000);
+    REQUIRE(change);
+    CHECK(std::count(change->changed.begin(), change->changed.end(), 1) <= 4);
+    CHECK(std::count(change->displacement.begin(), change->displacement.end(),
+                     0.0) >= m - 3);
+    check(parent, child);
+    // unchanged, and completely different
+    check(parent, parent);
+    check(child, parent);
+    std::vector<Point> other;
+    for (int j = 0; j < m; ++j) {
+      other.emplace_back(coord(rng), coord(rng));
+    }
+    check(parent, Trajectory(other));
+    check(Trajectory({points[0]}), child);
+  }
+  // too many changes
+  CHECK(!compare_trajectories(Trajectory({{0, 0}, {1, 0}, {2, 0}}),
+                              Trajectory({{0, 1}, {1, 1}, {2, 1}}), 3));
+}
+
+TEST_CASE("Incremental Coverage Added Circle") {
+  // A lazy callback may add a circle while the first of two siblings is
+  // explored. The second one still has to see it.
+  Instance instance({{{0, 0}, 1}, {{10, 0}, 1}, {{10, 10}, 1}, {{0, 10}, 1}});
+  const double tolerance = 0.001;
+  const ParentCoverage parent(
+      instance, Trajectory({{0, 0}, {10, 0}, {10, 10}, {0, 10}, {0, 0}}),
+      tolerance);
+  const Trajectory first({{0, 0}, {10, 0}, {12, 5}, {10, 10}, {0, 10}, {0, 0}});
+  std::vector<char> covered(instance.size(), 0);
+  mark_covered_incrementally(instance, parent, first, covered.data());
+  CHECK(parent.is_computed());
+  // on a segment that both children keep
+  Circle added({5, 0}, 0.1);
+  instance.add_circle(added);
+  REQUIRE(instance.size() == 5);
+  const Trajectory second(
+      {{0, 0}, {10, 0}, {10, 10}, {5, 12}, {0, 10}, {0, 0}});
+  covered.assign(instance.size(), 0);
+  mark_covered_incrementally(instance, parent, second, covered.data());
+  for (size_t i = 0; i < instance.size(); ++i) {
+    CHECK(static_cast<bool>(covered[i]) ==
+          second.covers(instance.at(i), tolerance));
+  }
+  CHECK(covered[4]);
+}
+} // namespace cetsp::details
+#endif // CETSP_INCREMENTAL_COVERAGE_H
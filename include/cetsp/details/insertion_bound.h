@@ -0,0 +1,70 @@
+/**
+ * A lower bound on the length of a child that does not need the SOCP. If the
+ * trajectory of the child skips the inserted circle, it becomes a trajectory
+ * for the sequence of the parent. Hence, the child is at least as long as the
+ * parent's optimal trajectory plus the detour |ab| + |bc| - |ac| over the
+ * hitting points a, b, c of the inserted circle and its two neighbors.
+ *
+ * If b has the distance h to the segment ac, the detour is at least
+ * sqrt(|ac|^2 + 4h^2) - |ac| (b lies on an ellipse with the foci a and c).
+ * This decreases with |ac|, so it suffices to bound |ac| from above and h
+ * from below by the circles. This is much weaker than the insertion costs of
+ * InsertionCostCalculator, but it takes constant time.
+ */
+#ifndef CETSP_INSERTION_BOUND_H
+#define CETSP_INSERTION_BOUND_H
+#include "cetsp/common.h"
+#include "cetsp/utils/geometry.h"
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace cetsp::details {
+
+/**
+ * Lower bound on the detour of inserting `circle` between `prev` and `next`.
+ * For paths, the end points can be given as circles with radius zero.
+ */
+inline double lower_bound_on_detour(const Circle &prev, const Circle &circle,
+                                     const Circle &next) {
+  const double max_ac =
+      prev.center.dist(next.center) + prev.radius + next.radius;
+  // The segment ac lies in the capsule around the centers of the neighbors.
+  const double h =
+      utils::distance_to_segment({prev.center.x, prev.center.y},
+                                 {next.center.x, next.center.y},
+                                 {circle.center.x, circle.center.y}) -
+      std::max(prev.radius, next.radius) - circle.radius;
+  if (h <= 0) {
+    return 0.0;
+  }
+  return std::sqrt(max_ac * max_ac + 4 * h * h) - max_ac;
+}
+
+TEST_CASE("Lower Bound on Detour") {
+  // on the way
+  CHECK(lower_bound_on_detour({{0, 0}, 0}, {{5, 0}, 1}, {{10, 0}, 0}) == 0.0);
+  // exact for points
+  CHECK(lower_bound_on_detour({{0, 0}, 0}, {{5, 5}, 0}, {{10, 0}, 0}) ==
+        doctest::Approx(2 * std::sqrt(50.0) - 10.0));
+  // never above the detour of any hitting points
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coord(0, 10), angle(0, 2 * M_PI),
+      fraction(0, 1);
+  auto sample = [&](const Circle &c) {
+    const double a = angle(rng);
+    const double r = c.radius * fraction(rng);
+    return Point(c.center.x + r * std::cos(a), c.center.y + r * std::sin(a));
+  };
+  for (int i = 0; i < 1000; ++i) {
+    Circle u{{coord(rng), coord(rng)}, fraction(rng)};
+    Circle c{{coord(rng), coord(rng)}, fraction(rng)};
+    Circle w{{coord(rng), coord(rng)}, fraction(rng)};
+    const auto a = sample(u), b = sample(c), d = sample(w);
+    CHECK(lower_bound_on_detour(u, c, w) <=
+          a.dist(b) + b.dist(d) - a.dist(d) + 1e-9);
+  }
+}
+} // namespace cetsp::details
+#endif // CETSP_INSERTION_BOUND_H
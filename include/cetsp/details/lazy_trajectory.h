@@ -6,13 +6,55 @@
 #define CETSP_LAZY_TRAJECTORY_H
 
 #include "cetsp/common.h"
+#include "cetsp/details/sequence_record.h"
+#include "cetsp/soc.h"
+#include <limits>
+#include <memory>
+#include <optional>
 #include <vector>
 namespace cetsp::details {
 class LazyTrajectoryComputation {
 public:
   LazyTrajectoryComputation(const Instance *instance_,
                             std::vector<int> sequence_)
-      : instance{instance_}, sequence{std::move(sequence_)} {}
+      : instance{instance_}, record{std::make_shared<const SequenceRecord>(
+                                 std::move(sequence_))} {}
+
+  LazyTrajectoryComputation(const Instance *instance_,
+                            std::shared_ptr<const SequenceRecord> record_)
+      : instance{instance_}, record{std::move(record_)} {}
+
+  /**
+   * The sequence of circles. Materialized on demand if only the insertion
+   * into the parent's sequence is recorded.
+   */
+  const std::vector<int> &get_sequence() const {
+    if (record->is_explicit()) {
+      return record->get_explicit_sequence();
+    }
+    if (!materialized_sequence) {
+      materialized_sequence = record->materialize();
+    }
+    return *materialized_sequence;
+  }
+
+  void set_sequence(std::vector<int> sequence) {
+    record = std::make_shared<const SequenceRecord>(std::move(sequence));
+    materialized_sequence.reset();
+  }
+
+  /**
+   * The record of the sequence, which can be shared with the children.
+   */
+  const std::shared_ptr<const SequenceRecord> &get_sequence_record() const {
+    return record;
+  }
+
+  /**
+   * Frees the materialized sequence. It will be rebuilt when needed again.
+   * Invalidates the references returned by `get_sequence`.
+   */
+  void release_sequence() const { materialized_sequence.reset(); }
 
   Trajectory &get_trajectory() const {
     trigger_computation();
@@ -20,16 +62,130 @@ public:
   }
 
   std::vector<bool> &get_spanning_information() const {
+    if (!data && released_spanning) {
+      return *released_spanning;
+    }
     trigger_computation();
     return data->second;
   }
 
+  /**
+   * The length of the trajectory. Also known after `release_data`.
+   */
+  double get_length() const {
+    if (!data && released_length) {
+      return *released_length;
+    }
+    return get_trajectory().length();
+  }
+
   void update(Trajectory &trajectory, std::vector<bool> &spanning_info) {
     data = std::make_pair(trajectory, spanning_info);
+    forget_released();
   }
 
   void update(Trajectory &&trajectory, std::vector<bool> &&spanning_info) {
     data = std::make_pair(std::move(trajectory), std::move(spanning_info));
+    forget_released();
+  }
+
+  /**
+   * Allows to compute the trajectory incrementally from the trajectory of the
+   * parent, whose sequence only misses the circle at position `inserted_at`.
+   * The parent trajectory is released after the computation.
+   */
+  void set_parent_trajectory(std::shared_ptr<const ParentTrajectory> parent,
+                             int inserted_at) {
+    parent_trajectory = std::move(parent);
+    parent_insertion = inserted_at;
+  }
+
+  [[nodiscard]] bool is_computed() const { return data.has_value(); }
+
+  /**
+   * True if the last computation stopped early, because the trajectory is
+   * proved to be longer than the cutoff. The trajectory is computed
+   * completely if it is accessed.
+   */
+  [[nodiscard]] bool is_above_cutoff() const {
+    return !data && certified_bound.has_value();
+  }
+
+  /**
+   * The certified lower bound reached by a computation that has stopped at
+   * the cutoff.
+   */
+  [[nodiscard]] double get_cutoff_bound() const {
+    assert(is_above_cutoff());
+    return *certified_bound;
+  }
+
+  /**
+   * True if the trajectory has been computed from the parent's trajectory by
+   * only re-optimizing a window around the inserted circle.
+   */
+  [[nodiscard]] bool is_incremental() const {
+    return data.has_value() && incremental;
+  }
+
+  /**
+   * False if the trajectory has only been computed loosely, i.e., it is
+   * feasible but may be longer than the optimum. See `refine`.
+   */
+  [[nodiscard]] bool is_exact() const {
+    return data.has_value() && !certified_bound.has_value();
+  }
+
+  /**
+   * A certified lower bound for the length of the optimal trajectory. This
+   * is the length of the trajectory if it is exact.
+   */
+  [[nodiscard]] double get_lower_bound() const {
+    if (certified_bound) {
+      return *certified_bound;
+    }
+    return get_length();
+  }
+
+  /**
+   * Recomputes a loosely computed trajectory exactly.
+   * @return True if the trajectory has changed.
+   */
+  bool refine() const {
+    if (!data || !certified_bound) {
+      return false;
+    }
+    data.reset();
+    compute_trajectory();
+    return true;
+  }
+
+  /**
+   * The (estimated) bytes used by the computed trajectory and spanning
+   * information.
+   */
+  [[nodiscard]] size_t get_data_size() const {
+    if (!data) {
+      return 0;
+    }
+    return data->first.points.capacity() * sizeof(Point) +
+           data->second.capacity() / 8;
+  }
+
+  /**
+   * Drops the computed trajectory. It is computed again from scratch when
+   * needed. The length and the spanning information of an exact trajectory
+   * are kept, as they are small and still used, e.g., by the search.
+   */
+  void release_data() const {
+    if (data) {
+      if (!certified_bound) {
+        released_length = data->first.length();
+        released_spanning = std::move(data->second);
+      }
+      certified_bound.reset(); // the recomputation is exact
+    }
+    data.reset();
   }
 
   bool trigger_computation() const {
@@ -40,17 +196,49 @@ public:
     return true;
   }
 
+  /**
+   * Computes the trajectories of all lazy computations that have not been
+   * computed yet at once, such that the solver can share the setup.
+   * @param cutoff The computations may stop early for trajectories that are
+   * proved to be longer, see `is_above_cutoff`.
+   * @param loose Only compute feasible trajectories with a certified lower
+   * bound, see `is_exact`.
+   */
+  static void
+  compute_batch(const std::vector<const LazyTrajectoryComputation *> &batch,
+                double cutoff = std::numeric_limits<double>::infinity(),
+                bool loose = false);
+
   const Instance *instance;
-  std::vector<int> sequence;
 
 private:
   void compute_trajectory() const;
 
-  void compute_tour_trajectory() const;
+  /**
+   * The circles of the sequence, for a path including the fixed endpoints.
+   */
+  std::vector<Circle> get_circles() const;
+
+  void set_solution(std::pair<Trajectory, std::vector<bool>> &&soc) const;
 
-  void compute_path_trajectory() const;
+  void set_result(CutoffSolution &&result) const;
+
+  void forget_released() const {
+    released_length.reset();
+    released_spanning.reset();
+  }
 
+  std::shared_ptr<const SequenceRecord> record;
+  mutable std::optional<std::vector<int>> materialized_sequence;
   mutable std::optional<std::pair<Trajectory, std::vector<bool>>> data;
+  // The certified lower bound if the trajectory is above the cutoff or loose.
+  mutable std::optional<double> certified_bound;
+  mutable bool incremental = false; // see `is_incremental`
+  // What is kept of the trajectory by `release_data`.
+  mutable std::optional<double> released_length;
+  mutable std::optional<std::vector<bool>> released_spanning;
+  mutable std::shared_ptr<const ParentTrajectory> parent_trajectory;
+  int parent_insertion = -1;
 };
 } // namespace cetsp::details
 #endif // CETSP_LAZY_TRAJECTORY_H
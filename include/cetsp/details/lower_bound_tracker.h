@@ -0,0 +1,208 @@
+/**
+ * The proven lower bound of the BnB is the minimum of the lower bounds of
+ * the open leaves, the feasible leaves, and the leaves pruned as dominated.
+ * Instead of propagating every change through the tree to the root, the
+ * tracker keeps the open leaves in an indexed min-heap and the minimum of
+ * the retired leaves as a scalar. Reading the lower bound is O(1), changes
+ * are O(log n).
+ *
+ * The tracker does not know the nodes. Every tracked node owns a handle with
+ * its position in the heap, which the tracker keeps up to date, such that a
+ * node can be updated or removed without a search.
+ */
+#ifndef CETSP_LOWER_BOUND_TRACKER_H
+#define CETSP_LOWER_BOUND_TRACKER_H
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace cetsp::details {
+class LowerBoundTracker {
+public:
+  /**
+   * The part of a tracked leaf that belongs to the tracker.
+   */
+  struct Handle {
+    LowerBoundTracker *tracker = nullptr; // nullptr if not tracked
+    size_t position = 0;
+  };
+
+  LowerBoundTracker() = default;
+  LowerBoundTracker(const LowerBoundTracker &) = delete;
+  LowerBoundTracker &operator=(const LowerBoundTracker &) = delete;
+
+  ~LowerBoundTracker() {
+    // the leaves may outlive the tracker
+    for (auto &entry : heap) {
+      entry.handle->tracker = nullptr;
+    }
+  }
+
+  /**
+   * Adds an open leaf.
+   * @param handle The handle of the leaf, which has to stay valid until the
+   * leaf is removed.
+   */
+  void insert(Handle &handle, const double lower_bound) {
+    std::lock_guard<std::mutex> lock(mutex);
+    assert(handle.tracker == nullptr);
+    handle.tracker = this;
+    handle.position = heap.size();
+    heap.push_back({lower_bound, &handle});
+    sift_up(handle.position);
+    update_minimum();
+  }
+
+  /**
+   * Raises the lower bound of an open leaf.
+   */
+  void update(const Handle &handle, const double lower_bound) {
+    std::lock_guard<std::mutex> lock(mutex);
+    assert(handle.tracker == this &&
+           heap[handle.position].lower_bound <= lower_bound);
+    heap[handle.position].lower_bound = lower_bound;
+    sift_down(handle.position);
+    update_minimum();
+  }
+
+  /**
+   * Removes a leaf that has been branched or that cannot contain a solution.
+   */
+  void remove(Handle &handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    erase(handle);
+    update_minimum();
+  }
+
+  /**
+   * Removes a leaf that is no longer explored, but whose lower bound still
+   * counts, i.e., a feasible leaf or a leaf pruned because of the gap.
+   */
+  void retire(Handle &handle, const double lower_bound) {
+    std::lock_guard<std::mutex> lock(mutex);
+    erase(handle);
+    retired_minimum = std::min(retired_minimum, lower_bound);
+    update_minimum();
+  }
+
+  /**
+   * A lower bound for the whole tree, e.g., given by the user.
+   */
+  void add_lower_bound(const double lower_bound) {
+    std::lock_guard<std::mutex> lock(mutex);
+    floor = std::max(floor, lower_bound);
+    update_minimum();
+  }
+
+  /**
+   * The proven lower bound. Does not lock.
+   */
+  [[nodiscard]] double get_lower_bound() const { return minimum; }
+
+  /**
+   * The number of open leaves.
+   */
+  [[nodiscard]] size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return heap.size();
+  }
+
+private:
+  struct Entry {
+    double lower_bound;
+    Handle *handle;
+  };
+
+  void erase(Handle &handle) {
+    assert(handle.tracker == this);
+    const size_t i = handle.position;
+    handle.tracker = nullptr;
+    if (i + 1 != heap.size()) {
+      heap[i] = heap.back();
+      heap.pop_back();
+      Handle *moved = heap[i].handle;
+      moved->position = i;
+      sift_up(i);
+      sift_down(moved->position);
+    } else {
+      heap.pop_back();
+    }
+  }
+
+  void sift_up(size_t i) {
+    while (i > 0) {
+      const size_t p = (i - 1) / 2;
+      if (heap[p].lower_bound <= heap[i].lower_bound) {
+        break;
+      }
+      swap(i, p);
+      i = p;
+    }
+  }
+
+  void sift_down(size_t i) {
+    for (;;) {
+      size_t smallest = i;
+      for (size_t c = 2 * i + 1; c <= 2 * i + 2 && c < heap.size(); ++c) {
+        if (heap[c].lower_bound < heap[smallest].lower_bound) {
+          smallest = c;
+        }
+      }
+      if (smallest == i) {
+        return;
+      }
+      swap(i, smallest);
+      i = smallest;
+    }
+  }
+
+  void swap(size_t i, size_t j) {
+    std::swap(heap[i], heap[j]);
+    heap[i].handle->position = i;
+    heap[j].handle->position = j;
+  }
+
+  void update_minimum() {
+    const double open =
+        heap.empty() ? std::numeric_limits<double>::infinity()
+                     : heap.front().lower_bound;
+    minimum = std::max(floor, std::min(open, retired_minimum));
+  }
+
+  mutable std::mutex mutex;
+  std::vector<Entry> heap; // the open leaves, the lowest bound on top
+  double retired_minimum = std::numeric_limits<double>::infinity();
+  double floor = -std::numeric_limits<double>::infinity();
+  std::atomic<double> minimum{std::numeric_limits<double>::infinity()};
+};
+
+TEST_CASE("Lower Bound Tracker") {
+  LowerBoundTracker tracker;
+  std::vector<LowerBoundTracker::Handle> handles(10);
+  for (size_t i = 0; i < handles.size(); ++i) {
+    tracker.insert(handles[i], 10.0 - i);
+  }
+  CHECK(tracker.get_lower_bound() == 1.0);
+  tracker.update(handles[9], 20.0);
+  CHECK(tracker.get_lower_bound() == 2.0);
+  tracker.remove(handles[8]);
+  CHECK(handles[8].tracker == nullptr);
+  CHECK(tracker.get_lower_bound() == 3.0);
+  tracker.retire(handles[7], 3.5);
+  CHECK(tracker.get_lower_bound() == 3.5);
+  for (size_t i = 0; i < 7; ++i) {
+    tracker.remove(handles[i]);
+  }
+  CHECK(tracker.size() == 1);
+  CHECK(tracker.get_lower_bound() == 3.5);
+  tracker.add_lower_bound(4.0);
+  CHECK(tracker.get_lower_bound() == 4.0);
+  tracker.remove(handles[9]);
+  CHECK(tracker.size() == 0);
+}
+} // namespace cetsp::details
+#endif // CETSP_LOWER_BOUND_TRACKER_H
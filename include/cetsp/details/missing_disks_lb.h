@@ -443,7 +443,7 @@ public:
     auto lb = model.compute_lb();
     std::cout << "improving lb by " << lb << " working on "
               << missing_disks.size() << " disks" << std::endl;
-    auto obj = context.current_node->get_relaxed_solution().obj();
+    auto obj = context.current_node->get_relaxed_solution().get_lower_bound();
     std::cout << "old lb: " << obj << std::endl;
     std::cout << "new lb " << obj + lb << std::endl;
     context.current_node->add_lower_bound(obj + lb);
@@ -0,0 +1,153 @@
+/**
+ * Every open node keeps its relaxed solution, i.e., the trajectory, the
+ * spanning information, and the distances of all circles to the trajectory.
+ * For large instances with many open nodes, this does not fit into memory.
+ * The budget tracks the memory of the open nodes and, if it is exceeded,
+ * frees the relaxed solutions of the open nodes with the highest lower
+ * bounds, as these are the least likely to be explored soon. Only the
+ * sequence and the lower bound are kept, and the relaxed solution is
+ * recomputed when the node is explored.
+ *
+ * The budget is not thread-safe and only meant for the sequential search.
+ */
+#ifndef CETSP_OPEN_NODE_BUDGET_H
+#define CETSP_OPEN_NODE_BUDGET_H
+#include "cetsp/node.h"
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cetsp::details {
+class OpenNodeBudget {
+public:
+  /**
+   * @param memory_budget The (estimated) memory in bytes the relaxed
+   * solutions of the open nodes may use. Zero disables the budget.
+   */
+  explicit OpenNodeBudget(size_t memory_budget = 0)
+      : memory_budget{memory_budget} {}
+
+  void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+
+  [[nodiscard]] bool is_enabled() const { return memory_budget > 0; }
+
+  /**
+   * Tracks new open nodes, e.g., the children of a node that has just been
+   * branched. Frees the relaxed solutions of the least promising open nodes
+   * if the budget is exceeded.
+   */
+  void add(const std::vector<std::shared_ptr<Node>> &nodes) {
+    if (!is_enabled()) {
+      return;
+    }
+    for (const auto &node : nodes) {
+      const auto bytes = node->get_relaxed_solution().get_computed_data_size();
+      heap.push_back({node, node->get_lower_bound(), bytes});
+      std::push_heap(heap.begin(), heap.end(), is_less_expensive);
+      tracked_bytes += bytes;
+    }
+    if (tracked_bytes > memory_budget) {
+      enforce();
+    }
+  }
+
+  /**
+   * Has to be called before a node is explored. Recomputes its relaxed
+   * solution if it has been freed.
+   */
+  void on_explore(Node &node) {
+    if (!is_enabled() || node.get_relaxed_solution().is_computed()) {
+      return;
+    }
+    ++num_recomputations;
+    node.trigger_lazy_evaluation();
+  }
+
+  void add_statistics(
+      std::unordered_map<std::string, std::string> &stats) const {
+    stats["open_node_bytes_freed"] = std::to_string(bytes_freed);
+    stats["open_node_releases"] = std::to_string(num_releases);
+    stats["open_node_recomputations"] = std::to_string(num_recomputations);
+  }
+
+  [[nodiscard]] size_t get_bytes_freed() const { return bytes_freed; }
+  [[nodiscard]] size_t get_num_releases() const { return num_releases; }
+  [[nodiscard]] size_t get_num_recomputations() const {
+    return num_recomputations;
+  }
+
+private:
+  struct Entry {
+    std::weak_ptr<Node> node;
+    double lower_bound;
+    size_t bytes;
+  };
+
+  static bool is_less_expensive(const Entry &a, const Entry &b) {
+    return a.lower_bound < b.lower_bound;
+  }
+
+  void enforce() {
+    // Drop the nodes that are no longer open and measure the others again,
+    // as their cached distances may have grown.
+    tracked_bytes = 0;
+    auto open_end = std::remove_if(heap.begin(), heap.end(), [](Entry &e) {
+      auto node = e.node.lock();
+      return !node || node->is_pruned() || !node->get_children().empty() ||
+             !node->get_relaxed_solution().is_computed();
+    });
+    heap.erase(open_end, heap.end());
+    for (auto &entry : heap) {
+      entry.lower_bound = entry.node.lock()->get_lower_bound();
+      entry.bytes =
+          entry.node.lock()->get_relaxed_solution().get_computed_data_size();
+      tracked_bytes += entry.bytes;
+    }
+    std::make_heap(heap.begin(), heap.end(), is_less_expensive);
+    // Free a bit more than necessary, such that this is not repeated for
+    // every new node.
+    const size_t target = memory_budget / 4 * 3;
+    while (tracked_bytes > target && !heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), is_less_expensive);
+      auto node = heap.back().node.lock();
+      tracked_bytes -= heap.back().bytes;
+      heap.pop_back();
+      bytes_freed += node->release_relaxed_solution();
+      ++num_releases;
+    }
+  }
+
+  size_t memory_budget;
+  size_t tracked_bytes = 0;
+  std::vector<Entry> heap; // the highest lower bound on top
+  size_t bytes_freed = 0;
+  size_t num_releases = 0;
+  size_t num_recomputations = 0;
+};
+
+TEST_CASE("Open Node Budget") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto root = make_node(std::vector<int>{0, 2, 3}, &instance);
+  std::vector<std::shared_ptr<Node>> children = {
+      make_node(std::vector<int>{0, 1, 2, 3}, &instance, root.get()),
+      make_node(std::vector<int>{1, 0, 2, 3}, &instance, root.get())};
+  Node::trigger_lazy_evaluation({children[0].get(), children[1].get()});
+  const double obj = children[0]->obj();
+  const double lb = children[0]->get_lower_bound();
+  OpenNodeBudget budget(1);
+  budget.add(children);
+  CHECK(budget.get_num_releases() == 2);
+  CHECK(budget.get_bytes_freed() > 0);
+  CHECK(!children[0]->get_relaxed_solution().is_computed());
+  CHECK(children[0]->get_lower_bound() == lb);
+  budget.on_explore(*children[0]);
+  CHECK(budget.get_num_recomputations() == 1);
+  CHECK(children[0]->get_relaxed_solution().is_computed());
+  CHECK(children[0]->obj() == doctest::Approx(obj));
+  CHECK(children[0]->get_fixed_sequence() == std::vector<int>{0, 1, 2, 3});
+}
+} // namespace cetsp::details
+#endif // CETSP_OPEN_NODE_BUDGET_H
@@ -0,0 +1,70 @@
+/**
+ * When the upper bound improves, many open nodes may become dominated. They
+ * would only be dropped when the search reaches them, which may be never for
+ * a depth first search, so their memory is held for the rest of the run.
+ * The open nodes are therefore purged in one pass over the storage of the
+ * search.
+ */
+#ifndef CETSP_OPEN_NODE_PURGE_H
+#define CETSP_OPEN_NODE_PURGE_H
+#include "cetsp/node.h"
+#include "doctest/doctest.h"
+#include <memory>
+
+namespace cetsp::details {
+
+struct PurgeStatistics {
+  size_t num_nodes = 0; // pruned by the purge
+  size_t bytes_freed = 0; // estimated
+
+  PurgeStatistics &operator+=(const PurgeStatistics &other) {
+    num_nodes += other.num_nodes;
+    bytes_freed += other.bytes_freed;
+    return *this;
+  }
+};
+
+/**
+ * Prunes the open node if its lower bound reaches the limit and frees its
+ * relaxed solution. Nodes that were already pruned are dropped as well but
+ * not counted as purged.
+ * @return True if the node can be dropped from the open nodes, i.e., it is
+ * pruned.
+ */
+inline bool purge_if_dominated(Node &node, const double lower_bound_limit,
+                               PurgeStatistics &stats) {
+  if (!node.is_pruned()) {
+    if (node.get_lower_bound() < lower_bound_limit) {
+      return false;
+    }
+    node.prune(false);
+    ++stats.num_nodes;
+  }
+  stats.bytes_freed += node.release_relaxed_solution();
+  return true;
+}
+
+TEST_CASE("Purge Dominated Node") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto node = make_node(std::vector<int>{0, 2, 3}, &instance);
+  PurgeStatistics stats;
+  CHECK(!purge_if_dominated(*node, node->get_lower_bound() + 1.0, stats));
+  CHECK(!node->is_pruned());
+  CHECK(purge_if_dominated(*node, node->get_lower_bound(), stats));
+  CHECK(node->is_pruned());
+  CHECK(stats.num_nodes == 1);
+  CHECK(stats.bytes_freed > 0);
+}
+
+TEST_CASE("Purge Pruned Node") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto node = make_node(std::vector<int>{0, 2, 3}, &instance);
+  node->prune(false);
+  PurgeStatistics stats;
+  CHECK(purge_if_dominated(*node, node->get_lower_bound() + 1.0, stats));
+  CHECK(stats.num_nodes == 0);
+  CHECK(purge_if_dominated(*node, node->get_lower_bound(), stats));
+  CHECK(stats.num_nodes == 0);
+}
+} // namespace cetsp::details
+#endif // CETSP_OPEN_NODE_PURGE_H
@@ -0,0 +1,104 @@
+/**
+ * The sequences of the nodes only differ from the sequence of their parent
+ * by a single inserted circle. Instead of copying the whole sequence into
+ * every child, a child only records the inserted circle and its position,
+ * and refers to the (shared) record of its parent. The full sequence is
+ * materialized on demand.
+ */
+#ifndef CETSP_SEQUENCE_RECORD_H
+#define CETSP_SEQUENCE_RECORD_H
+#include "cetsp/details/slab_allocator.h"
+#include "doctest/doctest.h"
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cetsp::details {
+class SequenceRecord {
+public:
+  /**
+   * A record with an explicit sequence, e.g., for the root.
+   */
+  explicit SequenceRecord(std::vector<int> sequence_)
+      : length{sequence_.size()}, sequence{std::move(sequence_)} {}
+
+  /**
+   * A record for the sequence of `base` with `circle` inserted at
+   * `position`.
+   */
+  SequenceRecord(std::shared_ptr<const SequenceRecord> base_, int circle,
+                 int position)
+      : base{std::move(base_)}, circle{circle}, position{position},
+        length{base->size() + 1}, num_deltas{base->num_deltas + 1} {
+    assert(0 <= position && position <= static_cast<int>(base->size()));
+  }
+
+  [[nodiscard]] size_t size() const { return length; }
+
+  [[nodiscard]] bool is_explicit() const { return base == nullptr; }
+
+  /**
+   * The number of insertions that have to be applied to materialize the
+   * sequence. Long chains should be cut by an explicit record.
+   */
+  [[nodiscard]] int get_num_deltas() const { return num_deltas; }
+
+  /**
+   * The sequence of an explicit record.
+   */
+  [[nodiscard]] const std::vector<int> &get_explicit_sequence() const {
+    assert(is_explicit());
+    return sequence;
+  }
+
+  /**
+   * Builds the full sequence by applying the insertions since the last
+   * explicit record.
+   */
+  [[nodiscard]] std::vector<int> materialize() const {
+    std::vector<const SequenceRecord *> deltas;
+    const SequenceRecord *record = this;
+    for (; !record->is_explicit(); record = record->base.get()) {
+      deltas.push_back(record);
+    }
+    std::vector<int> result;
+    result.reserve(length);
+    result = record->sequence;
+    for (auto it = deltas.rbegin(); it != deltas.rend(); ++it) {
+      result.insert(result.begin() + (*it)->position, (*it)->circle);
+    }
+    return result;
+  }
+
+private:
+  std::shared_ptr<const SequenceRecord> base;
+  int circle = -1;
+  int position = -1;
+  size_t length;
+  int num_deltas = 0;
+  std::vector<int> sequence; // only for explicit records
+};
+
+/**
+ * Creates a record in the slab of the records, together with the control
+ * block of the shared pointer. Every child of a branching gets one.
+ */
+template <typename... Args>
+std::shared_ptr<const SequenceRecord> make_sequence_record(Args &&...args) {
+  return std::allocate_shared<SequenceRecord>(
+      SlabAllocator<SequenceRecord>(), std::forward<Args>(args)...);
+}
+
+TEST_CASE("Sequence Record") {
+  auto root = std::make_shared<const SequenceRecord>(std::vector<int>{0, 1, 2});
+  auto child = make_sequence_record(root, 3, 1);
+  auto grandchild = make_sequence_record(child, 4, 4);
+  CHECK(child->materialize() == std::vector<int>{0, 3, 1, 2});
+  CHECK(grandchild->materialize() == std::vector<int>{0, 3, 1, 2, 4});
+  CHECK(grandchild->size() == 5);
+  CHECK(grandchild->get_num_deltas() == 2);
+  CHECK(root->materialize() == root->get_explicit_sequence());
+}
+} // namespace cetsp::details
+#endif // CETSP_SEQUENCE_RECORD_H
@@ -0,0 +1,288 @@
+/**
+ * A slab allocator for objects that are created and destroyed in large
+ * numbers, i.e., the nodes of the BnB-tree. The memory is taken in large
+ * slabs and split into blocks of the same size, so creating a node does not
+ * go through the general allocator and the nodes do not fragment the heap.
+ *
+ * Every thread has a small cache of free blocks, such that the global pool
+ * is only locked for every batch of allocations. Blocks can be freed by any
+ * thread. The slabs are only returned to the system at the end of the
+ * program, but the freed blocks are reused for the next nodes.
+ *
+ * `SlabAllocator` places single objects, i.e., the nodes and the records of
+ * their sequences, together with the control blocks of their shared
+ * pointers. `PoolAllocator` places the buffers of the vectors of a node,
+ * i.e., the cached distances, in slabs of power-of-two sized blocks. The
+ * trajectories and their spanning flags still use the general allocator, as
+ * they are passed as plain vectors to the solvers and the Python bindings.
+ */
+#ifndef CETSP_SLAB_ALLOCATOR_H
+#define CETSP_SLAB_ALLOCATOR_H
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace cetsp::details {
+
+template <size_t BlockSize> class SlabPool {
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+  static_assert(BlockSize >= sizeof(FreeBlock));
+  static constexpr size_t BATCH_SIZE = 64;
+  static constexpr size_t SLAB_SIZE = 1 << 20;
+
+public:
+  static void *allocate() {
+    auto &cache = get_cache();
+    if (cache.head == nullptr) {
+      instance().refill(cache);
+    }
+    FreeBlock *block = cache.head;
+    cache.head = block->next;
+    --cache.size;
+    return block;
+  }
+
+  static void deallocate(void *p) {
+    auto &cache = get_cache();
+    auto *block = static_cast<FreeBlock *>(p);
+    block->next = cache.head;
+    cache.head = block;
+    ++cache.size;
+    if (cache.size >= 2 * BATCH_SIZE) {
+      instance().give_back(cache, BATCH_SIZE);
+    }
+  }
+
+  /**
+   * The number of bytes taken from the system, for statistics.
+   */
+  static size_t reserved_bytes() {
+    auto &pool = instance();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    return pool.slabs.size() * SLAB_SIZE;
+  }
+
+private:
+  struct Cache {
+    FreeBlock *head = nullptr;
+    size_t size = 0;
+    ~Cache() { instance().give_back(*this, size); }
+  };
+
+  static Cache &get_cache() {
+    thread_local Cache cache;
+    return cache;
+  }
+
+  static SlabPool &instance() {
+    // never destroyed, as the thread caches may be destroyed after it
+    static auto *pool = new SlabPool();
+    return *pool;
+  }
+
+  void refill(Cache &cache) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < BATCH_SIZE; ++i) {
+      if (free_blocks == nullptr) {
+        allocate_slab();
+      }
+      FreeBlock *block = free_blocks;
+      free_blocks = block->next;
+      block->next = cache.head;
+      cache.head = block;
+      ++cache.size;
+    }
+  }
+
+  void give_back(Cache &cache, size_t n) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < n && cache.head != nullptr; ++i) {
+      FreeBlock *block = cache.head;
+      cache.head = block->next;
+      --cache.size;
+      block->next = free_blocks;
+      free_blocks = block;
+    }
+  }
+
+  void allocate_slab() {
+    slabs.emplace_back(new std::byte[SLAB_SIZE]);
+    std::byte *slab = slabs.back().get();
+    for (size_t offset = 0; offset + BlockSize <= SLAB_SIZE;
+         offset += BlockSize) {
+      auto *block = reinterpret_cast<FreeBlock *>(slab + offset);
+      block->next = free_blocks;
+      free_blocks = block;
+    }
+  }
+
+  std::mutex mutex;
+  FreeBlock *free_blocks = nullptr;
+  std::vector<std::unique_ptr<std::byte[]>> slabs;
+};
+
+/**
+ * An allocator for `std::allocate_shared`, which places the object and the
+ * control block of the shared pointer in one block of a slab.
+ */
+template <typename T> class SlabAllocator {
+  // blocks are aligned to the maximal fundamental alignment
+  static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+  static constexpr size_t BLOCK_SIZE =
+      (sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  static_assert(alignof(T) <= ALIGNMENT);
+
+public:
+  using value_type = T;
+
+  SlabAllocator() = default;
+  template <typename U> SlabAllocator(const SlabAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    if (n != 1) {
+      return std::allocator<T>().allocate(n);
+    }
+    return static_cast<T *>(SlabPool<BLOCK_SIZE>::allocate());
+  }
+
+  void deallocate(T *p, size_t n) {
+    if (n != 1) {
+      std::allocator<T>().deallocate(p, n);
+      return;
+    }
+    SlabPool<BLOCK_SIZE>::deallocate(p);
+  }
+
+  template <typename U> bool operator==(const SlabAllocator<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const SlabAllocator<U> &) const {
+    return false;
+  }
+};
+
+/**
+ * An allocator for the buffers of vectors. The sizes are rounded up to the
+ * next power of two and taken from the slab pool of that block size. Larger
+ * buffers than `MAX_POOLED_BYTES` come from the general allocator.
+ */
+template <typename T> class PoolAllocator {
+  static constexpr size_t MIN_POOLED_BYTES = 64;
+  static constexpr size_t NUM_SIZE_CLASSES = 9;
+  static_assert(alignof(T) <= alignof(std::max_align_t));
+
+public:
+  static constexpr size_t MAX_POOLED_BYTES = MIN_POOLED_BYTES
+                                             << (NUM_SIZE_CLASSES - 1);
+  using value_type = T;
+
+  PoolAllocator() = default;
+  template <typename U> PoolAllocator(const PoolAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    if (n * sizeof(T) > MAX_POOLED_BYTES) {
+      return std::allocator<T>().allocate(n);
+    }
+    return static_cast<T *>(
+        allocate_block(get_size_class(n * sizeof(T)),
+                       std::make_index_sequence<NUM_SIZE_CLASSES>()));
+  }
+
+  void deallocate(T *p, size_t n) {
+    if (n * sizeof(T) > MAX_POOLED_BYTES) {
+      std::allocator<T>().deallocate(p, n);
+      return;
+    }
+    deallocate_block(p, get_size_class(n * sizeof(T)),
+                     std::make_index_sequence<NUM_SIZE_CLASSES>());
+  }
+
+  template <typename U> bool operator==(const PoolAllocator<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const PoolAllocator<U> &) const {
+    return false;
+  }
+
+private:
+  static size_t get_size_class(const size_t bytes) {
+    size_t size_class = 0;
+    while ((MIN_POOLED_BYTES << size_class) < bytes) {
+      ++size_class;
+    }
+    return size_class;
+  }
+
+  template <size_t... I>
+  static void *allocate_block(const size_t size_class,
+                              std::index_sequence<I...>) {
+    static void *(*const pools[])() = {
+        &SlabPool<(MIN_POOLED_BYTES << I)>::allocate...};
+    return pools[size_class]();
+  }
+
+  template <size_t... I>
+  static void deallocate_block(void *p, const size_t size_class,
+                               std::index_sequence<I...>) {
+    static void (*const pools[])(void *) = {
+        &SlabPool<(MIN_POOLED_BYTES << I)>::deallocate...};
+    pools[size_class](p);
+  }
+};
+
+TEST_CASE("Slab Allocator") {
+  struct Payload {
+    double x;
+    std::vector<int> values;
+  };
+  std::vector<std::shared_ptr<Payload>> objects;
+  for (int i = 0; i < 1000; ++i) {
+    objects.push_back(std::allocate_shared<Payload>(SlabAllocator<Payload>(),
+                                                    Payload{1.0 * i, {i}}));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    CHECK(objects[i]->x == 1.0 * i);
+    CHECK(objects[i]->values.front() == i);
+  }
+  objects.clear();
+  // freed blocks are reused
+  SlabAllocator<Payload> allocator;
+  auto *block = allocator.allocate(1);
+  allocator.deallocate(block, 1);
+  CHECK(allocator.allocate(1) == block);
+  allocator.deallocate(block, 1);
+}
+
+TEST_CASE("Pool Allocator") {
+  // buffers of all size classes, and beyond
+  std::vector<std::vector<double, PoolAllocator<double>>> buffers;
+  for (size_t n = 1; n <= 4 * PoolAllocator<double>::MAX_POOLED_BYTES / 8;
+       n = 2 * n + 1) {
+    buffers.emplace_back(n, 1.0 * n);
+  }
+  for (auto &buffer : buffers) {
+    buffer.push_back(-1.0); // grows into the next size class
+  }
+  for (const auto &buffer : buffers) {
+    const auto n = buffer.size() - 1;
+    CHECK(std::count(buffer.begin(), buffer.end(), 1.0 * n) ==
+          static_cast<long>(n));
+    CHECK(buffer.back() == -1.0);
+  }
+  buffers.clear();
+  // freed blocks are reused by buffers of the same size class
+  PoolAllocator<char> allocator;
+  auto *block = allocator.allocate(1000);
+  allocator.deallocate(block, 1000);
+  CHECK(allocator.allocate(1024) == block);
+  allocator.deallocate(block, 1024);
+}
+} // namespace cetsp::details
+#endif // CETSP_SLAB_ALLOCATOR_H
@@ -9,12 +9,19 @@
 
 #include "cetsp/common.h"
 #include "cetsp/relaxed_solution.h"
+#include <atomic>
+#include <mutex>
 
 namespace cetsp {
 class SolutionPool {
+  /**
+   * The pool is shared by all threads of the search, so all operations are
+   * thread-safe.
+   */
 public:
   void add_solution(const Solution &solution) {
     auto solution_length = solution.get_trajectory().length();
+    std::lock_guard<std::mutex> lock(mutex);
     if (solution_length < ub) {
       solutions.push_back(solution);
       ub = solution_length;
@@ -23,6 +30,7 @@ public:
   double get_upper_bound() { return ub; }
 
   std::unique_ptr<Solution> get_best_solution() {
+    std::lock_guard<std::mutex> lock(mutex);
     if (solutions.empty()) {
       return nullptr;
     }
@@ -30,11 +38,16 @@ public:
         solutions.back()); // best solution is always at the end
   }
 
-  bool empty() { return solutions.empty(); }
+  bool empty() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return solutions.empty();
+  }
 
 private:
-  double ub = std::numeric_limits<double>::infinity();
+  // only written under the lock, but read without it
+  std::atomic<double> ub = std::numeric_limits<double>::infinity();
   std::vector<Solution> solutions;
+  std::mutex mutex;
 };
 } // namespace cetsp
 #endif // CETSP_SOLUTION_POOL_H
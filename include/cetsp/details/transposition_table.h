@@ -0,0 +1,220 @@
+/**
+ * The same circle sequence can be reached on different paths through the
+ * BnB-tree, e.g., by inserting a and then b or by inserting b and then a.
+ * As the subtree of a node only depends on its sequence, it is sufficient
+ * to explore only one of these nodes. The transposition table remembers the
+ * sequences of the created nodes, such that the duplicates can be dropped.
+ *
+ * For tours, the sequences are normalized with respect to rotation and
+ * reversal, as these describe the same tour.
+ */
+#ifndef CETSP_TRANSPOSITION_TABLE_H
+#define CETSP_TRANSPOSITION_TABLE_H
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace cetsp::details {
+
+/**
+ * Returns a unique representative of the sequence. For tours, the sequence
+ * is rotated to start with its smallest circle and then directed towards
+ * the smaller neighbor. Paths are returned as they are, as their ends are
+ * fixed.
+ */
+inline std::vector<int> canonical_sequence(const std::vector<int> &sequence,
+                                           bool tour) {
+  if (!tour || sequence.size() <= 1) {
+    return sequence;
+  }
+  const int n = static_cast<int>(sequence.size());
+  const int start = static_cast<int>(
+      std::distance(sequence.begin(),
+                    std::min_element(sequence.begin(), sequence.end())));
+  // The circles of a sequence are unique, so comparing the neighbors
+  // decides the lexicographic order of the two directions.
+  const int direction =
+      sequence[(start + 1) % n] <= sequence[(start + n - 1) % n] ? 1 : n - 1;
+  std::vector<int> canonical;
+  canonical.reserve(n);
+  for (int i = 0; i < n; ++i) {
+    canonical.push_back(sequence[(start + i * direction) % n]);
+  }
+  return canonical;
+}
+
+class TranspositionTable {
+public:
+  static constexpr size_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+
+  /**
+   * @param memory_budget The (estimated) memory in bytes the table may use.
+   * If exhausted, no further sequences are recorded, but the recorded ones
+   * are still detected.
+   */
+  explicit TranspositionTable(size_t memory_budget = DEFAULT_MEMORY_BUDGET)
+      : memory_budget{memory_budget} {}
+
+  /**
+   * Records the sequence. Thread-safe.
+   * @param sequence The sequence of a new node.
+   * @param tour If the sequence describes a tour instead of a path.
+   * @return False if the sequence (or an equivalent one) has already been
+   * recorded, i.e., the node is a duplicate.
+   */
+  bool insert(const std::vector<int> &sequence, bool tour) {
+    auto canonical = canonical_sequence(sequence, tour);
+    const auto hash = SequenceHash{}(canonical);
+    auto &shard = shards[hash % NUM_SHARDS];
+    ++lookups;
+    const size_t required = estimate_memory(canonical);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.sequences.count(canonical) > 0) {
+      ++hits;
+      return false;
+    }
+    if (memory_usage.fetch_add(required) + required > memory_budget) {
+      memory_usage -= required;
+      return true;
+    }
+    shard.sequences.insert(std::move(canonical));
+    ++entries;
+    return true;
+  }
+
+  void clear() {
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.sequences.clear();
+    }
+    lookups = 0;
+    hits = 0;
+    entries = 0;
+    memory_usage = 0;
+  }
+
+  void set_memory_budget(size_t budget) { memory_budget = budget; }
+
+  size_t num_lookups() const { return lookups; }
+  size_t num_hits() const { return hits; }
+  size_t size() const { return entries; }
+  size_t get_memory_usage() const { return memory_usage; }
+
+  double hit_rate() const {
+    const size_t n = lookups;
+    return n == 0 ? 0.0 : static_cast<double>(hits) / n;
+  }
+
+private:
+  struct SequenceHash {
+    size_t operator()(const std::vector<int> &sequence) const {
+      size_t seed = sequence.size();
+      for (auto i : sequence) {
+        seed ^= std::hash<int>()(i) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      }
+      return seed;
+    }
+  };
+
+  static size_t estimate_memory(const std::vector<int> &sequence) {
+    // the vector, its content, and the node and bucket of the hash set
+    return sizeof(std::vector<int>) + sequence.size() * sizeof(int) +
+           4 * sizeof(void *);
+  }
+
+  static constexpr size_t NUM_SHARDS = 16;
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_set<std::vector<int>, SequenceHash> sequences;
+  };
+  std::array<Shard, NUM_SHARDS> shards;
+  size_t memory_budget;
+  std::atomic<size_t> memory_usage{0};
+  std::atomic<size_t> lookups{0};
+  std::atomic<size_t> hits{0};
+  std::atomic<size_t> entries{0};
+};
+
+TEST_CASE("Canonical Sequence") {
+  using V = std::vector<int>;
+  CHECK(canonical_sequence({3, 1, 4, 2}, true) == V{1, 3, 2, 4});
+  CHECK(canonical_sequence({2, 4, 1, 3}, true) == V{1, 3, 2, 4});
+  CHECK(canonical_sequence({4, 2, 1, 3}, true) == V{1, 2, 4, 3});
+  CHECK(canonical_sequence({3, 1, 4, 2}, false) == V{3, 1, 4, 2});
+  CHECK(canonical_sequence({}, true).empty());
+}
+
+TEST_CASE("Transposition Table") {
+  TranspositionTable table;
+  CHECK(table.insert({0, 1, 2, 3}, true));
+  CHECK(!table.insert({2, 3, 0, 1}, true));
+  CHECK(!table.insert({3, 2, 1, 0}, true));
+  CHECK(table.insert({0, 2, 1, 3}, true));
+  // paths are not normalized
+  CHECK(table.insert({3, 2, 1, 0}, false));
+  CHECK(!table.insert({3, 2, 1, 0}, false));
+  CHECK(table.num_lookups() == 6);
+  CHECK(table.num_hits() == 3);
+  CHECK(table.size() == 3);
+  // Without memory, nothing is recorded and hence nothing is detected.
+  TranspositionTable empty_table(0);
+  CHECK(empty_table.insert({0, 1, 2}, true));
+  CHECK(empty_table.insert({0, 1, 2}, true));
+  CHECK(empty_table.size() == 0);
+  table.clear();
+  CHECK(table.size() == 0);
+  CHECK(table.num_lookups() == 0);
+  CHECK(table.get_memory_usage() == 0);
+  CHECK(table.insert({2, 3, 0, 1}, true));
+}
+
+TEST_CASE("Transposition Table Memory Budget") {
+  TranspositionTable table;
+  CHECK(table.insert({0, 1, 2}, true));
+  const auto usage = table.get_memory_usage();
+  CHECK(usage > 0);
+  // room for exactly one more sequence of the same length
+  table.set_memory_budget(2 * usage);
+  CHECK(table.insert({3, 4, 5}, true));
+  CHECK(table.get_memory_usage() == 2 * usage);
+  CHECK(table.insert({6, 7, 8}, true));
+  CHECK(table.insert({6, 7, 8}, true));
+  CHECK(table.size() == 2);
+  CHECK(table.get_memory_usage() == 2 * usage);
+  // The recorded sequences are still detected.
+  CHECK(!table.insert({1, 2, 0}, true));
+  CHECK(!table.insert({5, 4, 3}, true));
+}
+
+TEST_CASE("Concurrent Transposition Table") {
+  // Every thread tries to create all rotations of the same tours, but only
+  // the first node of every tour may be kept.
+  TranspositionTable table;
+  const int num_tours = 100, num_threads = 4;
+  std::atomic<int> num_created{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int k = 0; k < num_tours; ++k) {
+        std::vector<int> tour = {k, num_tours + k, 2 * num_tours + k};
+        std::rotate(tour.begin(), tour.begin() + t % 3, tour.end());
+        if (table.insert(tour, true)) {
+          ++num_created;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  CHECK(num_created == num_tours);
+  CHECK(table.size() == static_cast<size_t>(num_tours));
+  CHECK(table.num_hits() == static_cast<size_t>((num_threads - 1) * num_tours));
+}
+} // namespace cetsp::details
+#endif // CETSP_TRANSPOSITION_TABLE_H
@@ -0,0 +1,144 @@
+/**
+ * The open nodes of the parallel search. Every worker has its own deque, from
+ * which it takes the most recent node (depth first). If its deque is empty,
+ * it steals the oldest node of another worker, which usually has the largest
+ * subtree left.
+ */
+#ifndef CETSP_WORK_STEALING_QUEUES_H
+#define CETSP_WORK_STEALING_QUEUES_H
+#include "cetsp/details/open_node_purge.h"
+#include "cetsp/node.h"
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cetsp::details {
+class WorkStealingQueues {
+public:
+  explicit WorkStealingQueues(size_t num_workers) : queues(num_workers) {}
+
+  void push(size_t worker, std::shared_ptr<Node> node) {
+    ++num_pending;
+    auto &queue = queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.nodes.push_back(std::move(node));
+  }
+
+  /**
+   * Returns the next node for the worker or nullptr, if no node is available
+   * right now. A node stays pending until `done` is called for it, as it may
+   * still create new nodes.
+   */
+  std::shared_ptr<Node> pop(size_t worker) {
+    auto node = pop_back(queues[worker]);
+    for (size_t i = 1; !node && i < queues.size(); ++i) {
+      node = steal(queues[(worker + i) % queues.size()]);
+    }
+    return node;
+  }
+
+  /**
+   * Has to be called after a node returned by `pop` has been processed and
+   * its children have been pushed.
+   */
+  void done() { --num_pending; }
+
+  /**
+   * True if all nodes have been processed and no new ones can appear.
+   */
+  bool finished() const { return num_pending == 0; }
+
+  size_t num_workers() const { return queues.size(); }
+
+  /**
+   * Drops the nodes that cannot improve the upper bound anymore, see
+   * details::purge_if_dominated. The queues are locked one after another,
+   * so the workers can continue meanwhile.
+   */
+  PurgeStatistics purge(const double lower_bound_limit) {
+    PurgeStatistics stats;
+    for (auto &queue : queues) {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      const auto size = queue.nodes.size();
+      queue.nodes.erase(std::remove_if(queue.nodes.begin(), queue.nodes.end(),
+                                       [&](std::shared_ptr<Node> &node) {
+                                         return purge_if_dominated(
+                                             *node, lower_bound_limit, stats);
+                                       }),
+                        queue.nodes.end());
+      num_pending -= size - queue.nodes.size();
+    }
+    return stats;
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::shared_ptr<Node>> nodes;
+  };
+
+  std::shared_ptr<Node> pop_back(Queue &queue) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    while (!queue.nodes.empty()) {
+      auto node = std::move(queue.nodes.back());
+      queue.nodes.pop_back();
+      if (!node->is_pruned()) {
+        return node;
+      }
+      --num_pending;
+    }
+    return nullptr;
+  }
+
+  std::shared_ptr<Node> steal(Queue &queue) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    while (!queue.nodes.empty()) {
+      auto node = std::move(queue.nodes.front());
+      queue.nodes.pop_front();
+      if (!node->is_pruned()) {
+        return node;
+      }
+      --num_pending;
+    }
+    return nullptr;
+  }
+
+  std::vector<Queue> queues;
+  // nodes in the queues or being processed
+  std::atomic<size_t> num_pending{0};
+};
+
+TEST_CASE("Work Stealing Queues") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto a = std::make_shared<Node>(std::vector<int>{0, 1, 2}, &instance);
+  auto b = std::make_shared<Node>(std::vector<int>{0, 1, 3}, &instance);
+  auto c = std::make_shared<Node>(std::vector<int>{0, 2, 3}, &instance);
+  WorkStealingQueues queues(2);
+  CHECK(queues.finished());
+  queues.push(0, a);
+  queues.push(0, b);
+  queues.push(0, c);
+  // the owner works depth first, the thief takes the oldest node
+  CHECK(queues.pop(0) == c);
+  CHECK(queues.pop(1) == a);
+  b->prune();
+  CHECK(queues.pop(1) == nullptr);
+  CHECK(!queues.finished());
+  queues.done();
+  queues.done();
+  CHECK(queues.finished());
+  queues.push(0, a);
+  queues.push(1, c);
+  const auto purged = queues.purge(c->get_lower_bound());
+  CHECK(purged.num_nodes == 1);
+  CHECK(c->is_pruned());
+  CHECK(queues.pop(1) == a);
+  queues.done();
+  CHECK(queues.finished());
+}
+} // namespace cetsp::details
+#endif // CETSP_WORK_STEALING_QUEUES_H
@@ -4,10 +4,17 @@
 #ifndef CETSP_NODE_H
 #define CETSP_NODE_H
 #include "cetsp/common.h"
+#include "cetsp/details/lower_bound_tracker.h"
+#include "cetsp/details/slab_allocator.h"
 #include "cetsp/soc.h"
 #include "doctest/doctest.h"
 #include "relaxed_solution.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <optional>
 namespace cetsp {
@@ -29,28 +36,147 @@ public:
 class Node {
 public:
   Node(Node &node) = delete;
-  Node(Node &&node) = default;
+  Node(Node &&node) = delete;
   explicit Node(std::vector<int> branch_sequence_, Instance *instance,
                 Node *parent = nullptr)
       : _relaxed_solution(instance, std::move(branch_sequence_)),
-        parent{parent}, instance{instance} {
+        parent{parent}, tree_mutex{get_tree_mutex(parent)},
+        instance{instance} {
     if (parent != nullptr) {
       _depth = parent->depth() + 1;
     }
   }
 
+  /**
+   * A node whose sequence is only recorded as an insertion into the sequence
+   * of its parent, see details::SequenceRecord.
+   */
+  Node(std::shared_ptr<const details::SequenceRecord> record,
+       Instance *instance, Node *parent)
+      : _relaxed_solution(instance, std::move(record)), parent{parent},
+        tree_mutex{get_tree_mutex(parent)}, instance{instance} {
+    if (parent != nullptr) {
+      _depth = parent->depth() + 1;
+    }
+  }
+
+  /**
+   * See PartialSequenceSolution::set_parent_trajectory.
+   */
+  void set_parent_trajectory(
+      std::shared_ptr<const details::ParentTrajectory> parent_trajectory,
+      int inserted_at) {
+    _relaxed_solution.set_parent_trajectory(std::move(parent_trajectory),
+                                            inserted_at);
+  }
+
+  /**
+   * See PartialSequenceSolution::set_parent_coverage.
+   */
+  void set_parent_coverage(
+      std::shared_ptr<const details::ParentCoverage> parent_coverage) {
+    _relaxed_solution.set_parent_coverage(std::move(parent_coverage));
+  }
+
   void trigger_lazy_evaluation() {
     _relaxed_solution.trigger_lazy_computation(true);
   }
 
+  /**
+   * Evaluates multiple nodes at once, e.g., the children of a node.
+   * @param cutoff The evaluation may stop early for nodes whose relaxed
+   * solution is proved to be longer, e.g., the upper bound. Their lower
+   * bound is the bound reached, see PartialSequenceSolution::is_above_cutoff.
+   * @param loose Only compute the relaxed solutions loosely, see
+   * PartialSequenceSolution::is_exact. The lower bounds stay certified.
+   */
+  static void trigger_lazy_evaluation(
+      const std::vector<Node *> &nodes,
+      double cutoff = std::numeric_limits<double>::infinity(),
+      bool loose = false) {
+    std::vector<const PartialSequenceSolution *> solutions;
+    solutions.reserve(nodes.size());
+    for (auto *node : nodes) {
+      solutions.push_back(&node->_relaxed_solution);
+    }
+    PartialSequenceSolution::trigger_lazy_computation(solutions, true, cutoff,
+                                                      loose);
+  }
+
+  ~Node();
+
+  /**
+   * Raises the lower bound and propagates it to the subtree. The ancestors
+   * only take it into account when their lower bound is requested. The
+   * bounds and the pruning are thread-safe, such that multiple threads can
+   * work on different nodes of the same tree.
+   */
   void add_lower_bound(double lb);
 
   auto get_lower_bound() -> double;
 
+  /**
+   * Registers the node as an open leaf in the tracker of the global lower
+   * bound. When it branches, its children replace it in the tracker, and
+   * when it is pruned, it is removed. Only for nodes that do not move in
+   * memory, e.g., the nodes created by `make_node`.
+   */
+  void track_lower_bound(details::LowerBoundTracker *tracker);
+
+  /**
+   * Removes the node from the lower bound tracker, but its lower bound still
+   * counts for the tree, e.g., because it is feasible.
+   */
+  void retire_lower_bound();
+
   bool is_feasible();
 
   double obj() { return _relaxed_solution.obj(); }
 
+  /**
+   * Defers the evaluation of the relaxed solution until the node is selected
+   * by the search. Until then, the node has the lower bound of its parent
+   * and the search orders it by the given estimate of its objective. Has to
+   * be called before the node is added to the tree.
+   */
+  void defer_evaluation(double objective_estimate);
+
+  [[nodiscard]] bool is_deferred() const {
+    return deferred_objective_estimate.has_value();
+  }
+
+  /**
+   * Computes the relaxed solution of a deferred node and raises its lower
+   * bound accordingly.
+   * @param cutoff See `trigger_lazy_evaluation`.
+   * @param loose See `trigger_lazy_evaluation`.
+   */
+  void evaluate_deferred(
+      double cutoff = std::numeric_limits<double>::infinity(),
+      bool loose = false);
+
+  /**
+   * Recomputes a loose relaxed solution exactly, e.g., before it is used as
+   * a solution, and raises the lower bound accordingly.
+   * @return True if the relaxed solution has changed.
+   */
+  bool refine();
+
+  /**
+   * The objective of the relaxed solution, or its estimate if the evaluation
+   * is deferred or has stopped at the cutoff. Use this to order open nodes
+   * without evaluating them.
+   */
+  double get_objective_estimate() {
+    if (is_deferred()) {
+      return *deferred_objective_estimate;
+    }
+    if (_relaxed_solution.is_above_cutoff()) {
+      return _relaxed_solution.get_cutoff_bound();
+    }
+    return obj();
+  }
+
   void branch(std::vector<std::shared_ptr<Node>> &children_);
 
   [[nodiscard]] const std::vector<std::shared_ptr<Node>> &get_children() const {
@@ -68,7 +194,8 @@ public:
   /**
    * Will prune the node, i.e., mark it as not leading to an optimal solution
    * and thus stopping at it. Pruned nodes are allowed to be deleted from
-   * memory.
+   * memory. The subtree is detached from the node, such that it is freed as
+   * soon as the search strategy drops its pruned nodes.
    */
   void prune(bool infeasible = true);
 
@@ -97,7 +224,30 @@ public:
 
   void simplify() { _relaxed_solution.simplify(); }
 
-  [[nodiscard]] auto is_pruned() const -> bool { return pruned; }
+  /**
+   * Frees the materialized sequence of the node if it can be rebuilt from
+   * its parent. References returned by `get_fixed_sequence` become invalid.
+   */
+  void release_sequence() { _relaxed_solution.release_sequence(); }
+
+  /**
+   * Frees the relaxed solution except for the sequence, e.g., to save memory
+   * for open nodes that will not be explored soon. The lower bound is kept
+   * and the relaxed solution is recomputed lazily.
+   * @return The (estimated) bytes freed.
+   */
+  size_t release_relaxed_solution();
+
+  /**
+   * Shrinks a branched node to what the bound propagation needs, i.e., the
+   * bounds and the links in the tree. The objective and the spanning circles
+   * stay available, only the trajectory is recomputed if it is accessed
+   * again.
+   * @return The (estimated) bytes freed.
+   */
+  size_t compact();
+
+  [[nodiscard]] auto is_pruned() const -> bool;
 
   [[nodiscard]] Instance *get_instance() { return instance; }
 
@@ -106,19 +256,56 @@ public:
   std::vector<TrajectoryIntersection> get_intersections();
 
 private:
+  // A root starts a new tree, all other nodes share the lock of their parent.
+  static std::shared_ptr<std::mutex> get_tree_mutex(Node *parent) {
+    return parent != nullptr ? parent->tree_mutex
+                             : std::make_shared<std::mutex>();
+  }
+
+  // The versions of the public methods for callers holding the tree lock.
+  void add_lower_bound_locked(double lb);
+  double get_lower_bound_locked();
+  void track_lower_bound_locked(details::LowerBoundTracker *tracker);
+  void prune_locked(bool infeasible);
+
   // Check if the children allow to improve the lower bound.
   void reevaluate_children();
 
+  // Marks the bounds of the node and its ancestors as outdated.
+  void invalidate_children_bound();
+
+  // Makes the lower bound readable without the lock, if it is up to date.
+  void publish_lower_bound_locked();
+
   PartialSequenceSolution _relaxed_solution;
   std::optional<double> lazy_lower_bound_value{};
+  // The lower bound if it is up to date, otherwise NaN. The bounds only
+  // increase, so a reader that misses a concurrent update still gets a valid
+  // lower bound without taking the lock.
+  std::atomic<double> published_lower_bound{
+      std::numeric_limits<double>::quiet_NaN()};
+  std::optional<double> deferred_objective_estimate{};
+  bool children_bound_outdated = false;
+  details::LowerBoundTracker::Handle lower_bound_handle;
   std::vector<std::shared_ptr<Node>> children;
   Node *parent;
+  std::shared_ptr<std::mutex> tree_mutex; // guards the bounds and the links
 
   int _depth = 0;
-  bool pruned = false;
+  std::atomic<bool> pruned{false}; // written with the lock, read without
   Instance *instance;
 };
 
+/**
+ * Creates a node in the slab of the nodes, together with the control block of
+ * the shared pointer. Use this for nodes that are created in large numbers,
+ * e.g., in the branching.
+ */
+template <typename... Args> std::shared_ptr<Node> make_node(Args &&...args) {
+  return std::allocate_shared<Node>(details::SlabAllocator<Node>(),
+                                    std::forward<Args>(args)...);
+}
+
 TEST_CASE("Node") {
   Instance seq;
   seq.push_back({{0, 0}, 1});
@@ -131,5 +318,173 @@ TEST_CASE("Node") {
   CHECK(node.is_feasible());
 }
 
+TEST_CASE("Node Prune") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto root = make_node(std::vector<int>{0, 2}, &instance);
+  std::vector<std::shared_ptr<Node>> children = {
+      make_node(std::vector<int>{0, 2, 3}, &instance, root.get())};
+  root->branch(children);
+  std::weak_ptr<Node> child = children.front();
+  children.clear();
+  CHECK(root->get_children().size() == 1);
+  CHECK(root->get_lower_bound() >= child.lock()->obj() - 1e-6);
+  // the pruned subtree is released
+  root->prune();
+  CHECK(root->get_children().empty());
+  CHECK(child.expired());
+}
+
+TEST_CASE("Node Freed Parent") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto root = make_node(std::vector<int>{0, 2}, &instance);
+  std::vector<std::shared_ptr<Node>> children = {
+      make_node(std::vector<int>{0, 2, 3}, &instance, root.get())};
+  root->branch(children);
+  // The child is still open, but its parent is freed without being pruned.
+  root.reset();
+  CHECK(children.front()->get_parent() == nullptr);
+  CHECK(children.front()->get_lower_bound() ==
+        doctest::Approx(children.front()->obj()));
+}
+
+TEST_CASE("Node Compact") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto root = make_node(std::vector<int>{0, 2}, &instance);
+  const double obj = root->obj();
+  std::vector<std::shared_ptr<Node>> children = {
+      make_node(std::vector<int>{0, 2, 3}, &instance, root.get())};
+  root->branch(children);
+  const double lb = root->get_lower_bound();
+  const auto spanning_sequence = root->get_spanning_sequence();
+  CHECK(root->compact() > 0);
+  CHECK(!root->get_relaxed_solution().is_computed());
+  CHECK(root->get_lower_bound() == lb);
+  children.front()->add_lower_bound(lb + 1.0);
+  CHECK(root->get_lower_bound() == doctest::Approx(lb + 1.0));
+  // kept without recomputing the trajectory
+  CHECK(root->obj() == obj);
+  CHECK(root->get_objective_estimate() == obj);
+  CHECK(root->get_spanning_sequence() == spanning_sequence);
+  CHECK(!root->get_relaxed_solution().is_computed());
+  // only the trajectory itself is recomputed
+  CHECK(root->get_relaxed_solution().get_trajectory().length() ==
+        doctest::Approx(obj));
+  CHECK(root->get_relaxed_solution().is_computed());
+}
+
+TEST_CASE("Node Lower Bound Tracker") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  details::LowerBoundTracker tracker;
+  auto root = make_node(std::vector<int>{0, 2}, &instance);
+  root->track_lower_bound(&tracker);
+  CHECK(tracker.get_lower_bound() == root->get_lower_bound());
+  std::vector<std::shared_ptr<Node>> children = {
+      make_node(std::vector<int>{0, 2, 3}, &instance, root.get()),
+      make_node(std::vector<int>{0, 1, 2}, &instance, root.get())};
+  root->branch(children);
+  CHECK(tracker.size() == 2);
+  CHECK(tracker.get_lower_bound() == root->get_lower_bound());
+  children[1]->add_lower_bound(100.0);
+  CHECK(tracker.get_lower_bound() == children[0]->get_lower_bound());
+  CHECK(root->get_lower_bound() == children[0]->get_lower_bound());
+  children[0]->prune(false); // still counts
+  CHECK(tracker.size() == 1);
+  CHECK(tracker.get_lower_bound() == children[0]->get_lower_bound());
+  root->prune();
+  CHECK(tracker.size() == 0);
+}
+
+TEST_CASE("Node Cutoff") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto solver = get_trajectory_solver();
+  set_trajectory_solver(std::make_shared<NativeTrajectorySolver>());
+  // three circles would be solved in closed form
+  auto root = make_node(std::vector<int>{0, 1, 2}, &instance);
+  const double root_lb = root->get_lower_bound();
+  auto child = make_node(std::vector<int>{0, 1, 2, 3}, &instance, root.get());
+  Node::trigger_lazy_evaluation({child.get()}, root_lb);
+  CHECK(child->get_relaxed_solution().is_above_cutoff());
+  const double lb = child->get_lower_bound();
+  CHECK(lb > root_lb);
+  CHECK(child->get_objective_estimate() == lb);
+  CHECK(!child->get_relaxed_solution().is_computed());
+  CHECK(child->obj() >= lb - 1e-6);
+  set_trajectory_solver(solver);
+}
+
+TEST_CASE("Node Deferred Evaluation") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  auto root = make_node(std::vector<int>{0, 2}, &instance);
+  const double root_lb = root->get_lower_bound();
+  auto child = make_node(std::vector<int>{0, 2, 3}, &instance, root.get());
+  child->defer_evaluation(root_lb + 1.0);
+  std::vector<std::shared_ptr<Node>> children = {child};
+  root->branch(children);
+  CHECK(child->is_deferred());
+  CHECK(child->get_lower_bound() == root_lb);
+  CHECK(child->get_objective_estimate() == root_lb + 1.0);
+  CHECK(!child->get_relaxed_solution().is_computed());
+  child->evaluate_deferred();
+  CHECK(!child->is_deferred());
+  CHECK(child->get_relaxed_solution().is_computed());
+  CHECK(child->get_lower_bound() == doctest::Approx(child->obj()));
+  CHECK(root->get_lower_bound() == doctest::Approx(child->obj()));
+}
+
+TEST_CASE("Node Evaluation Without Lock") {
+  // Solves the sequences and checks that the tree is not locked meanwhile.
+  class LockCheckingSolver : public TrajectorySolver {
+  public:
+    std::pair<Trajectory, std::vector<bool>>
+    solve(const std::vector<Circle> &circle_sequence, bool path) override {
+      ++calls;
+      if (root != nullptr) {
+        // does not change the bound, but takes the lock
+        pending.push_back(std::async(
+            std::launch::async, [this]() { root->add_lower_bound(0.0); }));
+        if (pending.back().wait_for(std::chrono::seconds(1)) !=
+            std::future_status::ready) {
+          blocked = true;
+        }
+      }
+      return native.solve(circle_sequence, path);
+    }
+    NativeTrajectorySolver native;
+    Node *root = nullptr;
+    int calls = 0;
+    bool blocked = false;
+    std::vector<std::future<void>> pending;
+  };
+  Instance instance({{{0, 0}, 1},
+                     {{6, 0}, 1},
+                     {{6, 6}, 1},
+                     {{0, 6}, 1},
+                     {{3, 9}, 1},
+                     {{3, -3}, 1}});
+  auto solver = get_trajectory_solver();
+  auto checking_solver = std::make_shared<LockCheckingSolver>();
+  set_trajectory_solver(checking_solver);
+  // three circles would be solved in closed form
+  auto root = make_node(std::vector<int>{0, 1, 2, 3}, &instance);
+  details::LowerBoundTracker tracker;
+  root->track_lower_bound(&tracker);
+  checking_solver->root = root.get();
+  std::vector<std::shared_ptr<Node>> children = {
+      make_node(std::vector<int>{0, 1, 2, 4, 3}, &instance, root.get()),
+      make_node(std::vector<int>{0, 5, 1, 2, 3}, &instance, root.get())};
+  root->branch(children);
+  auto grandchild = make_node(std::vector<int>{0, 5, 1, 2, 4, 3}, &instance,
+                              children[1].get());
+  grandchild->add_lower_bound(0.0);
+  CHECK(checking_solver->calls == 4);
+  CHECK(!checking_solver->blocked);
+  CHECK(tracker.get_lower_bound() ==
+        doctest::Approx(std::min(children[0]->obj(), children[1]->obj())));
+  for (auto &future : checking_solver->pending) {
+    future.get();
+  }
+  set_trajectory_solver(solver);
+}
+
 } // namespace cetsp
 #endif // CETSP_NODE_H
@@ -11,6 +11,7 @@
 #include "cetsp/common.h"
 #include "cetsp/details/distance_cache.h"
 #include "cetsp/details/lazy_trajectory.h"
+#include <limits>
 #include <vector>
 
 namespace cetsp {
@@ -26,7 +27,7 @@ public:
                           double feasibility_tol = 0.001)
       : spanning_trajectory(instance, std::move(sequence_)), instance{instance},
         FEASIBILITY_TOL{feasibility_tol}, distances{instance} {
-    const auto &sequence = spanning_trajectory.sequence;
+    const auto &sequence = spanning_trajectory.get_sequence();
     if (sequence.empty() && !instance->is_path()) {
       throw std::invalid_argument("Cannot trigger_lazy_computation tour "
                                   "trajectory from empty sequence.");
@@ -36,6 +37,16 @@ public:
     }));
   }
 
+  /**
+   * A solution whose sequence is the sequence of `record`'s base with a
+   * single circle inserted. The sequence is only materialized on demand.
+   */
+  PartialSequenceSolution(const Instance *instance,
+                          std::shared_ptr<const details::SequenceRecord> record,
+                          double feasibility_tol = 0.001)
+      : spanning_trajectory(instance, std::move(record)), instance{instance},
+        FEASIBILITY_TOL{feasibility_tol}, distances{instance} {}
+
   bool trigger_lazy_computation(bool with_feasibility = false) const {
     const auto fresh = spanning_trajectory.trigger_computation();
     if (with_feasibility) {
@@ -44,6 +55,30 @@ public:
     return fresh;
   }
 
+  /**
+   * Triggers the lazy computation of multiple solutions at once, such that the
+   * trajectory solver can share its setup between them.
+   */
+  static void trigger_lazy_computation(
+      const std::vector<const PartialSequenceSolution *> &solutions,
+      bool with_feasibility = false,
+      double cutoff = std::numeric_limits<double>::infinity(),
+      bool loose = false) {
+    std::vector<const details::LazyTrajectoryComputation *> batch;
+    batch.reserve(solutions.size());
+    for (const auto *solution : solutions) {
+      batch.push_back(&solution->spanning_trajectory);
+    }
+    details::LazyTrajectoryComputation::compute_batch(batch, cutoff, loose);
+    if (with_feasibility) {
+      for (const auto *solution : solutions) {
+        if (!solution->is_above_cutoff()) {
+          solution->is_feasible();
+        }
+      }
+    }
+  }
+
   /**
    * Returns true if the i-th circle in the sequence is spanning. This
    * information is useful to simplify the solution.
@@ -52,7 +87,6 @@ public:
    * @return True if it spans the trajectory.
    */
   bool is_sequence_index_spanning(int i) const {
-    trigger_lazy_computation();
     return spanning_trajectory.get_spanning_information()[i];
   }
 
@@ -81,15 +115,136 @@ public:
   }
 
   const std::vector<int> &get_sequence() const {
-    return spanning_trajectory.sequence;
+    return spanning_trajectory.get_sequence();
+  }
+
+  const std::shared_ptr<const details::SequenceRecord> &
+  get_sequence_record() const {
+    return spanning_trajectory.get_sequence_record();
+  }
+
+  /**
+   * Frees the materialized sequence, if it can be rebuilt from the record.
+   * References returned by `get_sequence` become invalid.
+   */
+  void release_sequence() const { spanning_trajectory.release_sequence(); }
+
+  /**
+   * The length of the trajectory. Still known after `release_computed_data`,
+   * unless the trajectory was loose.
+   */
+  double obj() const { return spanning_trajectory.get_length(); }
+
+  [[nodiscard]] bool is_computed() const {
+    return spanning_trajectory.is_computed();
+  }
+
+  /**
+   * True if the computation has stopped at the cutoff, as the trajectory is
+   * proved to be longer. Only `get_cutoff_bound` is available without
+   * computing the trajectory completely.
+   */
+  [[nodiscard]] bool is_above_cutoff() const {
+    return spanning_trajectory.is_above_cutoff();
+  }
+
+  /**
+   * The certified lower bound on `obj()` if `is_above_cutoff`.
+   */
+  [[nodiscard]] double get_cutoff_bound() const {
+    return spanning_trajectory.get_cutoff_bound();
   }
 
-  double obj() const { return get_trajectory().length(); }
+  /**
+   * False if the trajectory has only been computed loosely. It is feasible,
+   * but `obj()` may be slightly above the optimum. Use `get_lower_bound`
+   * for pruning and `refine` before the solution is used.
+   */
+  [[nodiscard]] bool is_exact() const { return spanning_trajectory.is_exact(); }
+
+  /**
+   * True if only a window of the parent's trajectory around the inserted
+   * circle had to be re-optimized, see `compute_trajectories_incrementally`.
+   */
+  [[nodiscard]] bool is_incremental() const {
+    return spanning_trajectory.is_incremental();
+  }
+
+  /**
+   * A certified lower bound for the optimal trajectory through the sequence.
+   * Equals `obj()` for an exact trajectory and does not need the trajectory
+   * if `is_above_cutoff`.
+   */
+  [[nodiscard]] double get_lower_bound() const {
+    return spanning_trajectory.get_lower_bound();
+  }
+
+  /**
+   * Recomputes a loose trajectory exactly. The feasibility is checked again.
+   * @return True if the trajectory has changed.
+   */
+  bool refine() const;
+
+  /**
+   * The (estimated) bytes of the data that can be recomputed from the
+   * sequence, i.e., the trajectory, the spanning information, and the cached
+   * distances.
+   */
+  [[nodiscard]] size_t get_computed_data_size() const;
+
+  /**
+   * Frees the data that can be recomputed from the sequence. It is
+   * recomputed lazily, which requires to solve the SOCP again. The
+   * feasibility, the objective, and the spanning circles are kept, unless
+   * the trajectory is loose.
+   * @return The (estimated) bytes freed.
+   */
+  size_t release_computed_data() const;
+
+  /**
+   * The hitting points and spanning information of the trajectory, such that
+   * the trajectories of children can be computed incrementally.
+   */
+  std::shared_ptr<const details::ParentTrajectory> get_parent_trajectory() const;
+
+  /**
+   * Computes the trajectory incrementally from the given parent trajectory.
+   * The sequence has to differ from the parent's sequence only by the circle
+   * at position `inserted_at`.
+   */
+  void set_parent_trajectory(
+      std::shared_ptr<const details::ParentTrajectory> parent,
+      int inserted_at) {
+    spanning_trajectory.set_parent_trajectory(std::move(parent), inserted_at);
+  }
+
+  /**
+   * The circles covered by the trajectory and their distances, such that the
+   * coverage of the children can be derived incrementally. Only the
+   * trajectory is copied, the coverage is computed by the first child that
+   * needs it.
+   */
+  std::shared_ptr<const details::ParentCoverage> get_parent_coverage() const;
+
+  /**
+   * Derives the coverage from the coverage of the parent instead of
+   * checking all circles again, see details::mark_covered_incrementally.
+   */
+  void set_parent_coverage(
+      std::shared_ptr<const details::ParentCoverage> parent) {
+    distances.set_parent_coverage(std::move(parent));
+  }
 
   double distance(int i) const { return distances(i, &get_trajectory()); }
 
   bool covers(int i) const;
 
+  /**
+   * The circle that is not covered and has the largest distance to the
+   * trajectory, or nothing if the solution is feasible.
+   */
+  std::optional<int> get_farthest_uncovered_circle() const;
+
   bool is_feasible() const;
 
   /**
@@ -145,6 +300,26 @@ TEST_CASE("PartialSequentialSolution") {
   CHECK(pss.obj() == doctest::Approx(11.9434));
   CHECK(pss.is_feasible());
 }
+
+TEST_CASE("PartialSequentialSolution Cutoff") {
+  Instance instance(
+      {{{0, 0}, 0.01}, {{3, 0}, 0.01}, {{3, 3}, 0.01}, {{0, 3}, 0.01}});
+  auto solver = get_trajectory_solver();
+  set_trajectory_solver(std::make_shared<NativeTrajectorySolver>());
+  PartialSequenceSolution pss(&instance, {0, 1, 2, 3});
+  PartialSequenceSolution::trigger_lazy_computation({&pss}, true, 5.0);
+  CHECK(pss.is_above_cutoff());
+  CHECK(!pss.is_computed());
+  CHECK(pss.get_cutoff_bound() > 5.0);
+  CHECK(pss.get_cutoff_bound() <= 11.9434 + 1e-3);
+  // computed completely on access
+  CHECK(pss.obj() == doctest::Approx(11.9434));
+  CHECK(!pss.is_above_cutoff());
+  PartialSequenceSolution pss2(&instance, {0, 1, 2, 3});
+  PartialSequenceSolution::trigger_lazy_computation({&pss2}, true, 20.0);
+  CHECK(pss2.is_computed());
+  set_trajectory_solver(solver);
+}
 } // namespace cetsp
 
 #endif // CETSP_RELAXED_SOLUTION_H
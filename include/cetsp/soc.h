@@ -12,9 +12,194 @@
 #define CETSP_SOC_H
 #include "cetsp/common.h"
 #include "doctest/doctest.h"
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
 #include <vector>
 namespace cetsp {
 
+/**
+ * The result of a solve with a cutoff. If the optimal trajectory is proved to
+ * be longer than the cutoff, the solver may stop early. Then, there is no
+ * trajectory, but only the certified lower bound that has been reached.
+ * For a loose solve, the trajectory is feasible but not necessarily optimal,
+ * and the lower bound may be below its length.
+ */
+struct CutoffSolution {
+  std::optional<std::pair<Trajectory, std::vector<bool>>> solution;
+  double lower_bound; // the length of the solution, if it is exact
+  bool incremental = false; // only a window of the parent was re-optimized
+};
+
+/**
+ * A backend for computing the optimal trajectory through a fixed sequence of
+ * circles. The solvers are shared by all threads, so `solve` has to be
+ * thread-safe.
+ */
+class TrajectorySolver {
+public:
+  /**
+   * See `compute_trajectory_with_information`.
+   */
+  virtual std::pair<Trajectory, std::vector<bool>>
+  solve(const std::vector<Circle> &circle_sequence, bool path) = 0;
+
+  /**
+   * Solves multiple sequences at once, e.g., all children of a node. The
+   * backends can share their setup between the sequences.
+   */
+  virtual std::vector<std::pair<Trajectory, std::vector<bool>>>
+  solve_batch(const std::vector<std::vector<Circle>> &circle_sequences,
+              bool path) {
+    std::vector<std::pair<Trajectory, std::vector<bool>>> results;
+    results.reserve(circle_sequences.size());
+    for (const auto &circle_sequence : circle_sequences) {
+      results.push_back(solve(circle_sequence, path));
+    }
+    return results;
+  }
+
+  /**
+   * Like `solve_batch`, but the solver may stop early for the sequences whose
+   * optimal trajectory is proved to be longer than `cutoff`. The default
+   * solves all sequences completely.
+   */
+  virtual std::vector<CutoffSolution>
+  solve_batch_with_cutoff(const std::vector<std::vector<Circle>> &circle_sequences,
+                          bool path, double cutoff) {
+    std::vector<CutoffSolution> results;
+    results.reserve(circle_sequences.size());
+    for (auto &solution : solve_batch(circle_sequences, path)) {
+      const double length = solution.first.length();
+      results.push_back({std::move(solution), length});
+    }
+    return results;
+  }
+
+  /**
+   * Like `solve_batch_with_cutoff`, but the solver may stop at a loose
+   * precision. The trajectories are feasible, and the certified lower bound
+   * of `compute_trajectory_lower_bound` tells how far from optimal they can
+   * be. This suffices for most pruning decisions. The default solves
+   * exactly.
+   */
+  virtual std::vector<CutoffSolution>
+  solve_batch_loosely(const std::vector<std::vector<Circle>> &circle_sequences,
+                      bool path, double cutoff) {
+    return solve_batch_with_cutoff(circle_sequences, path, cutoff);
+  }
+
+  virtual ~TrajectorySolver() = default;
+};
+
+#ifndef CETSP_WITHOUT_GUROBI
+/**
+ * Solves the SOCP with Gurobi. The models are pooled and reused for sequences
+ * of the same length.
+ */
+class GurobiTrajectorySolver : public TrajectorySolver {
+public:
+  /**
+   * STANDARD has explicit variables for the hitting points and their offsets
+   * to the centers. LEAN only keeps the offsets and builds the model with
+   * bulk calls, which gives fewer variables and constraints for the same
+   * trajectory.
+   */
+  enum class Formulation { STANDARD, LEAN };
+
+  explicit GurobiTrajectorySolver(
+      const Formulation formulation = Formulation::STANDARD)
+      : formulation{formulation} {}
+
+  std::pair<Trajectory, std::vector<bool>>
+  solve(const std::vector<Circle> &circle_sequence, bool path) override;
+
+  /**
+   * Takes the models for the batch only once from the pool.
+   */
+  std::vector<std::pair<Trajectory, std::vector<bool>>>
+  solve_batch(const std::vector<std::vector<Circle>> &circle_sequences,
+              bool path) override;
+
+  /**
+   * Uses the objective cutoff of Gurobi.
+   */
+  std::vector<CutoffSolution>
+  solve_batch_with_cutoff(const std::vector<std::vector<Circle>> &circle_sequences,
+                          bool path, double cutoff) override;
+
+  /**
+   * Relaxes the convergence tolerance of the barrier.
+   */
+  std::vector<CutoffSolution>
+  solve_batch_loosely(const std::vector<std::vector<Circle>> &circle_sequences,
+                      bool path, double cutoff) override;
+
+private:
+  Formulation formulation;
+};
+#endif
+
+/**
+ * A specialized interior point method for the SOCP that exploits that every
+ * hitting point only interacts with its neighbors in the sequence. Every
+ * iteration only takes linear time and no external solver is needed.
+ */
+class NativeTrajectorySolver : public TrajectorySolver {
+public:
+  /**
+   * @param tolerance The absolute duality gap at which the solver stops,
+   * relative to the extent of the circles.
+   * @param loose_tolerance The same for `solve_batch_loosely`.
+   */
+  explicit NativeTrajectorySolver(double tolerance = 1e-9,
+                                  double loose_tolerance = 1e-4)
+      : tolerance{tolerance}, loose_tolerance{loose_tolerance} {}
+  std::pair<Trajectory, std::vector<bool>>
+  solve(const std::vector<Circle> &circle_sequence, bool path) override;
+
+  /**
+   * Reuses the workspace for all sequences of the batch.
+   */
+  std::vector<std::pair<Trajectory, std::vector<bool>>>
+  solve_batch(const std::vector<std::vector<Circle>> &circle_sequences,
+              bool path) override;
+
+  /**
+   * Checks the dual bound of `compute_trajectory_lower_bound` for the
+   * current hitting points after every centering step and stops as soon as
+   * it exceeds the cutoff.
+   */
+  std::vector<CutoffSolution>
+  solve_batch_with_cutoff(const std::vector<std::vector<Circle>> &circle_sequences,
+                          bool path, double cutoff) override;
+
+  /**
+   * Stops at `loose_tolerance`, which saves the last centering steps.
+   */
+  std::vector<CutoffSolution>
+  solve_batch_loosely(const std::vector<std::vector<Circle>> &circle_sequences,
+                      bool path, double cutoff) override;
+
+private:
+  std::vector<CutoffSolution>
+  solve_batch_with_tolerance(
+      const std::vector<std::vector<Circle>> &circle_sequences, bool path,
+      double cutoff, double tolerance_, bool loose);
+
+  double tolerance;
+  double loose_tolerance;
+};
+
+/**
+ * Replaces the solver used by `compute_trajectory_with_information`. Should
+ * be called before the optimization starts. The default is Gurobi if the
+ * library is built with it, the native solver otherwise.
+ */
+void set_trajectory_solver(std::shared_ptr<TrajectorySolver> solver);
+std::shared_ptr<TrajectorySolver> get_trajectory_solver();
+
 /**
  * Computes the shortest tour through the sequence of circles. Will also give
  * you information which circles are tour defining, i.e., their hitting point
@@ -33,6 +218,14 @@ std::pair<Trajectory, std::vector<bool>>
 compute_trajectory_with_information(const std::vector<Circle> &circle_sequence,
                                     bool path);
 
+/**
+ * Like `compute_trajectory_with_information` for multiple sequences at once,
+ * e.g., the children of a node. Allows the solver to share its setup.
+ */
+std::vector<std::pair<Trajectory, std::vector<bool>>>
+compute_trajectories_with_information(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path);
+
 /**
  * Like `compute_trajectory_with_information`  but throwing away the
  * additional information, only returning the trajectory.
@@ -40,6 +233,113 @@ compute_trajectory_with_information(const std::vector<Circle> &circle_sequence,
 Trajectory compute_tour(const std::vector<Circle> &circle_sequence,
                         bool path = false);
 
+/**
+ * Computes a certified lower bound for the length of the optimal trajectory
+ * through the circle sequence, using the dual of the SOCP. The directions of
+ * the given trajectory are used as dual solution, such that the bound is
+ * tight if the trajectory is optimal.
+ * @param circle_sequence A sequence of circles.
+ * @param hitting_points One point per circle, e.g., of an (almost) optimal
+ * trajectory.
+ * @param path Defines if we want a tour or a path.
+ * @return A lower bound for the optimal trajectory through the sequence.
+ */
+double compute_trajectory_lower_bound(const std::vector<Circle> &circle_sequence,
+                                      const std::vector<Point> &hitting_points,
+                                      bool path);
+
+namespace details {
+/**
+ * The hitting points and spanning information of a trajectory, with one entry
+ * per circle (including the fixed endpoints of a path). Shared between the
+ * children of a node for the incremental computation.
+ */
+struct ParentTrajectory {
+  std::vector<Point> hitting_points;
+  std::vector<bool> spanning;
+};
+
+/**
+ * Closed forms for sequences of at most two circles or without radii, and a
+ * barrier method of fixed size for three circles. The trajectory
+ * computations dispatch to it automatically, bypassing the solver set by
+ * `set_trajectory_solver`.
+ * @return Nothing if the sequence is neither small nor degenerate.
+ */
+std::optional<std::pair<Trajectory, std::vector<bool>>>
+compute_small_trajectory(const std::vector<Circle> &circle_sequence,
+                         bool path);
+} // namespace details
+
+/**
+ * Like `compute_trajectory_with_information`, but for a sequence that differs
+ * from the parent's sequence only by the circle at `inserted_at`. Only the
+ * hitting points in a window around the insertion are re-optimized, the
+ * remaining ones are taken from the parent. The result is only accepted if
+ * the lower bound of `compute_trajectory_lower_bound` proves it to be optimal
+ * within a small tolerance. Otherwise, the window is enlarged, until we fall
+ * back to the full computation.
+ */
+std::pair<Trajectory, std::vector<bool>>
+compute_trajectory_incrementally(const std::vector<Circle> &circle_sequence,
+                                 bool path,
+                                 const details::ParentTrajectory &parent,
+                                 int inserted_at);
+
+/**
+ * The batched version of `compute_trajectory_incrementally`. The windows of
+ * all sequences are solved together and so are the sequences that have to
+ * be computed completely. A parent can be nullptr for a complete computation.
+ */
+std::vector<std::pair<Trajectory, std::vector<bool>>>
+compute_trajectories_incrementally(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path,
+    const std::vector<const details::ParentTrajectory *> &parents,
+    const std::vector<int> &inserted_at);
+
+/**
+ * Like `compute_trajectories_incrementally`, but the computation may stop
+ * early for the sequences whose optimal trajectory is proved to be longer
+ * than `cutoff`, e.g., the upper bound of the BnB.
+ * @param loose Only compute feasible trajectories with a certified lower
+ * bound, see `TrajectorySolver::solve_batch_loosely`.
+ */
+std::vector<CutoffSolution> compute_trajectories_incrementally(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path,
+    const std::vector<const details::ParentTrajectory *> &parents,
+    const std::vector<int> &inserted_at, double cutoff, bool loose = false);
+
+#ifndef CETSP_WITHOUT_GUROBI
+namespace details {
+/**
+ * Like `compute_trajectory_with_information` but builds a new model instead
+ * of reusing a pooled one. Only needed as reference, e.g., for benchmarking.
+ */
+std::pair<Trajectory, std::vector<bool>> compute_trajectory_with_new_model(
+    const std::vector<Circle> &circle_sequence, bool path,
+    GurobiTrajectorySolver::Formulation formulation =
+        GurobiTrajectorySolver::Formulation::STANDARD);
+
+/**
+ * Size and timings of building and solving a new model, for comparing the
+ * formulations.
+ */
+struct TrajectoryModelMeasurement {
+  int num_vars;
+  int num_constrs;
+  int num_qconstrs;
+  double build_time_us;
+  double solve_time_us;
+  std::pair<Trajectory, std::vector<bool>> solution;
+};
+
+TrajectoryModelMeasurement
+measure_trajectory_model(const std::vector<Circle> &circle_sequence,
+                         bool path,
+                         GurobiTrajectorySolver::Formulation formulation);
+} // namespace details
+#endif
+
 TEST_CASE("Simple SOCP test") {
   // define  the circle sequence  we want to have the trajectory for
   std::vector<Circle> seq = {{{0, 0}, 1}, {{3, 0}, 1}};
@@ -50,5 +350,307 @@ TEST_CASE("Simple SOCP test") {
   traj = compute_tour(seq, true);
   CHECK(traj.length() == doctest::Approx(1));
 }
+
+#ifndef CETSP_WITHOUT_GUROBI
+TEST_CASE("Pooled SOCP") {
+  // The pooled models are reused for sequences of the same length, so the
+  // circle data of a previous solve must not leak into the next one. The
+  // sequences are too long for `details::compute_small_trajectory`.
+  std::vector<Circle> seq1 = {
+      {{0, 0}, 1}, {{3, 0}, 1}, {{3, 3}, 0.5}, {{10, 4}, 2}, {{5, 8}, 1}};
+  std::vector<Circle> seq2 = {
+      {{0, 0}, 0.5}, {{5, 0}, 0.5}, {{6, 5}, 1}, {{0, 5}, 0.3}, {{-3, 2}, 1}};
+  GurobiTrajectorySolver solver;
+  for (int i = 0; i < 2; ++i) {
+    for (const auto &seq : {seq1, seq2}) {
+      for (bool path : {false, true}) {
+        auto pooled = solver.solve(seq, path);
+        auto fresh = details::compute_trajectory_with_new_model(seq, path);
+        CHECK(pooled.first.length() ==
+              doctest::Approx(fresh.first.length()));
+        CHECK(pooled.second == fresh.second);
+      }
+    }
+  }
+}
+
+TEST_CASE("Lean SOCP Formulation") {
+  using Formulation = GurobiTrajectorySolver::Formulation;
+  std::vector<Circle> seq = {{{0, 0}, 1},   {{3, 0}, 1}, {{3, 3}, 0.5},
+                             {{10, 4}, 2},  {{5, 8}, 1}, {{-2, 4}, 0},
+                             {{1, 2}, 0.3}, {{-4, 1}, 1}};
+  const int n = static_cast<int>(seq.size());
+  for (bool path : {false, true}) {
+    auto standard =
+        details::measure_trajectory_model(seq, path, Formulation::STANDARD);
+    auto lean = details::measure_trajectory_model(seq, path, Formulation::LEAN);
+    CHECK(lean.solution.first.length() ==
+          doctest::Approx(standard.solution.first.length()));
+    CHECK(lean.solution.second == standard.solution.second);
+    CHECK(lean.solution.first.covers(seq.begin(), seq.end(), 0.001));
+    // The hitting point of a circle that does not span the trajectory can
+    // slide along its segment, and the barrier of Gurobi ends at a different
+    // one for each formulation. The spanning ones only differ by its
+    // tolerance, which is about 1e-3 for the small circles here.
+    for (int i = 0; i < n; ++i) {
+      if (standard.solution.second[i]) {
+        CHECK(lean.solution.first.points[i].dist(
+                  standard.solution.first.points[i]) <= 1e-2);
+      }
+    }
+    const int segments = path ? n - 1 : n;
+    CHECK(standard.num_vars == 7 * n);
+    CHECK(lean.num_vars == 2 * n + 3 * segments);
+    CHECK(lean.num_constrs + lean.num_qconstrs == n + 3 * segments);
+    // The pooled models of both formulations must not be mixed up.
+    GurobiTrajectorySolver solver(Formulation::LEAN);
+    auto pooled = solver.solve(seq, path);
+    CHECK(pooled.first.length() ==
+          doctest::Approx(standard.solution.first.length()));
+  }
+}
+#endif
+
+TEST_CASE("SOCP Lower Bound") {
+  std::vector<Circle> seq = {{{0, 0}, 1}, {{3, 0}, 1}, {{3, 3}, 0.5},
+                             {{10, 4}, 2}, {{5, 8}, 1}, {{-2, 4}, 0}};
+  for (bool path : {false, true}) {
+    auto traj = compute_tour(seq, path);
+    std::vector<Point> points(traj.points.begin(),
+                              traj.points.begin() + seq.size());
+    const auto lb = compute_trajectory_lower_bound(seq, points, path);
+    CHECK(lb <= traj.length() + 1e-6);
+    CHECK(lb == doctest::Approx(traj.length()));
+    // Any trajectory gives a valid bound.
+    std::vector<Point> centers;
+    for (const auto &c : seq) {
+      centers.push_back(c.center);
+    }
+    CHECK(compute_trajectory_lower_bound(seq, centers, path) <=
+          traj.length() + 1e-6);
+  }
+}
+
+TEST_CASE("Incremental SOCP") {
+  std::vector<Circle> seq;
+  for (int i = 0; i < 40; ++i) {
+    const double angle = 2 * M_PI * i / 40;
+    seq.push_back({{50 * std::cos(angle) + (i % 3), 50 * std::sin(angle)},
+                   0.5 + (i % 4) * 0.3});
+  }
+  for (bool path : {false, true}) {
+    for (int inserted_at : {1, 20, 38}) {
+      auto parent_seq = seq;
+      parent_seq.erase(parent_seq.begin() + inserted_at);
+      auto parent_solution = compute_trajectory_with_information(parent_seq, path);
+      details::ParentTrajectory parent{
+          {parent_solution.first.points.begin(),
+           parent_solution.first.points.begin() + parent_seq.size()},
+          parent_solution.second};
+      auto incremental =
+          compute_trajectory_incrementally(seq, path, parent, inserted_at);
+      auto full = compute_trajectory_with_information(seq, path);
+      CHECK(incremental.first.length() ==
+            doctest::Approx(full.first.length()));
+      CHECK(incremental.first.is_tour() == !path);
+      CHECK(incremental.second.size() == seq.size());
+    }
+  }
+}
+
+TEST_CASE("Incremental SOCP without Certificate") {
+  // A short path, for which every window spans all circles. The parent's
+  // start is off, such that no window can be certified and the complete
+  // computation has to take over.
+  std::vector<Circle> seq = {
+      {{0, 0}, 0}, {{5, 3}, 1}, {{10, -3}, 1}, {{15, 0}, 0}};
+  details::ParentTrajectory parent{{{-20, 0}, {5, 2}, {15, 0}},
+                                   {false, true, false}};
+  const double length = compute_tour(seq, true).length();
+  for (bool loose : {false, true}) {
+    auto incremental = compute_trajectories_incrementally(
+        {seq}, true, {&parent}, {2}, std::numeric_limits<double>::infinity(),
+        loose);
+    REQUIRE(incremental[0].solution);
+    CHECK(incremental[0].solution->first.length() ==
+          doctest::Approx(length).epsilon(1e-3));
+    CHECK(incremental[0].lower_bound <= length + 1e-6);
+  }
+}
+
+TEST_CASE("Batched SOCP") {
+  // All but the last sequence are too long for the closed forms, so they
+  // reach `solve_batch` of the solvers.
+  std::vector<std::vector<Circle>> sequences = {
+      {{{0, 0}, 1}, {{3, 0}, 1}, {{3, 3}, 0.5}, {{10, 4}, 2}, {{5, 8}, 1}},
+      {{{0, 0}, 1},
+       {{3, 0}, 1},
+       {{3, 3}, 0.5},
+       {{10, 4}, 2},
+       {{5, 8}, 1},
+       {{-2, 4}, 0}},
+      {{{0, 0}, 0.5}, {{5, 0}, 0.5}, {{6, 5}, 1}, {{0, 5}, 0.3}, {{-3, 2}, 1}},
+      {{{0, 0}, 1}, {{3, 0}, 1}}};
+  std::vector<std::shared_ptr<TrajectorySolver>> solvers = {
+      std::make_shared<NativeTrajectorySolver>()};
+#ifndef CETSP_WITHOUT_GUROBI
+  solvers.push_back(std::make_shared<GurobiTrajectorySolver>());
+#endif
+  for (bool path : {false, true}) {
+    for (auto &solver : solvers) {
+      auto batch = solver->solve_batch(sequences, path);
+      REQUIRE(batch.size() == sequences.size());
+      for (size_t i = 0; i < sequences.size(); ++i) {
+        auto single = solver->solve(sequences[i], path);
+        CHECK(batch[i].first.length() ==
+              doctest::Approx(single.first.length()));
+        CHECK(batch[i].second == single.second);
+      }
+    }
+    // mixed with the closed forms
+    auto batch = compute_trajectories_with_information(sequences, path);
+    REQUIRE(batch.size() == sequences.size());
+    for (size_t i = 0; i < sequences.size(); ++i) {
+      auto single = compute_trajectory_with_information(sequences[i], path);
+      CHECK(batch[i].first.length() == doctest::Approx(single.first.length()));
+      CHECK(batch[i].second == single.second);
+    }
+  }
+}
+
+TEST_CASE("SOCP Cutoff") {
+  std::vector<Circle> seq = {{{0, 0}, 1}, {{3, 0}, 1}, {{3, 3}, 0.5},
+                             {{10, 4}, 2}, {{5, 8}, 1}, {{-2, 4}, 0}};
+  for (bool path : {false, true}) {
+    const double length = compute_tour(seq, path).length();
+    NativeTrajectorySolver solver;
+    auto above = solver.solve_batch_with_cutoff({seq}, path, 0.5 * length);
+    CHECK(!above[0].solution);
+    CHECK(above[0].lower_bound > 0.5 * length);
+    CHECK(above[0].lower_bound <= length + 1e-6);
+    auto below = solver.solve_batch_with_cutoff({seq}, path, 2 * length);
+    REQUIRE(below[0].solution);
+    CHECK(below[0].solution->first.length() == doctest::Approx(length));
+    CHECK(below[0].lower_bound == doctest::Approx(length));
+    // also for the incremental computation
+    auto parent_seq = seq;
+    parent_seq.erase(parent_seq.begin() + 2);
+    auto parent_solution = compute_trajectory_with_information(parent_seq, path);
+    details::ParentTrajectory parent{
+        {parent_solution.first.points.begin(),
+         parent_solution.first.points.begin() + parent_seq.size()},
+        parent_solution.second};
+    auto incremental = compute_trajectories_incrementally(
+        {seq}, path, {&parent}, {2}, 0.5 * length);
+    CHECK(incremental[0].lower_bound <= length + 1e-6);
+    CHECK((!incremental[0].solution ||
+           incremental[0].solution->first.length() ==
+               doctest::Approx(length)));
+  }
+}
+
+TEST_CASE("Loose SOCP") {
+  std::vector<Circle> seq = {{{0, 0}, 1},   {{3, 0}, 1}, {{3, 3}, 0.5},
+                             {{10, 4}, 2},  {{5, 8}, 1}, {{-2, 4}, 0},
+                             {{1, 2}, 0.3}, {{-4, 1}, 1}};
+  for (bool path : {false, true}) {
+    const double length = compute_tour(seq, path).length();
+    NativeTrajectorySolver solver(1e-9, 1e-2);
+    auto loose = solver.solve_batch_loosely(
+        {seq}, path, std::numeric_limits<double>::infinity());
+    REQUIRE(loose[0].solution);
+    // feasible, so not shorter than the optimum, and certified from below
+    CHECK(loose[0].solution->first.length() >= length - 1e-6);
+    CHECK(loose[0].lower_bound <= length + 1e-6);
+    CHECK(loose[0].lower_bound ==
+          doctest::Approx(loose[0].solution->first.length()).epsilon(0.01));
+    // the loose solutions certify the windows of the incremental computation
+    auto parent_seq = seq;
+    parent_seq.erase(parent_seq.begin() + 2);
+    auto parent_solution = compute_trajectory_with_information(parent_seq, path);
+    details::ParentTrajectory parent{
+        {parent_solution.first.points.begin(),
+         parent_solution.first.points.begin() + parent_seq.size()},
+        parent_solution.second};
+    auto incremental = compute_trajectories_incrementally(
+        {seq}, path, {&parent}, {2}, std::numeric_limits<double>::infinity(),
+        true);
+    REQUIRE(incremental[0].solution);
+    CHECK(incremental[0].lower_bound <= length + 1e-6);
+    CHECK(incremental[0].solution->first.length() >= length - 1e-6);
+  }
+}
+
+TEST_CASE("Small SOCP") {
+  NativeTrajectorySolver native;
+  // no radii
+  std::vector<Circle> seq = {{{0, 0}, 0}, {{3, 0}, 0}, {{3, 4}, 0}, {{0, 4}, 0}};
+  auto polygon = details::compute_small_trajectory(seq, false);
+  REQUIRE(polygon);
+  CHECK(polygon->first.length() == doctest::Approx(14));
+  CHECK(details::compute_small_trajectory(seq, true)->first.length() ==
+        doctest::Approx(10));
+  // two circles, disjoint and intersecting
+  seq = {{{0, 0}, 1}, {{3, 0}, 1}};
+  CHECK(details::compute_small_trajectory(seq, false)->first.length() ==
+        doctest::Approx(2));
+  CHECK(details::compute_small_trajectory(seq, true)->second ==
+        std::vector<bool>{true, true});
+  seq = {{{0, 0}, 2}, {{3, 0}, 2}};
+  CHECK(details::compute_small_trajectory(seq, false)->first.length() == 0.0);
+  seq.push_back({{10, 4}, 2});
+  seq.push_back({{5, 8}, 1});
+  CHECK(!details::compute_small_trajectory(seq, false));
+  // random sequences against the native solver
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coord(0, 10), radius(0, 3);
+  for (int i = 0; i < 200; ++i) {
+    const size_t n = 1 + i % 3;
+    seq.clear();
+    for (size_t j = 0; j < n; ++j) {
+      seq.push_back({{coord(rng), coord(rng)}, i % 7 == 0 ? 0.0 : radius(rng)});
+    }
+    for (bool path : {false, true}) {
+      auto small = details::compute_small_trajectory(seq, path);
+      REQUIRE(small);
+      auto reference = native.solve(seq, path);
+      CHECK(small->first.length() ==
+            doctest::Approx(reference.first.length()).epsilon(1e-6));
+      CHECK(small->first.points.size() == reference.first.points.size());
+      for (size_t j = 0; j < n; ++j) {
+        CHECK(seq[j].center.dist(small->first.points[j]) <=
+              seq[j].radius + 1e-6);
+      }
+    }
+  }
+}
+
+TEST_CASE("Native SOCP") {
+  NativeTrajectorySolver solver;
+  std::vector<Circle> seq = {{{0, 0}, 1}, {{3, 0}, 1}};
+  CHECK(solver.solve(seq, false).first.length() == doctest::Approx(2));
+  CHECK(solver.solve(seq, true).first.length() == doctest::Approx(1));
+  // Zero radii are fixed points and overlapping circles need no movement.
+  seq = {{{0, 0}, 0}, {{5, 3}, 1}, {{10, 0}, 0}};
+  auto native = solver.solve(seq, true);
+  CHECK(native.first.length() == doctest::Approx(2 * std::sqrt(29)));
+  CHECK(native.second[1]);
+  CHECK(native.first.points.front() == seq.front().center);
+  CHECK(native.first.points.back() == seq.back().center);
+  seq = {{{0, 0}, 1}, {{0.5, 0}, 1}, {{0, 0.5}, 1}};
+  CHECK(solver.solve(seq, false).first.length() ==
+        doctest::Approx(0).epsilon(1e-6));
+#ifndef CETSP_WITHOUT_GUROBI
+  std::vector<Circle> seq2 = {{{0, 0}, 1},   {{3, 0}, 1}, {{3, 3}, 0.5},
+                              {{10, 4}, 2},  {{5, 8}, 1}, {{-2, 4}, 0},
+                              {{1, 2}, 0.3}, {{-4, 1}, 1}};
+  for (bool path : {false, true}) {
+    auto reference = details::compute_trajectory_with_new_model(seq2, path);
+    auto result = solver.solve(seq2, path);
+    CHECK(result.first.length() == doctest::Approx(reference.first.length()));
+    CHECK(result.second == reference.second);
+  }
+#endif
+}
 } // namespace cetsp
 #endif
@@ -19,15 +19,21 @@
 #define CETSP_BRANCHING_STRATEGY_H
 #include "cetsp/common.h"
 #include "cetsp/details/convex_hull_order.h"
+#include "cetsp/details/insertion_bound.h"
 #include "cetsp/details/solution_pool.h"
+#include "cetsp/details/transposition_table.h"
 #include "cetsp/details/triple_map.h"
 #include "cetsp/node.h"
+#include "cetsp/utils/thread_pool.h"
 #include "rule.h"
 #include <CGAL/Convex_hull_traits_adapter_2.h>
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/convex_hull_2.h>
 #include <CGAL/property_map.h>
+#include <atomic>
 #include <random>
+#include <string>
+#include <unordered_map>
 #include <vector>
 namespace cetsp {
 
@@ -52,6 +58,26 @@ public:
    * @return True iff the node has children.
    */
   virtual bool branch(Node &node) = 0;
+
+  /**
+   * Evaluates a node whose evaluation has been deferred by `branch`. Called
+   * when the node is selected by the search, before it is explored.
+   * @param node The selected node.
+   */
+  virtual void evaluate_deferred(Node &node) { node.evaluate_deferred(); }
+
+  /**
+   * Allows the strategy to report statistics, e.g., for the benchmarks.
+   * @param stats The statistics of the branch and bound algorithm.
+   */
+  virtual void
+  add_statistics(std::unordered_map<std::string, std::string> &stats) const {}
+
+  /**
+   * The thread pool of the strategy, if it has one. It can be shared with
+   * the callbacks.
+   */
+  virtual utils::ThreadPool *get_thread_pool() { return nullptr; }
   virtual ~BranchingStrategy() = default;
 };
 
@@ -70,6 +96,10 @@ class CircleBranching : public BranchingStrategy {
 public:
   explicit CircleBranching(bool simplify = false, size_t num_threads = 1)
       : simplify{simplify}, num_threads{num_threads} {
+    if (num_threads > 1) {
+      // the branching thread evaluates children, too
+      thread_pool = std::make_unique<utils::ThreadPool>(num_threads - 1);
+    }
     if (simplify) {
       std::cout << "Using node simplification." << std::endl;
     }
@@ -77,8 +107,10 @@ public:
   }
 
   void setup(Instance *instance_, std::shared_ptr<Node> &root,
-             SolutionPool *solution_pool) override {
+             SolutionPool *solution_pool_) override {
     instance = instance_;
+    solution_pool = solution_pool_;
+    transposition_table.clear();
     for (auto &rule : rules) {
       rule->setup(instance, root, solution_pool);
     }
@@ -90,6 +122,96 @@ public:
 
   bool branch(Node &node) override;
 
+  /**
+   * Compute the trajectories of the children only in a window around the
+   * inserted circle, if this can be proved to be optimal. Enabled by default.
+   */
+  void set_incremental_evaluation(bool enable) {
+    incremental_evaluation = enable;
+  }
+
+  /**
+   * Derive the coverage of the children from the coverage of the node, such
+   * that only the circles close to the changed parts of their trajectories
+   * have to be checked. Enabled by default.
+   */
+  void set_incremental_coverage(bool enable) { incremental_coverage = enable; }
+
+  /**
+   * Drop children whose sequence has already been created somewhere else in
+   * the tree, as they would have the same subtree. Enabled by default.
+   * @param enable Enable the transposition table.
+   * @param memory_budget Bytes the transposition table may use.
+   */
+  void set_deduplication(
+      bool enable,
+      size_t memory_budget = details::TranspositionTable::DEFAULT_MEMORY_BUDGET) {
+    deduplication = enable;
+    transposition_table.set_memory_budget(memory_budget);
+  }
+
+  /**
+   * Drop children whose length is already bounded by the upper bound, using
+   * the parent's objective and a geometric bound on the detour to the
+   * inserted circle, see details::lower_bound_on_detour. This needs no SOCP.
+   * Enabled by default.
+   */
+  void set_prescreening(bool enable) { prescreening = enable; }
+
+  /**
+   * Do not solve the SOCPs of the children when branching, but only when
+   * the search selects them. Until then, a child has the lower bound of its
+   * parent and is ordered by the parent's objective plus the detour to the
+   * inserted circle. Children that are pruned before they are selected never
+   * need a solve. The rules and the deduplication are also only checked
+   * then, as they need the full sequence. Disabled by default.
+   */
+  void set_deferred_evaluation(bool enable) { deferred_evaluation = enable; }
+
+  /**
+   * Pass the upper bound to the trajectory solver, which stops as soon as it
+   * proves a child to be longer. Such a child only gets the bound reached
+   * instead of its trajectory, which suffices to prune it. Enabled by
+   * default.
+   */
+  void set_cutoff(bool enable) { cutoff = enable; }
+
+  /**
+   * Solve the SOCPs of the children only to a loose precision. The lower
+   * bound of a child is then the certified dual bound of its trajectory,
+   * which suffices to prune or branch most nodes. The BnB refines a node
+   * exactly only if it is close to the upper bound or feasible. Disabled by
+   * default.
+   */
+  void set_loose_evaluation(bool enable) { loose_evaluation = enable; }
+
+  void evaluate_deferred(Node &node) override;
+
+  utils::ThreadPool *get_thread_pool() override { return thread_pool.get(); }
+
+  void add_statistics(
+      std::unordered_map<std::string, std::string> &stats) const override {
+    stats["prescreen_checks"] = std::to_string(num_prescreen_checks);
+    stats["prescreen_drops"] = std::to_string(num_prescreen_drops);
+    stats["prescreen_drop_rate"] = std::to_string(
+        num_prescreen_checks > 0
+            ? static_cast<double>(num_prescreen_drops) / num_prescreen_checks
+            : 0.0);
+    stats["deferred_children"] = std::to_string(num_deferred_children);
+    stats["deferred_evaluations"] = std::to_string(num_deferred_evaluations);
+    stats["saved_socp_calls"] =
+        std::to_string(num_deferred_children - num_deferred_evaluations);
+    stats["socp_cutoffs"] = std::to_string(num_socp_cutoffs);
+    stats["incremental_socps"] = std::to_string(num_incremental_socps);
+    stats["transposition_lookups"] =
+        std::to_string(transposition_table.num_lookups());
+    stats["transposition_hits"] =
+        std::to_string(transposition_table.num_hits());
+    stats["transposition_hit_rate"] =
+        std::to_string(transposition_table.hit_rate());
+    stats["transposition_entries"] = std::to_string(transposition_table.size());
+  }
+
 protected:
   /**
    * Override this method to filter the branching in advance.
@@ -104,6 +226,15 @@ protected:
                        });
   }
 
+  /**
+   * Checks the sequence of a child with `is_sequence_ok` and drops it if the
+   * same sequence has already been created, see `set_deduplication`. This
+   * materializes the sequence, so it is only done right before the child is
+   * evaluated.
+   * @return True if the child should be kept.
+   */
+  bool is_child_ok(Node &child, const Node &parent);
+
   /**
    * Return the cirlce to branch on. This allows to easily create different
    * strategies.
@@ -112,9 +243,48 @@ protected:
    */
   virtual std::optional<int> get_branching_circle(Node &node) = 0;
 
+  /**
+   * Lower bound on the detour of inserting the circle into the parent's
+   * sequence at the given position. The parent's objective plus this bound
+   * is a lower bound for the child.
+   */
+  double lower_bound_on_insertion(const std::vector<int> &parent_sequence,
+                                  int circle, int inserted_at) const;
+
+  /**
+   * The cutoff for the trajectory solver, i.e., the upper bound if enabled.
+   */
+  double get_cutoff() const;
+
+  // Counts the children whose evaluation has stopped at the cutoff or has
+  // been incremental.
+  void count_evaluations(const std::vector<std::shared_ptr<Node>> &children);
+
+  void count_evaluation(Node &child);
+
+  // Every this many levels, the sequence of a node becomes the explicit base
+  // of the records of its children.
+  static constexpr int MAX_SEQUENCE_DELTAS = 16;
+
   Instance *instance = nullptr;
+  SolutionPool *solution_pool = nullptr; // for the upper bound
   bool simplify;
   size_t num_threads;
+  bool incremental_evaluation = true;
+  bool incremental_coverage = true;
+  bool deduplication = true;
+  bool deferred_evaluation = false;
+  bool prescreening = true;
+  bool cutoff = true;
+  bool loose_evaluation = false;
+  std::atomic<size_t> num_prescreen_checks{0};
+  std::atomic<size_t> num_prescreen_drops{0};
+  std::atomic<size_t> num_deferred_children{0};
+  std::atomic<size_t> num_deferred_evaluations{0};
+  std::atomic<size_t> num_socp_cutoffs{0};
+  std::atomic<size_t> num_incremental_socps{0};
+  details::TranspositionTable transposition_table;
+  std::unique_ptr<utils::ThreadPool> thread_pool; // for the child evaluation
   std::vector<std::unique_ptr<SequenceRule>> rules;
 };
 
@@ -165,5 +335,101 @@ TEST_CASE("Branching Strategy") {
   CHECK(root2.get_children().size() == 3);
 }
 
+TEST_CASE("Branching Strategy Prescreening") {
+  // A square and a circle far below it, which is best visited between the
+  // two lower corners.
+  Instance instance({{{0, 0}, 0.1},
+                     {{10, 0}, 0.1},
+                     {{10, 10}, 0.1},
+                     {{0, 10}, 0.1},
+                     {{5, -20}, 0.1}});
+  SolutionPool solution_pool;
+  solution_pool.add_solution(Solution(&instance, {0, 4, 1, 2, 3}));
+  const double ub = solution_pool.get_upper_bound();
+  FarthestCircle bs(false);
+  auto root = make_node(std::vector<int>{0, 1, 2, 3}, &instance);
+  bs.setup(&instance, root, &solution_pool);
+  CHECK(root->get_lower_bound() < ub);
+  CHECK(bs.branch(*root) == true);
+  // only the insertion of the optimal tour is not dominated
+  REQUIRE(root->get_children().size() == 1);
+  CHECK(root->get_children()[0]->obj() == doctest::Approx(ub));
+  std::unordered_map<std::string, std::string> stats;
+  bs.add_statistics(stats);
+  CHECK(stats["prescreen_drops"] == "3");
+  // The crossing square is still below the upper bound, but no insertion
+  // can make it shorter than the optimal tour.
+  auto crossing = make_node(std::vector<int>{0, 2, 1, 3}, &instance);
+  CHECK(crossing->get_lower_bound() < ub);
+  CHECK(bs.branch(*crossing) == true);
+  CHECK(crossing->get_children().empty());
+  CHECK(crossing->is_pruned());
+  CHECK(crossing->get_lower_bound() >= ub);
+  bs.add_statistics(stats);
+  CHECK(stats["prescreen_drops"] == "7");
+  // Without the prescreening, all these children are evaluated and none of
+  // them is better than the upper bound.
+  FarthestCircle unscreened(false);
+  unscreened.set_prescreening(false);
+  unscreened.setup(&instance, root, &solution_pool);
+  auto crossing2 = make_node(std::vector<int>{0, 2, 1, 3}, &instance);
+  CHECK(unscreened.branch(*crossing2) == true);
+  CHECK(crossing2->get_children().size() == 4);
+  for (auto &child : crossing2->get_children()) {
+    CHECK(child->obj() >= ub);
+  }
+}
+
+TEST_CASE("Branching Strategy Deferred Evaluation") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  FarthestCircle bs(false);
+  bs.set_deferred_evaluation(true);
+  auto root = make_node(std::vector<int>{0, 1, 2}, &instance);
+  bs.setup(&instance, root, nullptr);
+  CHECK(bs.branch(*root) == true);
+  auto &children = root->get_children();
+  CHECK(children.size() == 3);
+  for (auto &child : children) {
+    CHECK(child->is_deferred());
+    CHECK(child->get_lower_bound() >= root->get_lower_bound());
+    CHECK(child->get_objective_estimate() >= root->obj());
+  }
+  bs.evaluate_deferred(*children[0]);
+  CHECK(!children[0]->is_deferred());
+  CHECK(children[0]->get_lower_bound() ==
+        doctest::Approx(children[0]->obj()));
+  std::unordered_map<std::string, std::string> stats;
+  bs.add_statistics(stats);
+  CHECK(stats["deferred_children"] == "3");
+  CHECK(stats["saved_socp_calls"] == "2");
+}
+
+TEST_CASE("Branching Strategy Deferred Sequence Checks") {
+  Instance instance({{{0, 0}, 1}, {{3, 0}, 1}, {{6, 0}, 1}, {{3, 6}, 1}});
+  FarthestCircle bs(false);
+  bs.set_deferred_evaluation(true);
+  auto root = make_node(std::vector<int>{0, 1, 2}, &instance);
+  auto twin = make_node(std::vector<int>{0, 1, 2}, &instance);
+  bs.setup(&instance, root, nullptr);
+  CHECK(bs.branch(*root) == true);
+  CHECK(bs.branch(*twin) == true);
+  std::unordered_map<std::string, std::string> stats;
+  bs.add_statistics(stats);
+  CHECK(stats["transposition_lookups"] == "0"); // no sequences yet
+  for (auto &child : root->get_children()) {
+    bs.evaluate_deferred(*child);
+    CHECK(!child->is_pruned());
+  }
+  // the twin's children are duplicates and dropped when selected
+  for (auto &child : twin->get_children()) {
+    bs.evaluate_deferred(*child);
+    CHECK(child->is_pruned());
+  }
+  bs.add_statistics(stats);
+  CHECK(stats["transposition_lookups"] == "6");
+  CHECK(stats["transposition_hits"] == "3");
+  CHECK(stats["deferred_evaluations"] == "3");
+}
+
 } // namespace cetsp
 #endif // CETSP_BRANCHING_STRATEGY_H
@@ -11,8 +11,12 @@
 #ifndef CETSP_SEARCH_STRATEGY_H
 #define CETSP_SEARCH_STRATEGY_H
 #include "branching_strategy.h"
+#include "cetsp/details/open_node_purge.h"
 #include "cetsp/node.h"
 #include <algorithm>
+#include <random>
+#include <tuple>
+#include <vector>
 
 namespace cetsp {
 
@@ -50,70 +54,158 @@ public:
    */
   virtual void notify_of_prune(Node &node){};
 
+  /**
+   * Called when the upper bound has improved. The open nodes with a lower
+   * bound of at least `lower_bound_limit` cannot lead to a better solution
+   * and should be pruned and dropped right away, see
+   * details::purge_if_dominated.
+   * @param lower_bound_limit The upper bound with the gap applied.
+   * @return The number of dropped nodes and the freed memory.
+   */
+  virtual details::PurgeStatistics
+  notify_of_upper_bound(double lower_bound_limit) {
+    return {};
+  }
+
+  /**
+   * Called when the (last) node has been evaluated after its selection, as
+   * its evaluation has been deferred by the branching. Its lower bound may
+   * have increased, such that it is no longer the best choice.
+   * @param node The last node.
+   * @return True if the node has been taken back into the open nodes instead
+   * of being explored now.
+   */
+  virtual bool notify_of_evaluation(std::shared_ptr<Node> &node) {
+    return false;
+  }
+
   virtual ~SearchStrategy() = default;
+
+protected:
+  /**
+   * Drops the dominated nodes from a plain list of open nodes, keeping the
+   * order of the others.
+   */
+  static details::PurgeStatistics
+  purge(std::vector<std::shared_ptr<Node>> &nodes,
+        const double lower_bound_limit) {
+    details::PurgeStatistics stats;
+    nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                               [&](std::shared_ptr<Node> &node) {
+                                 return details::purge_if_dominated(
+                                     *node, lower_bound_limit, stats);
+                               }),
+                nodes.end());
+    return stats;
+  }
 };
 
 class DfsBfs : public SearchStrategy {
+  /**
+   * The open nodes are split into a stack, on which the children are pushed
+   * for the depth first search, and a heap. Every time a node is pruned or
+   * feasible, the stack is moved into the heap, such that the search
+   * continues at the node with the lowest value. This is the same as sorting
+   * all open nodes, but only the nodes of the stack have to be inserted.
+   */
 public:
   void init(std::shared_ptr<Node> &root) override {
     std::cout << "Using DfsBfs search" << std::endl;
-    queue.emplace_back(root, root->obj(),
-                       root->get_relaxed_solution().obj());
+    stack.push_back(make_entry(root));
   }
 
   void notify_of_branch(Node &node) override {
-    auto children = node.get_children();
-    std::sort(children.begin(), children.end(),
-              [](std::shared_ptr<Node> &a, std::shared_ptr<Node> &b) {
-                const auto lb_a = a->obj();
-                const auto lb_b = b->obj();
-                if (std::abs(lb_a - lb_b) < 0.001) { // approx equal
-                  return a->get_relaxed_solution().obj() >
-                         b->get_relaxed_solution().obj();
-                }
-                return a->obj() > b->obj();
-              });
-    for (auto &child : children) {
-      queue.emplace_back(child, child->obj(),
-                         child->get_relaxed_solution().obj());
+    // the cheapest child on top of the stack
+    std::vector<Entry> children;
+    for (auto &child : node.get_children()) {
+      children.push_back(make_entry(child));
+    }
+    std::sort(children.begin(), children.end(), is_higher_value);
+    for (auto &entry : children) {
+      stack.push_back(std::move(entry));
     }
   }
 
   void notify_of_feasible(Node &node) override {
-    sort_to_priotize_lowest_value();
+    prioritize_lowest_value();
   }
 
-  void notify_of_prune(Node &node) override { sort_to_priotize_lowest_value(); }
+  void notify_of_prune(Node &node) override { prioritize_lowest_value(); }
+
+  details::PurgeStatistics
+  notify_of_upper_bound(const double lower_bound_limit) override {
+    details::PurgeStatistics stats;
+    auto is_dominated = [&](Entry &entry) {
+      return details::purge_if_dominated(*std::get<0>(entry),
+                                         lower_bound_limit, stats);
+    };
+    stack.erase(std::remove_if(stack.begin(), stack.end(), is_dominated),
+                stack.end());
+    heap.erase(std::remove_if(heap.begin(), heap.end(), is_dominated),
+               heap.end());
+    std::make_heap(heap.begin(), heap.end(), is_higher_value);
+    return stats;
+  }
 
   std::shared_ptr<Node> next() override {
     if (!has_next()) {
       return nullptr;
     }
-    auto n = queue.back();
-    queue.pop_back();
-    return std::get<0>(n);
+    if (!stack.empty()) {
+      auto n = std::get<0>(stack.back());
+      stack.pop_back();
+      return n;
+    }
+    std::pop_heap(heap.begin(), heap.end(), is_higher_value);
+    auto n = std::get<0>(heap.back());
+    heap.pop_back();
+    return n;
   }
   bool has_next() override {
-    // remove all pruned entries  from  the back
-    while (!queue.empty() && std::get<0>(queue.back())->is_pruned()) {
-      queue.pop_back();
+    // remove all pruned entries from the top
+    while (!stack.empty() && std::get<0>(stack.back())->is_pruned()) {
+      stack.pop_back();
     }
-    return !queue.empty();
+    if (!stack.empty()) {
+      return true;
+    }
+    while (!heap.empty() && std::get<0>(heap.front())->is_pruned()) {
+      std::pop_heap(heap.begin(), heap.end(), is_higher_value);
+      heap.pop_back();
+    }
+    return !heap.empty();
   }
 
 private:
-  void sort_to_priotize_lowest_value() {
-    std::sort(queue.begin(), queue.end(), [](auto &a, auto &b) {
-      const auto lb_a = std::get<1>(a);
-      const auto lb_b = std::get<1>(b);
-      if (std::abs(lb_a - lb_b) < 0.001) { // approx equal
-        return std::get<2>(a) > std::get<2>(b);
-      }
-      return lb_a > lb_b;
-    });
+  // The node, its value, and the value to break ties. Evaluated nodes break
+  // ties by their objective, deferred nodes by their lower bound, as the
+  // children of deferred evaluations only differ in their estimated value.
+  using Entry = std::tuple<std::shared_ptr<Node>, double, double>;
+
+  static Entry make_entry(const std::shared_ptr<Node> &node) {
+    const double value = node->get_objective_estimate();
+    return {node, value, node->is_deferred() ? node->get_lower_bound() : value};
+  }
+
+  static bool is_higher_value(const Entry &a, const Entry &b) {
+    const auto lb_a = std::get<1>(a);
+    const auto lb_b = std::get<1>(b);
+    if (std::abs(lb_a - lb_b) < 0.001) { // approx equal
+      return std::get<2>(a) > std::get<2>(b);
+    }
+    return lb_a > lb_b;
+  }
+
+  void prioritize_lowest_value() {
+    for (auto &entry : stack) {
+      heap.push_back(std::move(entry));
+      std::push_heap(heap.begin(), heap.end(), is_higher_value);
+    }
+    stack.clear();
   }
 
-  std::vector<std::tuple<std::shared_ptr<Node>, double, double>> queue;
+  std::vector<Entry> stack;
+  std::vector<Entry> heap; // the lowest value on top
 };
 class CheapestChildDepthFirst : public SearchStrategy {
 public:
@@ -126,8 +218,8 @@ public:
                 const auto lb_a = a->get_lower_bound();
                 const auto lb_b = b->get_lower_bound();
                 if (std::abs(lb_a - lb_b) < 0.001) { // approx equal
-                  return a->get_relaxed_solution().obj() >
-                         b->get_relaxed_solution().obj();
+                  return a->get_objective_estimate() >
+                         b->get_objective_estimate();
                 }
                 return lb_a > lb_b;
               });
@@ -136,6 +228,11 @@ public:
     }
   }
 
+  details::PurgeStatistics
+  notify_of_upper_bound(const double lower_bound_limit) override {
+    return purge(queue, lower_bound_limit);
+  }
+
   std::shared_ptr<Node> next() override {
     if (!has_next()) {
       return nullptr;
@@ -156,43 +253,95 @@ private:
   std::vector<std::shared_ptr<Node>> queue;
 };
 class CheapestBreadthFirst : public SearchStrategy {
+  /**
+   * Always explores the node with the lowest lower bound. The open nodes are
+   * kept in a heap. As the lower bounds can only increase after a node has
+   * been inserted, the key of the top is checked when it is taken and the
+   * node is reinserted if its lower bound has changed in the meantime.
+   */
 public:
-  void init(std::shared_ptr<Node> &root) override { queue.push_back(root); }
+  void init(std::shared_ptr<Node> &root) override { push(root); }
 
   void notify_of_branch(Node &node) override {
     for (auto &child : node.get_children()) {
-      queue.push_back(child);
+      push(child);
     }
-    std::sort(queue.begin(), queue.end(),
-              [](std::shared_ptr<Node> &a, std::shared_ptr<Node> &b) {
-                const auto lb_a = a->get_lower_bound();
-                const auto lb_b = b->get_lower_bound();
-                if (std::abs(lb_a - lb_b) < 0.001) { // approx equal
-                  return a->get_relaxed_solution().obj() >
-                         b->get_relaxed_solution().obj();
-                }
-                return lb_a > lb_b;
-              });
+  }
+
+  details::PurgeStatistics
+  notify_of_upper_bound(const double lower_bound_limit) override {
+    details::PurgeStatistics stats;
+    heap.erase(std::remove_if(heap.begin(), heap.end(),
+                              [&](Entry &entry) {
+                                return details::purge_if_dominated(
+                                    *entry.node, lower_bound_limit, stats);
+                              }),
+               heap.end());
+    std::make_heap(heap.begin(), heap.end(), is_more_expensive);
+    return stats;
+  }
+
+  bool notify_of_evaluation(std::shared_ptr<Node> &node) override {
+    // Only take the node back if its new key is no longer the cheapest one.
+    // Otherwise, it would just be taken again right away.
+    if (heap.empty() || !is_more_expensive(make_entry(node), heap.front())) {
+      return false;
+    }
+    push(node);
+    return true;
   }
 
   std::shared_ptr<Node> next() override {
     if (!has_next()) {
       return nullptr;
     }
-    auto n = queue.back();
-    queue.pop_back();
+    std::pop_heap(heap.begin(), heap.end(), is_more_expensive);
+    auto n = std::move(heap.back().node);
+    heap.pop_back();
     return n;
   }
   bool has_next() override {
-    // remove all pruned entries  from  the back
-    while (!queue.empty() && queue.back()->is_pruned()) {
-      queue.pop_back();
+    while (!heap.empty()) {
+      auto &top = heap.front();
+      if (top.node->is_pruned()) {
+        std::pop_heap(heap.begin(), heap.end(), is_more_expensive);
+        heap.pop_back();
+      } else if (top.node->get_lower_bound() != top.lower_bound) {
+        // outdated key, reinsert with the current lower bound
+        std::pop_heap(heap.begin(), heap.end(), is_more_expensive);
+        heap.back().lower_bound = heap.back().node->get_lower_bound();
+        std::push_heap(heap.begin(), heap.end(), is_more_expensive);
+      } else {
+        return true;
+      }
     }
-    return !queue.empty();
+    return false;
   }
 
 private:
-  std::vector<std::shared_ptr<Node>> queue;
+  struct Entry {
+    std::shared_ptr<Node> node;
+    double lower_bound;
+    double obj;
+  };
+
+  static Entry make_entry(const std::shared_ptr<Node> &node) {
+    return {node, node->get_lower_bound(), node->get_objective_estimate()};
+  }
+
+  void push(const std::shared_ptr<Node> &node) {
+    heap.push_back(make_entry(node));
+    std::push_heap(heap.begin(), heap.end(), is_more_expensive);
+  }
+
+  static bool is_more_expensive(const Entry &a, const Entry &b) {
+    if (std::abs(a.lower_bound - b.lower_bound) < 0.001) { // approx equal
+      return a.obj > b.obj;
+    }
+    return a.lower_bound > b.lower_bound;
+  }
+
+  std::vector<Entry> heap; // the lowest lower bound on top
 };
 
 class RandomNextNode : public SearchStrategy {
@@ -207,10 +356,11 @@ public:
     for (auto &child : node.get_children()) {
       queue.push_back(child);
     }
-    // Shuffle queue.
-    // TODO: It would be more efficient to just take a random element
-    //  from the queue.
-    std::shuffle(queue.begin(), queue.end(), std::default_random_engine());
+  }
+
+  details::PurgeStatistics
+  notify_of_upper_bound(const double lower_bound_limit) override {
+    return purge(queue, lower_bound_limit);
   }
 
   std::shared_ptr<Node> next() override {
@@ -222,15 +372,23 @@ public:
     return n;
   }
   bool has_next() override {
-    // remove all pruned entries  from  the back
-    while (!queue.empty() && queue.back()->is_pruned()) {
+    // Move a uniformly random open node to the back and drop it if it is
+    // pruned. Every selection is random, instead of shuffling the queue with
+    // the same seed on every branch and then taking nodes from its back.
+    while (!queue.empty()) {
+      std::uniform_int_distribution<size_t> distribution(0, queue.size() - 1);
+      std::swap(queue[distribution(generator)], queue.back());
+      if (!queue.back()->is_pruned()) {
+        return true;
+      }
       queue.pop_back();
     }
-    return !queue.empty();
+    return false;
   }
 
 private:
   std::vector<std::shared_ptr<Node>> queue;
+  std::default_random_engine generator;
 };
 TEST_CASE("Search Strategy") {
   // The strategy should choose the triangle and implicitly cover the
@@ -260,5 +418,94 @@ TEST_CASE("Search Strategy") {
   CHECK(ss2.next() == nullptr);
 }
 
+TEST_CASE("Cheapest Breadth First") {
+  Instance instance({{{0, 0}, 1},
+                     {{3, 0}, 1},
+                     {{6, 0}, 1},
+                     {{3, 6}, 1},
+                     {{8, 8}, 1},
+                     {{-4, 5}, 1}});
+  FarthestCircle bs;
+  auto root = std::make_shared<Node>(std::vector<int>{0, 2, 3}, &instance);
+  bs.setup(&instance, root, nullptr);
+  CheapestBreadthFirst ss;
+  ss.init(root);
+  // the nodes are explored in the order of their lower bounds
+  double last_lb = 0.0;
+  for (int i = 0; i < 5 && ss.has_next(); ++i) {
+    auto node = ss.next();
+    CHECK(node->get_lower_bound() >= last_lb - 0.001);
+    last_lb = node->get_lower_bound();
+    if (!node->is_feasible() && bs.branch(*node)) {
+      ss.notify_of_branch(*node);
+    }
+  }
+}
+
+TEST_CASE("Cheapest Breadth First Deferred Evaluation") {
+  Instance instance({{{0, 0}, 1},
+                     {{3, 0}, 1},
+                     {{6, 0}, 1},
+                     {{3, 6}, 1},
+                     {{8, 8}, 1},
+                     {{-4, 5}, 1}});
+  FarthestCircle bs(false);
+  bs.set_deferred_evaluation(true);
+  auto root = std::make_shared<Node>(std::vector<int>{0, 2, 3}, &instance);
+  bs.setup(&instance, root, nullptr);
+  CheapestBreadthFirst ss;
+  ss.init(root);
+  auto node = ss.next();
+  // an unchanged key is explored right away
+  CHECK(!ss.notify_of_evaluation(node));
+  CHECK(bs.branch(*node));
+  ss.notify_of_branch(*node);
+  const auto num_children = node->get_children().size();
+  CHECK(num_children > 1);
+  // the children share the lower bound of the root until they are evaluated
+  auto child = ss.next();
+  CHECK(child->is_deferred());
+  bs.evaluate_deferred(*child);
+  CHECK(child->get_lower_bound() > root->get_lower_bound() + 0.001);
+  CHECK(ss.notify_of_evaluation(child));
+  size_t num_taken = 0;
+  bool taken_again = false;
+  while (ss.has_next()) {
+    auto next = ss.next();
+    taken_again = taken_again || next == child;
+    ++num_taken;
+  }
+  CHECK(num_taken == num_children);
+  CHECK(taken_again);
+}
+
+TEST_CASE("Search Strategy Purge") {
+  Instance instance({{{0, 0}, 1},
+                     {{3, 0}, 1},
+                     {{6, 0}, 1},
+                     {{3, 6}, 1},
+                     {{8, 8}, 1},
+                     {{-4, 5}, 1}});
+  FarthestCircle bs;
+  auto root = std::make_shared<Node>(std::vector<int>{0, 2, 3}, &instance);
+  bs.setup(&instance, root, nullptr);
+  DfsBfs ss;
+  ss.init(root);
+  auto node = ss.next();
+  CHECK(bs.branch(*node));
+  ss.notify_of_branch(*node);
+  auto children = node->get_children();
+  CHECK(children.size() > 1);
+  std::sort(children.begin(), children.end(), [](auto &a, auto &b) {
+    return a->get_lower_bound() < b->get_lower_bound();
+  });
+  // only the cheapest child can improve the upper bound
+  const auto stats =
+      ss.notify_of_upper_bound(children[1]->get_lower_bound() - 1e-6);
+  CHECK(stats.num_nodes >= children.size() - 1);
+  CHECK(ss.next() == children[0]);
+  CHECK(!ss.has_next());
+}
+
 } // namespace cetsp
 #endif // CETSP_SEARCH_STRATEGY_H
@@ -6,7 +6,10 @@
 #define CETSP_GEOMETRY_H
 #include "doctest/doctest.h"
 #include <cmath>
+#include <cstddef>
+#include <random>
 #include <utility>
+#include <vector>
 namespace cetsp::utils {
 double distance_to_segment(std::pair<double, double> s0,
                            std::pair<double, double> s1,
@@ -18,6 +21,79 @@ TEST_CASE("Distance to Segment") {
   CHECK(distance_to_segment({0, 0}, {10, 0}, {0, -1}) == doctest::Approx(1.0));
   CHECK(distance_to_segment({0, 0}, {10, 0}, {-1, 0}) == doctest::Approx(1.0));
   CHECK(distance_to_segment({0, 0}, {10, 0}, {11, 0}) == doctest::Approx(1.0));
+  // degenerated segment
+  CHECK(distance_to_segment({1, 1}, {1, 1}, {4, 5}) == doctest::Approx(5.0));
+}
+
+/**
+ * The implementations of `distances_to_polyline`. AVX2 and AVX-512 are only
+ * available on x86-64 with GCC or Clang, and only used if the CPU supports
+ * them.
+ */
+enum class DistanceKernel { SCALAR, AVX2, AVX512 };
+
+/**
+ * The fastest kernel supported by the CPU, which is used by default.
+ */
+DistanceKernel get_distance_kernel();
+bool is_supported(DistanceKernel kernel);
+const char *get_name(DistanceKernel kernel);
+
+/**
+ * For n circles given as arrays of the centers and radii, computes the
+ * distance of every circle to the polyline through the m points (px, py),
+ * i.e., the minimal distance of the center to a segment minus the radius.
+ * A single point is a polyline, too.
+ * The kernels only differ in rounding.
+ */
+void distances_to_polyline(const double *x, const double *y, const double *r,
+                           size_t n, const double *px, const double *py,
+                           size_t m, double *out);
+void distances_to_polyline(const double *x, const double *y, const double *r,
+                           size_t n, const double *px, const double *py,
+                           size_t m, double *out, DistanceKernel kernel);
+
+TEST_CASE("Distances to Polyline") {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coord(-10, 10), radius(0, 2);
+  const size_t n = 37; // not a multiple of the lanes
+  std::vector<double> x(n), y(n), r(n);
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = coord(rng);
+    y[i] = coord(rng);
+    r[i] = radius(rng);
+  }
+  for (size_t m : {1, 2, 5}) {
+    std::vector<double> px(m), py(m);
+    for (size_t j = 0; j < m; ++j) {
+      px[j] = coord(rng);
+      py[j] = coord(rng);
+    }
+    if (m == 5) {
+      px[3] = px[2]; // degenerated segment
+      py[3] = py[2];
+    }
+    for (auto kernel : {DistanceKernel::SCALAR, DistanceKernel::AVX2,
+                        DistanceKernel::AVX512}) {
+      if (!is_supported(kernel)) {
+        continue;
+      }
+      std::vector<double> out(n);
+      distances_to_polyline(x.data(), y.data(), r.data(), n, px.data(),
+                            py.data(), m, out.data(), kernel);
+      for (size_t i = 0; i < n; ++i) {
+        double expected = std::hypot(x[i] - px[0], y[i] - py[0]);
+        for (size_t j = 0; j + 1 < m; ++j) {
+          expected = std::min(
+              expected, distance_to_segment({px[j], py[j]},
+                                            {px[j + 1], py[j + 1]},
+                                            {x[i], y[i]}));
+        }
+        CHECK(out[i] == doctest::Approx(expected - r[i]));
+      }
+    }
+  }
+  CHECK(is_supported(get_distance_kernel()));
 }
 } // namespace cetsp::utils
 
@@ -0,0 +1,89 @@
+/**
+ * A bounding volume hierarchy over the segments of a polyline, such that the
+ * distance of a point to the polyline can be computed without looking at
+ * every segment. Consecutive segments of a trajectory are close to each
+ * other, so the sequence of segments is simply halved recursively, and every
+ * node keeps the bounding box of its segments. A query descends into the
+ * closer box first and skips every box that is farther than the closest
+ * segment found, which needs O(log m) segments for most points.
+ *
+ * Building the hierarchy costs about as much as a few linear scans, so it
+ * only pays off if a polyline is queried for more than a handful of points,
+ * see `Trajectory::get_segment_bvh`.
+ */
+#ifndef CETSP_SEGMENT_BVH_H
+#define CETSP_SEGMENT_BVH_H
+#include "cetsp/utils/geometry.h"
+#include "doctest/doctest.h"
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace cetsp::utils {
+class SegmentBvh {
+public:
+  /**
+   * @param px, py The m points of the polyline. A single point is a segment
+   * of length zero.
+   */
+  SegmentBvh(const double *px, const double *py, size_t m);
+
+  /**
+   * The minimal distance of the point to a segment. The same as the minimum
+   * of `distance_to_segment` over all segments.
+   */
+  [[nodiscard]] double distance(double x, double y) const;
+
+  [[nodiscard]] size_t num_segments() const { return ax.size(); }
+
+private:
+  struct Node {
+    double x0, y0, x1, y1; // the bounding box of the segments
+    unsigned begin, end;   // the segments
+    unsigned left, right;  // the children, if the node is no leaf
+  };
+
+  unsigned build(unsigned begin, unsigned end);
+
+  [[nodiscard]] double squared_box_distance(const Node &node, double x,
+                                            double y) const;
+
+  std::vector<double> ax, ay, bx, by; // the segments
+  std::vector<Node> nodes; // the root is the first node
+  double slack = 0.0;      // for the rounding of the box distances
+};
+
+TEST_CASE("Segment BVH") {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> coord(-100, 100);
+  for (size_t m : {1, 2, 3, 10, 100, 1000}) {
+    std::vector<double> px, py;
+    for (size_t j = 0; j < m; ++j) {
+      px.push_back(coord(rng));
+      py.push_back(coord(rng));
+    }
+    if (m > 3) {
+      // a tour with a repeated point
+      px[m / 2] = px[m / 2 - 1];
+      py[m / 2] = py[m / 2 - 1];
+      px.back() = px.front();
+      py.back() = py.front();
+    }
+    SegmentBvh bvh(px.data(), py.data(), m);
+    CHECK(bvh.num_segments() == std::max<size_t>(1, m - 1));
+    for (int k = 0; k < 100; ++k) {
+      const double x = 2 * coord(rng), y = 2 * coord(rng);
+      double expected = std::numeric_limits<double>::infinity();
+      for (size_t j = 0; j < std::max<size_t>(1, m - 1); ++j) {
+        const size_t l = std::min(j + 1, m - 1);
+        expected = std::min(expected, distance_to_segment({px[j], py[j]},
+                                                          {px[l], py[l]},
+                                                          {x, y}));
+      }
+      CHECK(bvh.distance(x, y) == expected);
+    }
+  }
+}
+} // namespace cetsp::utils
+#endif // CETSP_SEGMENT_BVH_H
@@ -0,0 +1,262 @@
+/**
+ * A persistent thread pool for the small parallel tasks of the BnB, e.g.,
+ * evaluating the children of a node. Creating threads for every branch is
+ * too expensive if there are thousands of branches per second.
+ *
+ * The tasks are passed through a bounded lock-free queue. The thread calling
+ * `parallel_for` helps to process the tasks until its own tasks are done, so
+ * the pool can be used by multiple threads and also recursively.
+ */
+#ifndef CETSP_THREAD_POOL_H
+#define CETSP_THREAD_POOL_H
+#include "doctest/doctest.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace cetsp::utils {
+namespace details {
+/**
+ * A bounded multi-producer multi-consumer queue, following Dmitry Vyukov's
+ * design. Every cell has a sequence number that tells producers and
+ * consumers whose turn it is, so no locks are needed.
+ */
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity)
+      : capacity{round_up_to_power_of_two(capacity)}, mask{this->capacity - 1},
+        cells{new Cell[this->capacity]} {
+    for (size_t i = 0; i < this->capacity; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool try_push(const T &value) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells[pos & mask];
+      const size_t seq = cell.sequence.load(std::memory_order_acquire);
+      const auto diff =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T &value) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells[pos & mask];
+      const size_t seq = cell.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq) -
+                        static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          value = cell.value;
+          cell.sequence.store(pos + capacity, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // empty
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  static size_t round_up_to_power_of_two(size_t n) {
+    size_t p = 2;
+    while (p < n) {
+      p *= 2;
+    }
+    return p;
+  }
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  const size_t capacity;
+  const size_t mask;
+  std::unique_ptr<Cell[]> cells;
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+} // namespace details
+
+class ThreadPool {
+public:
+  /**
+   * @param num_threads The number of threads in the pool. The threads calling
+   * `parallel_for` help, so `num_threads - 1` is sensible for a single
+   * caller.
+   * @param capacity The number of tasks that can be queued. If the queue is
+   * full, the caller processes the task itself.
+   */
+  explicit ThreadPool(size_t num_threads, size_t capacity = 1024)
+      : queue{capacity} {
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads.emplace_back([this]() { work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      stopping = true;
+    }
+    wake_up.notify_all();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  /**
+   * Calls `f(i)` for all `i` in `[0, n)` in parallel and returns after all
+   * calls are done. The first exception thrown by a call is rethrown.
+   */
+  template <typename F> void parallel_for(size_t n, F &&f) {
+    if (n == 0) {
+      return;
+    }
+    Group<std::remove_reference_t<F>> group{&f, n};
+    for (size_t i = 1; i < n; ++i) {
+      Task task{&Group<std::remove_reference_t<F>>::run, &group, i};
+      ++num_queued;
+      if (queue.try_push(task)) {
+        if (num_sleeping > 0) {
+          std::lock_guard<std::mutex> lock(sleep_mutex);
+          wake_up.notify_one();
+        }
+      } else {
+        --num_queued;
+        task(); // queue is full
+      }
+    }
+    Task{&Group<std::remove_reference_t<F>>::run, &group, 0}();
+    // help with the queued tasks until all of the group are done
+    while (group.remaining > 0) {
+      if (!try_run_one()) {
+        std::this_thread::yield();
+      }
+    }
+    if (group.exception) {
+      std::rethrow_exception(group.exception);
+    }
+  }
+
+  [[nodiscard]] size_t num_threads() const { return threads.size(); }
+
+private:
+  struct Task {
+    void (*run)(void *, size_t);
+    void *group;
+    size_t index;
+    void operator()() const { run(group, index); }
+  };
+
+  struct GroupBase {
+    std::atomic<size_t> remaining;
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+  };
+
+  template <typename F> struct Group : GroupBase {
+    Group(F *f, size_t n) : f{f} { remaining = n; }
+    static void run(void *group_, size_t i) {
+      auto *group = static_cast<Group *>(group_);
+      try {
+        (*group->f)(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(group->exception_mutex);
+        if (!group->exception) {
+          group->exception = std::current_exception();
+        }
+      }
+      --group->remaining;
+    }
+    F *f;
+  };
+
+  bool try_run_one() {
+    Task task{};
+    if (!queue.try_pop(task)) {
+      return false;
+    }
+    --num_queued;
+    task();
+    return true;
+  }
+
+  void work() {
+    while (!stopping) {
+      // spin for a short while, as tasks usually come in bursts
+      bool found = false;
+      for (int i = 0; i < 64 && !found; ++i) {
+        found = try_run_one();
+        if (!found) {
+          std::this_thread::yield();
+        }
+      }
+      if (found) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex);
+      ++num_sleeping;
+      wake_up.wait(lock, [this]() { return stopping || num_queued > 0; });
+      --num_sleeping;
+    }
+  }
+
+  details::BoundedQueue<Task> queue;
+  std::vector<std::thread> threads;
+  std::atomic<size_t> num_queued{0};
+  std::atomic<size_t> num_sleeping{0};
+  std::atomic<bool> stopping{false};
+  std::mutex sleep_mutex;
+  std::condition_variable wake_up;
+};
+
+TEST_CASE("Thread Pool") {
+  ThreadPool pool(3, 4);
+  std::vector<int> values(100, 0);
+  pool.parallel_for(values.size(), [&values](size_t i) { values[i] = i; });
+  for (size_t i = 0; i < values.size(); ++i) {
+    CHECK(values[i] == static_cast<int>(i));
+  }
+  // recursive usage
+  std::atomic<int> sum{0};
+  pool.parallel_for(4, [&](size_t) {
+    pool.parallel_for(10, [&](size_t j) { sum += static_cast<int>(j); });
+  });
+  CHECK(sum == 4 * 45);
+  // a single failing task is enough
+  CHECK_THROWS(pool.parallel_for(8, [](size_t i) {
+    if (i == 5) {
+      throw std::runtime_error("task failed");
+    }
+  }));
+}
+} // namespace cetsp::utils
+#endif // CETSP_THREAD_POOL_H
@@ -4,14 +4,17 @@
 #include "cetsp/bnb.h"
 #include "cetsp/common.h"
 #include "cetsp/details/cross_lower_bound.h"
-#include "cetsp/details/missing_disks_lb.h"
 #include "cetsp/details/triple_map.h"
 #include "cetsp/heuristics.h"
 #include "cetsp/node.h"
+#include "cetsp/soc.h"
 #include "cetsp/strategies/rules/global_convex_hull_rule.h"
 #include "cetsp/strategies/rules/layered_convex_hull_rule.h"
 #include <fmt/core.h>
+#ifndef CETSP_WITHOUT_GUROBI
+#include "cetsp/details/missing_disks_lb.h"
 #include <gurobi_c++.h>
+#endif
 #include <iostream>
 #include <pybind11/functional.h>
 #include <pybind11/operators.h> // to define operator overloading
@@ -58,8 +61,22 @@ branch_and_bound(Instance instance, Solution *initial_solution, int timelimit,
                  std::string branching, std::string search, std::string root,
                  std::vector<std::string> rules, size_t num_threads,
                  bool simplify, double feasibility_tol, double optimality_gap,
-                 bool use_stronger_lb) {
+                 bool use_stronger_lb, std::string trajectory_solver,
+                 size_t num_workers, size_t memory_budget_mb,
+                 bool deferred_evaluation, bool loose_evaluation) {
   instance.eps = feasibility_tol;
+  if (trajectory_solver == "Native") {
+    set_trajectory_solver(std::make_shared<NativeTrajectorySolver>());
+#ifndef CETSP_WITHOUT_GUROBI
+  } else if (trajectory_solver == "Gurobi") {
+    set_trajectory_solver(std::make_shared<GurobiTrajectorySolver>());
+  } else if (trajectory_solver == "GurobiLean") {
+    set_trajectory_solver(std::make_shared<GurobiTrajectorySolver>(
+        GurobiTrajectorySolver::Formulation::LEAN));
+#endif
+  } else {
+    throw std::invalid_argument("Invalid trajectory solver.");
+  }
   std::unique_ptr<RootNodeStrategy> rns;
   if (root == "ConvexHull") {
     rns = std::make_unique<ConvexHullRoot>();
@@ -79,6 +96,8 @@ branch_and_bound(Instance instance, Solution *initial_solution, int timelimit,
   } else {
     throw std::invalid_argument("Invalid branching strategy.");
   }
+  branching_strategy->set_deferred_evaluation(deferred_evaluation);
+  branching_strategy->set_loose_evaluation(loose_evaluation);
   std::unique_ptr<SearchStrategy> search_strategy;
   if (search == "DfsBfs") {
     search_strategy = std::make_unique<DfsBfs>();
@@ -112,15 +131,20 @@ branch_and_bound(Instance instance, Solution *initial_solution, int timelimit,
   //  baba.add_node_callback(std::make_unique<PythonCallback>(py_callback));
   //}
   if (use_stronger_lb) {
+#ifndef CETSP_WITHOUT_GUROBI
     baba.add_node_callback(
         std::make_unique<LowerBoundImprovingCallback<InsertionCostCalculator>>(
             instance));
+#else
+    throw std::invalid_argument("The stronger lower bound requires Gurobi.");
+#endif
   }
 
   if (initial_solution != nullptr) {
     baba.add_upper_bound(*initial_solution);
   }
-  baba.optimize(timelimit, /*gap=*/optimality_gap);
+  baba.set_memory_budget(memory_budget_mb * 1024 * 1024);
+  baba.optimize_parallel(timelimit, num_workers, /*gap=*/optimality_gap);
   return {baba.get_solution(), baba.get_lower_bound(), baba.get_statistics()};
 }
 
@@ -154,6 +178,7 @@ PYBIND11_MODULE(_cetsp_bindings, m) {
       .def("__getitem__",
            [](const Trajectory &self, int i) { return self.points.at(i); })
       .def("distance", &Trajectory::distance)
+      .def("distances", &Trajectory::distances)
       .def("is_simple", &Trajectory::is_simple);
 
   py::class_<Node>(m, "Node", "Node in the BnB-tree.")
@@ -253,8 +278,17 @@ PYBIND11_MODULE(_cetsp_bindings, m) {
         py::arg("rules") = std::vector<std::string>{"GlobalConvexHullRule"},
         py::arg("num_threads") = 8, py::arg("simplify") = true,
         py::arg("feasibility_tol") = 0.001, py::arg("optimality_gap") = 0.01,
-        py::arg("use_stronger_lb") = false);
+        py::arg("use_stronger_lb") = false,
+#ifndef CETSP_WITHOUT_GUROBI
+        py::arg("trajectory_solver") = "Gurobi",
+#else
+        py::arg("trajectory_solver") = "Native",
+#endif
+        py::arg("num_workers") = 1, py::arg("memory_budget_mb") = 0,
+        py::arg("deferred_evaluation") = false,
+        py::arg("loose_evaluation") = false);
 
+#ifndef CETSP_WITHOUT_GUROBI
   // gurobi exception
   static py::exception<GRBException> exc(m, "GRBException");
   py::register_exception_translator([](std::exception_ptr p) {
@@ -266,4 +300,5 @@ PYBIND11_MODULE(_cetsp_bindings, m) {
       exc(msg.c_str());
     }
   });
+#endif
 }
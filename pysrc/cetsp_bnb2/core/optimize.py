@@ -33,9 +33,28 @@ def optimize(
     optimality_gap: float = 0.01,
     fallback_if_no_concorde: bool = True,
     use_stronger_lb: bool = False,
+    trajectory_solver: typing.Optional[str] = None,
+    num_workers: int = 1,
+    memory_budget_mb: int = 0,
+    deferred_evaluation: bool = False,
+    loose_evaluation: bool = False,
 ) -> Solution:
     """
     Solves the instance using the BnB-algorithm.
+    The trajectories are computed with Gurobi if the module has been built
+    with it. Use `trajectory_solver="Native"` for the built-in solver, or
+    `trajectory_solver="GurobiLean"` for a smaller Gurobi model.
+    With `num_workers > 1`, the tree is explored in parallel and the search
+    strategy is ignored. The callbacks cannot add lazy circles then.
+    With `memory_budget_mb > 0`, the relaxed solutions of the least promising
+    open nodes are freed if they need more memory, and recomputed when the
+    nodes are explored (only for `num_workers=1`).
+    With `deferred_evaluation`, the trajectories of the children are only
+    computed when the search selects them, such that children pruned before
+    do not need a solve.
+    With `loose_evaluation`, the trajectories of the children are only
+    computed to a loose precision with a certified lower bound. A node is
+    solved exactly only if it is close to the upper bound or feasible.
     """
     # compute initial solution
     try:
@@ -74,4 +93,13 @@ def optimize(
         feasibility_tol=feasibility_tol,
         optimality_gap=optimality_gap,
         use_stronger_lb=use_stronger_lb,
+        num_workers=num_workers,
+        memory_budget_mb=memory_budget_mb,
+        deferred_evaluation=deferred_evaluation,
+        loose_evaluation=loose_evaluation,
+        **(
+            {"trajectory_solver": trajectory_solver}
+            if trajectory_solver is not None
+            else {}
+        ),
     )
@@ -2,68 +2,89 @@
 // Created by Dominik Krupke on 21.12.22.
 //
 #include "cetsp/strategies/branching_strategy.h"
-#include <boost/thread/thread.hpp>
+#include <cmath>
+#include <limits>
 // #include <execution>
 namespace cetsp {
 
-/**
- * Find the circle that is most distanced to the current (relaxed) solution.
- * This is a good circle to branch upon. If no circle is uncovered, it returns
- * nothing.
- * @param solution The relaxed solution.
- * @param instance The instance with the circles.
- * @return The index of the most distanced circle in the solution or nothing
- *          if all circles are included.
- */
-std::optional<int>
-get_index_of_most_distanced_circle(const PartialSequenceSolution &solution,
-                                   const Instance &instance) {
-  const int n = static_cast<int>(instance.size());
-  std::vector<double> distances(n);
-  for (int i = 0; i < n; ++i) {
-    if (solution.covers(i)) {
-      distances[i] = 0;
-    } else {
-      distances[i] = solution.distance(i);
-    }
-  }
-  auto max_dist = std::max_element(distances.begin(), distances.end());
-  if (*max_dist <= 0) {
-    return {};
-  }
-  const int c = static_cast<int>(std::distance(distances.begin(), max_dist));
-  return {c};
-}
-
 void distributed_child_evaluation(std::vector<std::shared_ptr<Node>> &children,
                                   const bool simplify,
-                                  const size_t num_threads) {
+                                  utils::ThreadPool *thread_pool,
+                                  const double cutoff, const bool loose) {
   // Parallelize the computation of the relaxed solutions for the children
   // using a simple modulo on the number of threads. This is fine as we write
-  // on separate heap memory for all children.
-  boost::thread_group tg;
-  if (num_threads <= 1) { // Without threading overhead.
-    for (auto i = 0; i < children.size(); i += 1) {
-      children[i]->trigger_lazy_evaluation();
-      if (simplify) {
-        children[i]->simplify();
+  // on separate heap memory for all children. Every task evaluates its
+  // children as one batch, such that the trajectory solver can share its
+  // setup.
+  const size_t num_tasks =
+      thread_pool == nullptr
+          ? 1
+          : std::min(thread_pool->num_threads() + 1, children.size());
+  auto evaluate = [&children, simplify, num_tasks, cutoff,
+                   loose](size_t offset) {
+    std::vector<Node *> batch;
+    for (auto i = offset; i < children.size(); i += num_tasks) {
+      batch.push_back(children[i].get());
+    }
+    Node::trigger_lazy_evaluation(batch, cutoff, loose);
+    for (auto *child : batch) {
+      if (simplify && !child->get_relaxed_solution().is_above_cutoff()) {
+        child->simplify();
       }
+      child->release_sequence();
     }
+  };
+  if (num_tasks <= 1) { // Without threading overhead.
+    evaluate(0);
   } else {
-    for (unsigned int offset = 0;
-         offset < std::min(num_threads, children.size()); ++offset) {
-      tg.create_thread([=, &children]() {
-        for (auto i = offset; i < children.size(); i += num_threads) {
-          children[i]->trigger_lazy_evaluation();
-          if (simplify) {
-            children[i]->simplify();
-          }
-        }
-      });
-    }
+    thread_pool->parallel_for(num_tasks, evaluate);
   }
-  tg.join_all(); // Wait for all threads to finish, so we are in a consistent
-                 // state.
+}
+
+/**
+ * A cheap estimate of the length that inserting the circle between the
+ * hitting points `p` and `q` adds to the trajectory. It is not a lower bound,
+ * as the other hitting points may move, and only used to order the nodes.
+ */
+static double estimate_detour(const Point &p, const Point &q,
+                              const Circle &circle) {
+  const double dp = std::max(0.0, circle.center.dist(p) - circle.radius);
+  const double dq = std::max(0.0, circle.center.dist(q) - circle.radius);
+  return std::max(0.0, dp + dq - p.dist(q));
+}
+
+static double estimate_insertion(const PartialSequenceSolution &parent,
+                                 const Instance &instance, int circle,
+                                 int inserted_at) {
+  const auto &points = parent.get_trajectory().points;
+  if (instance.is_path()) {
+    // the trajectory starts with the begin of the path
+    return parent.obj() + estimate_detour(points[inserted_at],
+                                          points[inserted_at + 1],
+                                          instance.at(circle));
+  }
+  const int n = static_cast<int>(parent.get_sequence().size());
+  const auto &p = parent.get_sequence_hitting_point((inserted_at + n - 1) % n);
+  const auto &q = parent.get_sequence_hitting_point(inserted_at % n);
+  return parent.obj() + estimate_detour(p, q, instance.at(circle));
+}
+
+double CircleBranching::lower_bound_on_insertion(
+    const std::vector<int> &parent_sequence, const int circle,
+    const int inserted_at) const {
+  const int n = static_cast<int>(parent_sequence.size());
+  auto get_circle = [&](int i) { return instance->at(parent_sequence[i]); };
+  if (instance->is_path()) {
+    // the end points of the path are circles without radius
+    const Circle prev = inserted_at == 0 ? Circle(instance->path->first, 0)
+                                         : get_circle(inserted_at - 1);
+    const Circle next = inserted_at == n ? Circle(instance->path->second, 0)
+                                         : get_circle(inserted_at);
+    return details::lower_bound_on_detour(prev, instance->at(circle), next);
+  }
+  return details::lower_bound_on_detour(get_circle((inserted_at + n - 1) % n),
+                                        instance->at(circle),
+                                        get_circle(inserted_at % n));
 }
 
 bool CircleBranching::branch(Node &node) {
@@ -72,31 +93,146 @@ bool CircleBranching::branch(Node &node) {
     return false;
   }
   std::vector<std::shared_ptr<Node>> children;
-  std::vector<int> seq;
-  seq = node.get_fixed_sequence();
-  seq.push_back(*c);
+  std::shared_ptr<const details::ParentTrajectory> parent_trajectory;
+  if (incremental_evaluation) {
+    parent_trajectory = node.get_relaxed_solution().get_parent_trajectory();
+  }
+  std::shared_ptr<const details::ParentCoverage> parent_coverage;
+  if (incremental_coverage) {
+    parent_coverage = node.get_relaxed_solution().get_parent_coverage();
+  }
+  const std::vector<int> &parent_sequence = node.get_fixed_sequence();
+  // The children only record the insertion into the sequence of the node.
+  // If the chain of insertions becomes too long to materialize cheaply, the
+  // sequence of the node becomes the explicit base of all children.
+  auto base_record = node.get_relaxed_solution().get_sequence_record();
+  if (base_record->get_num_deltas() >= MAX_SEQUENCE_DELTAS) {
+    base_record =
+        std::make_shared<const details::SequenceRecord>(parent_sequence);
+  }
+  const double upper_bound = solution_pool != nullptr
+                                 ? solution_pool->get_upper_bound()
+                                 : std::numeric_limits<double>::infinity();
+  // The lowest bound of the dropped children, which still counts for the node.
+  double min_dropped_bound = std::numeric_limits<double>::infinity();
+  auto add_child = [&](int inserted_at) {
+    double bound = -std::numeric_limits<double>::infinity();
+    if (prescreening) {
+      ++num_prescreen_checks;
+      bound = node.get_relaxed_solution().get_lower_bound() +
+              lower_bound_on_insertion(parent_sequence, *c, inserted_at);
+      if (bound >= upper_bound) {
+        ++num_prescreen_drops;
+        min_dropped_bound = std::min(min_dropped_bound, bound);
+        return; // cannot improve on the upper bound
+      }
+    }
+    auto child = make_node(
+        details::make_sequence_record(base_record, *c, inserted_at), instance,
+        &node);
+    // The checks of the full sequence are deferred with the evaluation.
+    if (!deferred_evaluation && !is_child_ok(*child, node)) {
+      return;
+    }
+    if (parent_trajectory) {
+      child->set_parent_trajectory(parent_trajectory, inserted_at);
+    }
+    if (parent_coverage) {
+      child->set_parent_coverage(parent_coverage);
+    }
+    if (deferred_evaluation) {
+      child->defer_evaluation(estimate_insertion(node.get_relaxed_solution(),
+                                                 *instance, *c, inserted_at));
+      if (prescreening) {
+        child->add_lower_bound(bound); // valid without the SOCP, too
+      }
+      ++num_deferred_children;
+    }
+    children.push_back(std::move(child));
+  };
+  const int n = static_cast<int>(parent_sequence.size());
   if (instance->is_path()) {
     // for path, this position may not be symmetric and has to be added.
-    if (is_sequence_ok(seq, node)) {
-      children.push_back(std::make_shared<Node>(seq, instance, &node));
-    }
+    add_child(n);
   }
-  for (int i = seq.size() - 1; i > 0; --i) {
-    seq[i] = seq[i - 1];
-    seq[i - 1] = *c;
-    if (is_sequence_ok(seq, node)) {
-      children.push_back(std::make_shared<Node>(seq, instance, &node));
-    }
+  for (int i = n - 1; i >= 0; --i) {
+    add_child(i);
+  }
+  if (children.empty() && std::isfinite(min_dropped_bound)) {
+    // All children are dominated. Their bound still counts, so the node is
+    // not pruned as infeasible.
+    node.add_lower_bound(min_dropped_bound);
+    node.prune(false);
+    return true;
+  }
+  if (!deferred_evaluation) {
+    distributed_child_evaluation(children, simplify, thread_pool.get(),
+                                 get_cutoff(), loose_evaluation);
+    count_evaluations(children);
   }
-  distributed_child_evaluation(children, simplify, num_threads);
   node.branch(children);
   return true;
 }
 
+bool CircleBranching::is_child_ok(Node &child, const Node &parent) {
+  // Materializes the sequence, which is kept for the evaluation.
+  const auto &sequence = child.get_fixed_sequence();
+  if (!is_sequence_ok(sequence, parent)) {
+    return false;
+  }
+  // Only the sequences of the accepted children are recorded.
+  return !deduplication ||
+         transposition_table.insert(sequence, instance->is_tour());
+}
+
+void CircleBranching::evaluate_deferred(Node &node) {
+  if (!node.is_deferred()) {
+    return;
+  }
+  // A child that fails the checks is dropped as if it had never been
+  // created. Without a parent, it has been pruned together with it.
+  const Node *parent = node.get_parent();
+  if (parent == nullptr || !is_child_ok(node, *parent)) {
+    node.release_sequence();
+    node.prune();
+    return;
+  }
+  node.evaluate_deferred(get_cutoff(), loose_evaluation);
+  ++num_deferred_evaluations;
+  count_evaluation(node);
+  if (!node.get_relaxed_solution().is_above_cutoff() && simplify) {
+    node.simplify();
+  }
+  node.release_sequence();
+}
+
+double CircleBranching::get_cutoff() const {
+  if (!cutoff || solution_pool == nullptr) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return solution_pool->get_upper_bound();
+}
+
+void CircleBranching::count_evaluations(
+    const std::vector<std::shared_ptr<Node>> &children) {
+  for (const auto &child : children) {
+    count_evaluation(*child);
+  }
+}
+
+void CircleBranching::count_evaluation(Node &child) {
+  const auto &solution = child.get_relaxed_solution();
+  if (solution.is_above_cutoff()) {
+    ++num_socp_cutoffs;
+  } else if (solution.is_incremental()) {
+    ++num_incremental_socps;
+  }
+}
+
 std::optional<int> FarthestCircle::get_branching_circle(Node &node) {
-  const auto c = get_index_of_most_distanced_circle(node.get_relaxed_solution(),
-                                                    *instance);
-  return c;
+  // The circle that is most distanced to the relaxed solution is a good
+  // circle to branch upon.
+  return node.get_relaxed_solution().get_farthest_uncovered_circle();
 }
 std::optional<int> RandomCircle::get_branching_circle(Node &node) {
   std::vector<int> uncovered_circles;
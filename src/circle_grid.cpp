@@ -0,0 +1,383 @@
+#include "cetsp/details/circle_grid.h"
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <queue>
+
+namespace cetsp {
+namespace details {
+
+CircleGrid::CircleGrid(const std::vector<Circle> &circles,
+                       const std::vector<Point> &extra_points) {
+  const auto n = circles.size();
+  x.reserve(n);
+  y.reserve(n);
+  r.reserve(n);
+  for (const auto &c : circles) {
+    x.push_back(c.center.x);
+    y.push_back(c.center.y);
+    r.push_back(c.radius);
+  }
+  if (n == 0) {
+    cell_begin.assign(2, 0);
+    center_begin.assign(2, 0);
+    return;
+  }
+  double x1 = -std::numeric_limits<double>::infinity();
+  double y1 = x1;
+  x0 = std::numeric_limits<double>::infinity();
+  y0 = x0;
+  double sum_of_diameters = 0.0;
+  for (const auto &c : circles) {
+    x0 = std::min(x0, c.center.x - c.radius);
+    y0 = std::min(y0, c.center.y - c.radius);
+    x1 = std::max(x1, c.center.x + c.radius);
+    y1 = std::max(y1, c.center.y + c.radius);
+    sum_of_diameters += 2 * c.radius;
+  }
+  for (const auto &p : extra_points) {
+    x0 = std::min(x0, p.x);
+    y0 = std::min(y0, p.y);
+    x1 = std::max(x1, p.x);
+    y1 = std::max(y1, p.y);
+  }
+  // About one circle per cell, but the cells should not be much smaller than
+  // the circles, as every circle is registered in every cell it overlaps.
+  // The second term bounds the number of cells for flat instances.
+  const double width = x1 - x0, height = y1 - y0;
+  cell_size = std::max({std::sqrt(width * height / n),
+                        std::max(width, height) / n, sum_of_diameters / n});
+  if (!(cell_size > 0)) {
+    cell_size = 1.0; // all circles are the same point
+  }
+  nx = static_cast<int>(width / cell_size) + 1;
+  ny = static_cast<int>(height / cell_size) + 1;
+
+  // counting sort of the (cell, circle) pairs
+  auto register_circles = [&](bool only_center, std::vector<unsigned> &begin,
+                              std::vector<unsigned> &entries) {
+    auto for_each_cell = [&](const Circle &c, auto &&f) {
+      const double radius = only_center ? 0.0 : c.radius;
+      const int row_end = std::min(ny - 1, row_of(c.center.y + radius));
+      const int col_end = std::min(nx - 1, column_of(c.center.x + radius));
+      for (int row = std::max(0, row_of(c.center.y - radius)); row <= row_end;
+           ++row) {
+        for (int col = std::max(0, column_of(c.center.x - radius));
+             col <= col_end; ++col) {
+          f(row * nx + col);
+        }
+      }
+    };
+    begin.assign(static_cast<size_t>(nx) * ny + 1, 0);
+    for (const auto &c : circles) {
+      for_each_cell(c, [&](int cell) { ++begin[cell + 1]; });
+    }
+    for (size_t i = 1; i < begin.size(); ++i) {
+      begin[i] += begin[i - 1];
+    }
+    entries.resize(begin.back());
+    std::vector<unsigned> next(begin.begin(), begin.end() - 1);
+    for (unsigned i = 0; i < n; ++i) {
+      for_each_cell(circles[i], [&](int cell) { entries[next[cell]++] = i; });
+    }
+  };
+  register_circles(false, cell_begin, cell_circles);
+  register_circles(true, center_begin, center_circles);
+  build_pyramid();
+}
+
+void CircleGrid::build_pyramid() {
+  const double inf = std::numeric_limits<double>::infinity();
+  const Block empty{inf, inf, -inf, -inf, inf};
+  std::vector<Block> cells(static_cast<size_t>(nx) * ny, empty);
+  for (size_t cell = 0; cell < cells.size(); ++cell) {
+    auto &block = cells[cell];
+    for (auto k = center_begin[cell]; k < center_begin[cell + 1]; ++k) {
+      const auto i = center_circles[k];
+      block.x0 = std::min(block.x0, x[i]);
+      block.y0 = std::min(block.y0, y[i]);
+      block.x1 = std::max(block.x1, x[i]);
+      block.y1 = std::max(block.y1, y[i]);
+      block.min_radius = std::min(block.min_radius, r[i]);
+    }
+  }
+  pyramid.push_back(std::move(cells));
+  pyramid_width.push_back(nx);
+  int width = nx, height = ny;
+  while (width > 1 || height > 1) {
+    const int next_width = (width + 1) / 2, next_height = (height + 1) / 2;
+    std::vector<Block> next(static_cast<size_t>(next_width) * next_height,
+                            empty);
+    const auto &level = pyramid.back();
+    for (int row = 0; row < height; ++row) {
+      for (int col = 0; col < width; ++col) {
+        const auto &block = level[row * width + col];
+        auto &parent = next[(row / 2) * next_width + col / 2];
+        parent.x0 = std::min(parent.x0, block.x0);
+        parent.y0 = std::min(parent.y0, block.y0);
+        parent.x1 = std::max(parent.x1, block.x1);
+        parent.y1 = std::max(parent.y1, block.y1);
+        parent.min_radius = std::min(parent.min_radius, block.min_radius);
+      }
+    }
+    pyramid.push_back(std::move(next));
+    pyramid_width.push_back(next_width);
+    width = next_width;
+    height = next_height;
+  }
+}
+
+int CircleGrid::column_of(const double x) const {
+  // compared in double first, as the point may be far away
+  const double col = std::floor((x - x0) / cell_size);
+  return col < 0 ? -1 : static_cast<int>(std::min(col, double(nx)));
+}
+
+int CircleGrid::row_of(const double y) const {
+  const double row = std::floor((y - y0) / cell_size);
+  return row < 0 ? -1 : static_cast<int>(std::min(row, double(ny)));
+}
+
+template <typename F>
+void CircleGrid::for_each_cell_near(const Point &a, const Point &b,
+                                    const double margin, F &&f) const {
+  const int row_begin = std::max(0, row_of(std::min(a.y, b.y) - margin));
+  const int row_end = std::min(ny - 1, row_of(std::max(a.y, b.y) + margin));
+  const double dx = b.x - a.x, dy = b.y - a.y;
+  for (int row = row_begin; row <= row_end; ++row) {
+    // The part of the segment within the row, extended by the margin.
+    const double band_lo = y0 + row * cell_size - margin;
+    const double band_hi = band_lo + cell_size + 2 * margin;
+    double t0 = 0.0, t1 = 1.0;
+    if (dy != 0.0) {
+      double ta = (band_lo - a.y) / dy, tb = (band_hi - a.y) / dy;
+      if (ta > tb) {
+        std::swap(ta, tb);
+      }
+      t0 = std::max(t0, ta);
+      t1 = std::min(t1, tb);
+      if (t0 > t1) {
+        continue;
+      }
+    } else if (a.y < band_lo || a.y > band_hi) {
+      continue;
+    }
+    const double xa = a.x + t0 * dx, xb = a.x + t1 * dx;
+    const int col_begin = std::max(0, column_of(std::min(xa, xb) - margin));
+    const int col_end = std::min(nx - 1, column_of(std::max(xa, xb) + margin));
+    for (int col = col_begin; col <= col_end; ++col) {
+      f(row * nx + col);
+    }
+  }
+}
+
+template <typename F>
+void CircleGrid::for_each_circle_near(const Trajectory &trajectory,
+                                      const double tolerance, F &&f) const {
+  const auto &points = trajectory.points;
+  // Only widens the walk against rounding, the check itself is exact.
+  const double margin = std::max(tolerance, 0.0) + 1e-9 * cell_size;
+  auto check_cells = [&](const Point &a, const Point &b, unsigned segment,
+                         auto &&distance) {
+    for_each_cell_near(a, b, margin, [&](int cell) {
+      for (auto k = cell_begin[cell]; k < cell_begin[cell + 1]; ++k) {
+        f(cell_circles[k], segment, distance);
+      }
+    });
+  };
+  // The distances are computed as in `Trajectory::distance`.
+  if (points.size() == 1) {
+    check_cells(points[0], points[0], 0,
+                [&](const Point &c) { return points[0].dist(c); });
+    return;
+  }
+  for (size_t j = 0; j + 1 < points.size(); ++j) {
+    const auto &a = points[j];
+    const auto &b = points[j + 1];
+    check_cells(a, b, j, [&](const Point &c) {
+      return utils::distance_to_segment({a.x, a.y}, {b.x, b.y}, {c.x, c.y});
+    });
+  }
+}
+
+void CircleGrid::mark_covered(const Trajectory &trajectory,
+                              const double tolerance,
+                              char *covered) const {
+  for_each_circle_near(trajectory, tolerance,
+                       [&](unsigned i, unsigned, auto &&distance) {
+    if (!covered[i] && distance(Point{x[i], y[i]}) - r[i] <= tolerance) {
+      covered[i] = 1;
+    }
+  });
+}
+
+std::vector<CircleGrid::Coverage>
+CircleGrid::compute_coverage(const Trajectory &trajectory,
+                             const double tolerance) const {
+  std::vector<Coverage> coverage;
+  // A circle is in multiple cells, but the segments come in order.
+  std::vector<unsigned> last_segment(size(),
+                                     std::numeric_limits<unsigned>::max());
+  for_each_circle_near(trajectory, tolerance,
+                       [&](unsigned i, unsigned segment, auto &&distance) {
+    if (last_segment[i] == segment) {
+      return;
+    }
+    const double d = distance(Point{x[i], y[i]}) - r[i];
+    if (d <= tolerance) {
+      last_segment[i] = segment;
+      coverage.push_back({i, segment, d});
+    }
+  });
+  return coverage;
+}
+
+void CircleGrid::compute_distances(const Trajectory &trajectory,
+                                   const size_t begin, const size_t end,
+                                   double *out) const {
+  assert(begin <= end && end <= size());
+  std::vector<double> px, py;
+  split_coordinates(trajectory, px, py);
+  utils::distances_to_polyline(x.data() + begin, y.data() + begin,
+                               r.data() + begin, end - begin, px.data(),
+                               py.data(), px.size(), out);
+}
+
+void CircleGrid::split_coordinates(const Trajectory &trajectory,
+                                   std::vector<double> &px,
+                                   std::vector<double> &py) {
+  px.reserve(trajectory.points.size());
+  py.reserve(trajectory.points.size());
+  for (const auto &p : trajectory.points) {
+    px.push_back(p.x);
+    py.push_back(p.y);
+  }
+}
+
+std::optional<std::pair<int, double>>
+CircleGrid::farthest(const Trajectory &trajectory,
+                     const std::vector<char> &excluded) const {
+  std::optional<std::pair<int, double>> best;
+  if (size() == 0) {
+    return best;
+  }
+  std::vector<double> px, py;
+  split_coordinates(trajectory, px, py);
+  // The candidates are gathered, such that their distances can be computed
+  // with the vectorized kernel.
+  std::vector<unsigned> candidates;
+  std::vector<double> cx, cy, cr, distances;
+  // Covers the rounding of the kernel.
+  const double slack = 1e-9 * cell_size;
+  auto evaluate = [&]() {
+    const auto k = candidates.size();
+    distances.resize(k);
+    utils::distances_to_polyline(cx.data(), cy.data(), cr.data(), k,
+                                 px.data(), py.data(), px.size(),
+                                 distances.data());
+  };
+  auto consider_cell = [&](const int cell) {
+    candidates.clear();
+    cx.clear();
+    cy.clear();
+    cr.clear();
+    for (auto k = center_begin[cell]; k < center_begin[cell + 1]; ++k) {
+      const auto i = center_circles[k];
+      if (!excluded[i]) {
+        candidates.push_back(i);
+        cx.push_back(x[i]);
+        cy.push_back(y[i]);
+        cr.push_back(r[i]);
+      }
+    }
+    evaluate();
+    for (size_t j = 0; j < candidates.size(); ++j) {
+      // The kernel may round differently than `Trajectory::distance` and
+      // flip near-ties. It only filters the candidates, the remaining ones
+      // are compared by their distance as in `Trajectory::distance`.
+      if (best && distances[j] + slack < best->second) {
+        continue;
+      }
+      const auto i = static_cast<int>(candidates[j]);
+      const double d = trajectory.distance(Circle(Point{x[i], y[i]}, r[i]));
+      if (!best || d > best->second || (d == best->second && i < best->first)) {
+        best = {i, d};
+      }
+    }
+  };
+  // Every point of a block's box is within half of its diagonal to the
+  // center of the box.
+  struct Entry {
+    double bound;
+    int level;
+    int index;
+    bool operator<(const Entry &other) const { return bound < other.bound; }
+  };
+  std::priority_queue<Entry> queue;
+  auto push_blocks = [&](const int level, const std::vector<int> &blocks) {
+    candidates.assign(blocks.begin(), blocks.end());
+    cx.clear();
+    cy.clear();
+    cr.assign(blocks.size(), 0.0);
+    for (const auto b : blocks) {
+      const auto &block = pyramid[level][b];
+      cx.push_back(0.5 * (block.x0 + block.x1));
+      cy.push_back(0.5 * (block.y0 + block.y1));
+    }
+    evaluate();
+    for (size_t j = 0; j < blocks.size(); ++j) {
+      const auto &block = pyramid[level][blocks[j]];
+      const double half_diagonal =
+          0.5 * std::hypot(block.x1 - block.x0, block.y1 - block.y0);
+      queue.push({distances[j] + half_diagonal - block.min_radius + slack,
+                  level, blocks[j]});
+    }
+  };
+  push_blocks(static_cast<int>(pyramid.size()) - 1, {0});
+  std::vector<int> children;
+  while (!queue.empty()) {
+    const auto entry = queue.top();
+    queue.pop();
+    if (best && entry.bound < best->second) {
+      break; // no remaining block can contain a farther circle
+    }
+    if (entry.level == 0) {
+      consider_cell(entry.index);
+      continue;
+    }
+    // The up to 2x2 non-empty blocks of the level below.
+    const int level = entry.level - 1;
+    const int width = pyramid_width[level];
+    const int height = static_cast<int>(pyramid[level].size()) / width;
+    const int row = entry.index / pyramid_width[entry.level] * 2;
+    const int col = entry.index % pyramid_width[entry.level] * 2;
+    children.clear();
+    for (int rr = row; rr < std::min(row + 2, height); ++rr) {
+      for (int c = col; c < std::min(col + 2, width); ++c) {
+        const auto &block = pyramid[level][rr * width + c];
+        if (block.x0 <= block.x1) {
+          children.push_back(rr * width + c);
+        }
+      }
+    }
+    push_blocks(level, children);
+  }
+  return best;
+}
+} // namespace details
+
+std::shared_ptr<const details::CircleGrid> Instance::get_circle_grid() const {
+  // Concurrent calls may both build the grid, which is harmless.
+  auto grid = std::atomic_load(&circle_grid);
+  if (!grid || grid->size() != size()) {
+    std::vector<Point> extra_points;
+    if (path) {
+      extra_points = {path->first, path->second};
+    }
+    grid = std::make_shared<const details::CircleGrid>(*this, extra_points);
+    std::atomic_store(&circle_grid, grid);
+  }
+  return grid;
+}
+} // namespace cetsp
@@ -2,8 +2,16 @@
 // Created by Dominik Krupke on 15.01.23.
 //
 #include "cetsp/utils/geometry.h"
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <limits>
 #include <utility>
+#include <vector>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CETSP_X86_KERNELS
+#include <immintrin.h>
+#endif
 namespace cetsp::utils {
 double distance_to_segment(std::pair<double, double> A,
                            std::pair<double, double> B,
@@ -61,8 +69,206 @@ double distance_to_segment(std::pair<double, double> A,
     double x2 = AE.first;
     double y2 = AE.second;
     double mod = sqrt(x1 * x1 + y1 * y1);
+    if (mod == 0) {
+      // A and B are identical
+      return sqrt(x2 * x2 + y2 * y2);
+    }
     reqAns = abs(x1 * y2 - y1 * x2) / mod;
   }
   return reqAns;
 }
+
+namespace {
+/**
+ * The segments of the polyline, prepared for projecting the centers onto
+ * them without branches. A single point is a segment of length zero.
+ */
+struct Segments {
+  // Keeps the capacity, such that a reused instance does not allocate.
+  void assign(const double *px, const double *py, const size_t m) {
+    for (auto *v : {&ax, &ay, &dx, &dy, &inv_length2}) {
+      v->clear();
+    }
+    const size_t k = m > 1 ? m - 1 : m;
+    ax.reserve(k);
+    ay.reserve(k);
+    dx.reserve(k);
+    dy.reserve(k);
+    inv_length2.reserve(k);
+    for (size_t j = 0; j < k; ++j) {
+      const size_t next = std::min(j + 1, m - 1);
+      ax.push_back(px[j]);
+      ay.push_back(py[j]);
+      dx.push_back(px[next] - px[j]);
+      dy.push_back(py[next] - py[j]);
+      const double length2 = dx.back() * dx.back() + dy.back() * dy.back();
+      inv_length2.push_back(length2 > 0 ? 1.0 / length2 : 0.0);
+    }
+  }
+
+  [[nodiscard]] size_t size() const { return ax.size(); }
+
+  std::vector<double> ax, ay, dx, dy, inv_length2;
+};
+
+// All kernels use the same operations in the same order, such that they give
+// the same results. t is the clamped position of the projection of the center
+// onto the segment.
+void scalar_kernel(const double *x, const double *y, const double *r,
+                   const size_t begin, const size_t end, const Segments &s,
+                   double *out) {
+  for (size_t i = begin; i < end; ++i) {
+    double best = std::numeric_limits<double>::infinity();
+    for (size_t k = 0; k < s.size(); ++k) {
+      const double wx = x[i] - s.ax[k];
+      const double wy = y[i] - s.ay[k];
+      double t = (wx * s.dx[k] + wy * s.dy[k]) * s.inv_length2[k];
+      t = std::min(std::max(t, 0.0), 1.0);
+      const double ex = wx - t * s.dx[k];
+      const double ey = wy - t * s.dy[k];
+      best = std::min(best, ex * ex + ey * ey);
+    }
+    out[i] = std::sqrt(best) - r[i];
+  }
+}
+
+#ifdef CETSP_X86_KERNELS
+__attribute__((target("avx2"))) void
+avx2_kernel(const double *x, const double *y, const double *r, const size_t n,
+            const Segments &s, double *out) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d cx = _mm256_loadu_pd(x + i);
+    const __m256d cy = _mm256_loadu_pd(y + i);
+    __m256d best = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    for (size_t k = 0; k < s.size(); ++k) {
+      const __m256d dx = _mm256_set1_pd(s.dx[k]);
+      const __m256d dy = _mm256_set1_pd(s.dy[k]);
+      const __m256d wx = _mm256_sub_pd(cx, _mm256_set1_pd(s.ax[k]));
+      const __m256d wy = _mm256_sub_pd(cy, _mm256_set1_pd(s.ay[k]));
+      __m256d t = _mm256_mul_pd(
+          _mm256_add_pd(_mm256_mul_pd(wx, dx), _mm256_mul_pd(wy, dy)),
+          _mm256_set1_pd(s.inv_length2[k]));
+      t = _mm256_min_pd(_mm256_max_pd(t, zero), one);
+      const __m256d ex = _mm256_sub_pd(wx, _mm256_mul_pd(t, dx));
+      const __m256d ey = _mm256_sub_pd(wy, _mm256_mul_pd(t, dy));
+      best = _mm256_min_pd(
+          best, _mm256_add_pd(_mm256_mul_pd(ex, ex), _mm256_mul_pd(ey, ey)));
+    }
+    _mm256_storeu_pd(out + i,
+                     _mm256_sub_pd(_mm256_sqrt_pd(best), _mm256_loadu_pd(r + i)));
+  }
+  scalar_kernel(x, y, r, i, n, s, out);
+}
+
+// GCC warns about the undefined source operand that the AVX-512 intrinsics
+// pass for the unused masked-out lanes.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+__attribute__((target("avx512f"))) void
+avx512_kernel(const double *x, const double *y, const double *r,
+              const size_t n, const Segments &s, double *out) {
+  const __m512d zero = _mm512_setzero_pd();
+  const __m512d one = _mm512_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m512d cx = _mm512_loadu_pd(x + i);
+    const __m512d cy = _mm512_loadu_pd(y + i);
+    __m512d best = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    for (size_t k = 0; k < s.size(); ++k) {
+      const __m512d dx = _mm512_set1_pd(s.dx[k]);
+      const __m512d dy = _mm512_set1_pd(s.dy[k]);
+      const __m512d wx = _mm512_sub_pd(cx, _mm512_set1_pd(s.ax[k]));
+      const __m512d wy = _mm512_sub_pd(cy, _mm512_set1_pd(s.ay[k]));
+      __m512d t = _mm512_mul_pd(
+          _mm512_add_pd(_mm512_mul_pd(wx, dx), _mm512_mul_pd(wy, dy)),
+          _mm512_set1_pd(s.inv_length2[k]));
+      t = _mm512_min_pd(_mm512_max_pd(t, zero), one);
+      const __m512d ex = _mm512_sub_pd(wx, _mm512_mul_pd(t, dx));
+      const __m512d ey = _mm512_sub_pd(wy, _mm512_mul_pd(t, dy));
+      best = _mm512_min_pd(
+          best, _mm512_add_pd(_mm512_mul_pd(ex, ex), _mm512_mul_pd(ey, ey)));
+    }
+    _mm512_storeu_pd(out + i,
+                     _mm512_sub_pd(_mm512_sqrt_pd(best), _mm512_loadu_pd(r + i)));
+  }
+  scalar_kernel(x, y, r, i, n, s, out);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+DistanceKernel detect_distance_kernel() {
+#ifdef CETSP_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return DistanceKernel::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return DistanceKernel::AVX2;
+  }
+#endif
+  return DistanceKernel::SCALAR;
+}
+} // namespace
+
+DistanceKernel get_distance_kernel() {
+  static const DistanceKernel kernel = detect_distance_kernel();
+  return kernel;
+}
+
+bool is_supported(const DistanceKernel kernel) {
+  switch (kernel) {
+  case DistanceKernel::AVX512:
+    return get_distance_kernel() == DistanceKernel::AVX512;
+  case DistanceKernel::AVX2:
+    return get_distance_kernel() != DistanceKernel::SCALAR;
+  default:
+    return true;
+  }
+}
+
+const char *get_name(const DistanceKernel kernel) {
+  switch (kernel) {
+  case DistanceKernel::AVX512:
+    return "AVX-512";
+  case DistanceKernel::AVX2:
+    return "AVX2";
+  default:
+    return "scalar";
+  }
+}
+
+void distances_to_polyline(const double *x, const double *y, const double *r,
+                           const size_t n, const double *px, const double *py,
+                           const size_t m, double *out) {
+  distances_to_polyline(x, y, r, n, px, py, m, out, get_distance_kernel());
+}
+
+void distances_to_polyline(const double *x, const double *y, const double *r,
+                           const size_t n, const double *px, const double *py,
+                           const size_t m, double *out,
+                           const DistanceKernel kernel) {
+  assert(is_supported(kernel));
+  // Reused, as `CircleGrid::farthest` calls this for every refined block.
+  thread_local Segments segments;
+  segments.assign(px, py, m);
+  switch (kernel) {
+#ifdef CETSP_X86_KERNELS
+  case DistanceKernel::AVX512:
+    avx512_kernel(x, y, r, n, segments, out);
+    break;
+  case DistanceKernel::AVX2:
+    avx2_kernel(x, y, r, n, segments, out);
+    break;
+#endif
+  default:
+    scalar_kernel(x, y, r, 0, n, segments, out);
+  }
+}
 } // namespace cetsp::utils
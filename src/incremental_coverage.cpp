@@ -0,0 +1,194 @@
+#include "cetsp/details/incremental_coverage.h"
+#include "cetsp/utils/geometry.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace cetsp::details {
+namespace {
+using Segment = std::array<double, 4>; // ax, ay, bx, by
+
+/**
+ * The segments in the order of `CircleGrid::compute_coverage`. A
+ * single point is a segment of length zero.
+ */
+std::vector<Segment> get_segments(const Trajectory &trajectory) {
+  const auto &points = trajectory.points;
+  std::vector<Segment> segments;
+  if (points.size() == 1) {
+    segments.push_back({points[0].x, points[0].y, points[0].x, points[0].y});
+  }
+  for (size_t j = 0; j + 1 < points.size(); ++j) {
+    segments.push_back(
+        {points[j].x, points[j].y, points[j + 1].x, points[j + 1].y});
+  }
+  return segments;
+}
+
+double distance(const Segment &s, const double x, const double y) {
+  return utils::distance_to_segment({s[0], s[1]}, {s[2], s[3]}, {x, y});
+}
+} // namespace
+
+ParentCoverage::ParentCoverage(const Instance &instance, Trajectory trajectory,
+                               const double tolerance)
+    : instance{&instance}, trajectory{std::move(trajectory)},
+      tolerance{tolerance} {}
+
+const std::vector<CircleGrid::Coverage> &ParentCoverage::get_coverage() const {
+  std::call_once(compute_once, [&]() {
+    const auto grid = instance->get_circle_grid();
+    coverage = grid->compute_coverage(trajectory, tolerance);
+    num_circles = grid->size();
+    std::stable_sort(
+        coverage.begin(), coverage.end(),
+        [](const auto &a, const auto &b) { return a.circle < b.circle; });
+    computed = true;
+  });
+  return coverage;
+}
+
+std::optional<TrajectoryChange>
+compare_trajectories(const Trajectory &parent, const Trajectory &child,
+                     const size_t max_comparisons) {
+  const auto parent_segments = get_segments(parent);
+  const auto child_segments = get_segments(child);
+  TrajectoryChange change;
+  change.changed.assign(child_segments.size(), 1);
+  change.displacement.assign(parent_segments.size(),
+                             std::numeric_limits<double>::infinity());
+  // The distance of a single point is computed differently, so it is never
+  // considered to be unchanged.
+  if (parent.points.size() > 1 && child.points.size() > 1) {
+    const auto &p = parent.points;
+    const auto &c = child.points;
+    // Usually, the points before and after the insertion are the parent's.
+    const auto n = std::min(p.size(), c.size());
+    size_t prefix = 0;
+    while (prefix < n && p[prefix] == c[prefix]) {
+      ++prefix;
+    }
+    size_t suffix = 0;
+    while (prefix + suffix < n &&
+           p[p.size() - 1 - suffix] == c[c.size() - 1 - suffix]) {
+      ++suffix;
+    }
+    for (size_t j = 0; j + 1 < prefix; ++j) {
+      change.changed[j] = 0;
+      change.displacement[j] = 0.0;
+    }
+    for (size_t k = 0; k + 1 < suffix; ++k) {
+      change.changed[child_segments.size() - 1 - k] = 0;
+      change.displacement[parent_segments.size() - 1 - k] = 0.0;
+    }
+    // The other segments are matched by their end points, e.g., if the
+    // change wraps around the beginning of a tour.
+    std::vector<std::pair<Segment, unsigned>> sorted;
+    sorted.reserve(parent_segments.size());
+    for (unsigned j = 0; j < parent_segments.size(); ++j) {
+      if (change.displacement[j] != 0.0) {
+        sorted.emplace_back(parent_segments[j], j);
+      }
+    }
+    std::sort(sorted.begin(), sorted.end());
+    auto by_segment = [](const auto &a, const auto &b) {
+      return a.first < b.first;
+    };
+    for (size_t j = 0; j < child_segments.size(); ++j) {
+      if (!change.changed[j]) {
+        continue;
+      }
+      const auto range =
+          std::equal_range(sorted.begin(), sorted.end(),
+                           std::make_pair(child_segments[j], 0u), by_segment);
+      if (range.first != range.second) {
+        change.changed[j] = 0;
+        for (auto it = range.first; it != range.second; ++it) {
+          change.displacement[it->second] = 0.0;
+        }
+      }
+    }
+  }
+  std::vector<size_t> replaced, changed;
+  replaced.reserve(parent_segments.size());
+  changed.reserve(child_segments.size());
+  for (size_t j = 0; j < parent_segments.size(); ++j) {
+    if (change.displacement[j] != 0.0) {
+      replaced.push_back(j);
+    }
+  }
+  for (size_t j = 0; j < child_segments.size(); ++j) {
+    if (change.changed[j]) {
+      changed.push_back(j);
+    }
+  }
+  if (replaced.size() * changed.size() > max_comparisons) {
+    return {};
+  }
+  // The displacements get a slack for the rounding, such that only the
+  // unchanged segments have the displacement zero.
+  double scale = 1.0;
+  for (const auto *trajectory : {&parent, &child}) {
+    for (const auto &q : trajectory->points) {
+      scale = std::max({scale, std::abs(q.x), std::abs(q.y)});
+    }
+  }
+  const double slack = 1e-12 * scale;
+  // The distance to a segment is convex, so the farthest point of a segment
+  // to another segment is one of its end points.
+  for (auto j : replaced) {
+    const auto &s = parent_segments[j];
+    for (auto k : changed) {
+      const auto &t = child_segments[k];
+      change.displacement[j] = std::min(
+          change.displacement[j],
+          std::max(distance(t, s[0], s[1]), distance(t, s[2], s[3])) + slack);
+    }
+  }
+  return change;
+}
+
+void mark_covered_incrementally(const Instance &instance,
+                                const ParentCoverage &parent,
+                                const Trajectory &child, char *covered) {
+  const auto grid = instance.get_circle_grid();
+  const double tolerance = parent.get_tolerance();
+  // Comparing the segments should not become more expensive than the check
+  // of the whole trajectory.
+  const auto change =
+      compare_trajectories(parent.get_trajectory(), child, instance.size());
+  if (!change || child.points.size() < 2) {
+    grid->mark_covered(child, tolerance, covered);
+    return;
+  }
+  const auto &coverage = parent.get_coverage();
+  if (parent.get_num_circles() != grid->size()) {
+    // circles have been added, which are missing in the parent's coverage
+    grid->mark_covered(child, tolerance, covered);
+    return;
+  }
+  for (const auto &entry : coverage) {
+    if (!covered[entry.circle] &&
+        entry.distance + change->displacement[entry.segment] <= tolerance) {
+      covered[entry.circle] = 1;
+    }
+  }
+  // The other circles can only be covered by the changed segments.
+  const auto &points = child.points;
+  for (size_t j = 0; j < change->changed.size();) {
+    if (!change->changed[j]) {
+      ++j;
+      continue;
+    }
+    const auto begin = j;
+    while (j < change->changed.size() && change->changed[j]) {
+      ++j;
+    }
+    grid->mark_covered(
+        Trajectory({points.begin() + begin, points.begin() + j + 1}),
+        tolerance, covered);
+  }
+}
+} // namespace cetsp::details
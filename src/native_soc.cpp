@@ -0,0 +1,642 @@
+/**
+ * A specialized interior point solver for the trajectory through a fixed
+ * sequence of circles. It does not need any external solver.
+ *
+ * We minimize sum_i f_i subject to f_i >= ||p_i - p_{i-1}|| and
+ * ||p_i - c_i|| <= r_i with a classical barrier method. The variables of
+ * a circle (x_i, y_i, f_i) only interact with the variables of its
+ * predecessor and successor, such that the Newton system is block tridiagonal
+ * with 3x3 blocks, plus a border for the segment closing the tour. We move
+ * the last block into the border and solve the remaining block tridiagonal
+ * system with a block Thomas algorithm, such that every Newton step only
+ * takes O(n).
+ */
+#include "cetsp/common.h"
+#include "cetsp/soc.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace cetsp {
+namespace {
+using Mat3 = std::array<double, 9>; // row major
+using Vec3 = std::array<double, 3>;
+using Mat34 = std::array<double, 12>; // row major, the 4th column is the rhs
+
+Mat3 transposed(const Mat3 &a) {
+  return {a[0], a[3], a[6], a[1], a[4], a[7], a[2], a[5], a[8]};
+}
+
+Mat3 inverse(const Mat3 &a) {
+  // via the adjugate. The blocks are positive definite.
+  Mat3 inv{a[4] * a[8] - a[5] * a[7], a[2] * a[7] - a[1] * a[8],
+           a[1] * a[5] - a[2] * a[4], a[5] * a[6] - a[3] * a[8],
+           a[0] * a[8] - a[2] * a[6], a[2] * a[3] - a[0] * a[5],
+           a[3] * a[7] - a[4] * a[6], a[1] * a[6] - a[0] * a[7],
+           a[0] * a[4] - a[1] * a[3]};
+  const double det = a[0] * inv[0] + a[1] * inv[3] + a[2] * inv[6];
+  for (auto &v : inv) {
+    v /= det;
+  }
+  return inv;
+}
+
+Mat3 multiply(const Mat3 &a, const Mat3 &b) {
+  Mat3 c{};
+  for (int i = 0; i < 3; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      for (int j = 0; j < 3; ++j) {
+        c[3 * i + j] += a[3 * i + k] * b[3 * k + j];
+      }
+    }
+  }
+  return c;
+}
+
+Mat34 multiply(const Mat3 &a, const Mat34 &b) {
+  Mat34 c{};
+  for (int i = 0; i < 3; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      for (int j = 0; j < 4; ++j) {
+        c[4 * i + j] += a[3 * i + k] * b[4 * k + j];
+      }
+    }
+  }
+  return c;
+}
+
+/**
+ * The barrier method on the normalized problem. The circles are translated
+ * and scaled, such that the tolerances are independent of the coordinates.
+ * The workspace can be reused for further problems via `setup`, which avoids
+ * the allocations for batches.
+ */
+class BarrierTrajectorySolver {
+public:
+  explicit BarrierTrajectorySolver(const double tolerance)
+      : tolerance{tolerance} {}
+
+  void setup(const std::vector<Circle> &circle_sequence, const bool path_) {
+    n = static_cast<int>(circle_sequence.size());
+    path = path_;
+    barrier_parameter = 0.0;
+    normalize(circle_sequence);
+    // Circles without radius are just fixed points.
+    fixed.assign(3 * n, false);
+    for (int i = 0; i < n; ++i) {
+      if (r[i] <= 0) {
+        fixed[3 * i] = true;
+        fixed[3 * i + 1] = true;
+      }
+    }
+    if (path) {
+      fixed[2] = true; // there is no segment into the first circle
+    }
+    // Start in the circle centers, which is strictly feasible.
+    z.assign(3 * n, 0.0);
+    for (int i = 0; i < n; ++i) {
+      z[3 * i] = cx[i];
+      z[3 * i + 1] = cy[i];
+    }
+    for (int i = 0; i < n; ++i) {
+      if (has_segment(i)) {
+        z[3 * i + 2] = segment_length(z, i) + 1.0;
+        barrier_parameter += 2;
+      }
+      if (!fixed[3 * i]) {
+        barrier_parameter += 2;
+      }
+    }
+    diag.resize(n);
+    upper.resize(n);
+    border.resize(n);
+    grad.resize(n);
+    pivot_inverse.resize(n);
+    reduced.resize(n);
+    step.assign(3 * n, 0.0);
+    candidate.resize(3 * n);
+  }
+
+  void optimize() {
+    optimize({}, std::numeric_limits<double>::infinity());
+  }
+
+  /**
+   * Like `optimize`, but stops as soon as the trajectory is proved to be
+   * longer than the cutoff. The dual bound of the current hitting points is
+   * valid at any time and only takes linear time, like a Newton step.
+   * @return The certified lower bound if it stopped early.
+   */
+  std::optional<double> optimize(const std::vector<Circle> &circle_sequence,
+                                 const double cutoff) {
+    if (n <= 1) {
+      return {}; // The center is optimal.
+    }
+    double t = 1.0;
+    for (int outer = 0; outer < MAX_OUTER_ITERATIONS; ++outer) {
+      center(t);
+      if (barrier_parameter / t <= tolerance) {
+        break;
+      }
+      if (cutoff < std::numeric_limits<double>::infinity()) {
+        const double lb = get_lower_bound(circle_sequence);
+        if (lb > cutoff) {
+          return lb;
+        }
+      }
+      t *= MU;
+    }
+    return {};
+  }
+
+  std::pair<Trajectory, std::vector<bool>>
+  get_solution(const std::vector<Circle> &circle_sequence) const {
+    constexpr auto SPANNING_TOLERANCE = 0.01;
+    std::vector<Point> points = get_hitting_points(circle_sequence);
+    points.reserve(n + 1);
+    std::vector<bool> spanning_circles(n);
+    for (int i = 0; i < n; ++i) {
+      const double dx = z[3 * i] - cx[i];
+      const double dy = z[3 * i + 1] - cy[i];
+      spanning_circles[i] =
+          std::sqrt(dx * dx + dy * dy) >= (1 - SPANNING_TOLERANCE) * r[i];
+    }
+    if (!path) {
+      points.push_back(points[0]);
+    }
+    return {Trajectory(points), spanning_circles};
+  }
+
+  /**
+   * The certified lower bound for the current hitting points.
+   */
+  [[nodiscard]] double
+  get_lower_bound(const std::vector<Circle> &circle_sequence) const {
+    return compute_trajectory_lower_bound(
+        circle_sequence, get_hitting_points(circle_sequence), path);
+  }
+
+private:
+  [[nodiscard]] std::vector<Point>
+  get_hitting_points(const std::vector<Circle> &circle_sequence) const {
+    std::vector<Point> points;
+    points.reserve(n);
+    for (int i = 0; i < n; ++i) {
+      if (fixed[3 * i]) {
+        points.push_back(circle_sequence[i].center);
+      } else {
+        points.emplace_back(offset_x + scale * z[3 * i],
+                            offset_y + scale * z[3 * i + 1]);
+      }
+    }
+    return points;
+  }
+
+  void normalize(const std::vector<Circle> &circle_sequence) {
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = min_x;
+    double max_x = -min_x;
+    double max_y = -min_x;
+    double max_r = 0.0;
+    for (const auto &c : circle_sequence) {
+      min_x = std::min(min_x, c.center.x);
+      min_y = std::min(min_y, c.center.y);
+      max_x = std::max(max_x, c.center.x);
+      max_y = std::max(max_y, c.center.y);
+      max_r = std::max(max_r, c.radius);
+    }
+    offset_x = 0.5 * (min_x + max_x);
+    offset_y = 0.5 * (min_y + max_y);
+    scale = std::max({max_x - min_x, max_y - min_y, max_r});
+    if (!(scale > 0)) {
+      scale = 1.0;
+    }
+    cx.clear();
+    cy.clear();
+    r.clear();
+    for (const auto &c : circle_sequence) {
+      cx.push_back((c.center.x - offset_x) / scale);
+      cy.push_back((c.center.y - offset_y) / scale);
+      r.push_back(c.radius / scale);
+    }
+  }
+
+  [[nodiscard]] bool has_segment(const int i) const { return !path || i > 0; }
+
+  [[nodiscard]] int prev(const int i) const { return i == 0 ? n - 1 : i - 1; }
+
+  [[nodiscard]] double segment_length(const std::vector<double> &v,
+                                      const int i) const {
+    const int j = prev(i);
+    return std::hypot(v[3 * i] - v[3 * j], v[3 * i + 1] - v[3 * j + 1]);
+  }
+
+  /**
+   * The change of the barrier function when moving from `z` to `v` or infinity
+   * if `v` is not strictly feasible. Computing the change directly, with
+   * the ratios inside the logarithms, keeps it accurate for large t, where
+   * the value itself is dominated by t times the length.
+   */
+  double barrier_change(const std::vector<double> &v, const double t) const {
+    double change = 0.0;
+    for (int i = 0; i < n; ++i) {
+      if (has_segment(i)) {
+        const double fi = v[3 * i + 2];
+        const double g = cone_slack(v, i);
+        if (fi <= 0 || g <= 0) {
+          return std::numeric_limits<double>::infinity();
+        }
+        change += t * (fi - z[3 * i + 2]) - std::log(g / cone_slack(z, i));
+      }
+      if (!fixed[3 * i]) {
+        const double h = disk_slack(v, i);
+        if (h <= 0) {
+          return std::numeric_limits<double>::infinity();
+        }
+        change -= std::log(h / disk_slack(z, i));
+      }
+    }
+    return change;
+  }
+
+  [[nodiscard]] double cone_slack(const std::vector<double> &v,
+                                  const int i) const {
+    const int j = prev(i);
+    const double dx = v[3 * i] - v[3 * j];
+    const double dy = v[3 * i + 1] - v[3 * j + 1];
+    return v[3 * i + 2] * v[3 * i + 2] - dx * dx - dy * dy;
+  }
+
+  [[nodiscard]] double disk_slack(const std::vector<double> &v,
+                                  const int i) const {
+    const double qx = v[3 * i] - cx[i];
+    const double qy = v[3 * i + 1] - cy[i];
+    return r[i] * r[i] - qx * qx - qy * qy;
+  }
+
+  void add_to_diag(const int k, const Mat3 &m) {
+    for (int a = 0; a < 3; ++a) {
+      for (int b = 0; b < 3; ++b) {
+        if (!fixed[3 * k + a] && !fixed[3 * k + b]) {
+          diag[k][3 * a + b] += m[3 * a + b];
+        }
+      }
+    }
+  }
+
+  /**
+   * Adds the coupling between the variables of block `a` (rows) and block
+   * `b` (columns). The symmetric part is implicit.
+   */
+  void add_coupling(const int a, const int b, Mat3 m) {
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        if (fixed[3 * a + i] || fixed[3 * b + j]) {
+          m[3 * i + j] = 0.0;
+        }
+      }
+    }
+    const int last = n - 1;
+    if (b == last) {
+      add(border[a], m);
+    } else if (a == last) {
+      add(border[b], transposed(m));
+    } else if (b == a + 1) {
+      add(upper[a], m);
+    } else {
+      assert(a == b + 1);
+      add(upper[b], transposed(m));
+    }
+  }
+
+  static void add(Mat3 &target, const Mat3 &m) {
+    for (int i = 0; i < 9; ++i) {
+      target[i] += m[i];
+    }
+  }
+
+  void assemble(const double t) {
+    std::fill(diag.begin(), diag.end(), Mat3{});
+    std::fill(upper.begin(), upper.end(), Mat3{});
+    std::fill(border.begin(), border.end(), Mat3{});
+    std::fill(grad.begin(), grad.end(), Vec3{});
+    for (int i = 0; i < n; ++i) {
+      if (has_segment(i)) {
+        // -log(f^2 - ||d||^2) with d = p_i - p_j
+        const int j = prev(i);
+        const double dx = z[3 * i] - z[3 * j];
+        const double dy = z[3 * i + 1] - z[3 * j + 1];
+        const double fi = z[3 * i + 2];
+        const double g = fi * fi - dx * dx - dy * dy;
+        const double g2 = g * g;
+        const Mat3 h_dd{4 * dx * dx / g2 + 2 / g, 4 * dx * dy / g2, 0.0,
+                        4 * dx * dy / g2, 4 * dy * dy / g2 + 2 / g, 0.0,
+                        0.0, 0.0, 0.0};
+        const double h_dfx = -4 * fi * dx / g2;
+        const double h_dfy = -4 * fi * dy / g2;
+        const double h_ff = 4 * fi * fi / g2 - 2 / g;
+        Mat3 own = h_dd;
+        own[2] = h_dfx;
+        own[5] = h_dfy;
+        own[6] = h_dfx;
+        own[7] = h_dfy;
+        own[8] = h_ff;
+        add_to_diag(i, own);
+        add_to_diag(j, h_dd);
+        const Mat3 coupling{-h_dd[0], -h_dd[1], -h_dfx, -h_dd[3], -h_dd[4],
+                            -h_dfy,   0.0,      0.0,    0.0};
+        add_coupling(j, i, coupling);
+        grad[i][0] += 2 * dx / g;
+        grad[i][1] += 2 * dy / g;
+        grad[i][2] += t - 2 * fi / g;
+        grad[j][0] -= 2 * dx / g;
+        grad[j][1] -= 2 * dy / g;
+      }
+      if (!fixed[3 * i]) {
+        // -log(r^2 - ||p_i - c_i||^2)
+        const double qx = z[3 * i] - cx[i];
+        const double qy = z[3 * i + 1] - cy[i];
+        const double h = r[i] * r[i] - qx * qx - qy * qy;
+        const double h2 = h * h;
+        add_to_diag(i, {4 * qx * qx / h2 + 2 / h, 4 * qx * qy / h2, 0.0,
+                        4 * qx * qy / h2, 4 * qy * qy / h2 + 2 / h, 0.0, 0.0,
+                        0.0, 0.0});
+        grad[i][0] += 2 * qx / h;
+        grad[i][1] += 2 * qy / h;
+      }
+    }
+    for (int k = 0; k < n; ++k) {
+      for (int a = 0; a < 3; ++a) {
+        if (fixed[3 * k + a]) {
+          diag[k][4 * a] = 1.0;
+          grad[k][a] = 0.0;
+        }
+      }
+    }
+  }
+
+  /**
+   * Solves the Newton system for `step`. The blocks 0..n-2 form a block
+   * tridiagonal matrix, the last block is the border.
+   */
+  void solve_newton_system() {
+    const int m = n - 1;
+    for (int k = 0; k < m; ++k) {
+      auto &rhs = reduced[k];
+      for (int a = 0; a < 3; ++a) {
+        for (int b = 0; b < 3; ++b) {
+          rhs[4 * a + b] = border[k][3 * a + b];
+        }
+        rhs[4 * a + 3] = -grad[k][a];
+      }
+    }
+    // forward elimination
+    pivot_inverse[0] = inverse(diag[0]);
+    for (int k = 1; k < m; ++k) {
+      const auto w = multiply(transposed(upper[k - 1]), pivot_inverse[k - 1]);
+      const auto wu = multiply(w, upper[k - 1]);
+      Mat3 pivot = diag[k];
+      for (int i = 0; i < 9; ++i) {
+        pivot[i] -= wu[i];
+      }
+      pivot_inverse[k] = inverse(pivot);
+      const auto wr = multiply(w, reduced[k - 1]);
+      for (int i = 0; i < 12; ++i) {
+        reduced[k][i] -= wr[i];
+      }
+    }
+    // back substitution, `reduced` becomes the solution X = T^{-1}[E|b]
+    reduced[m - 1] = multiply(pivot_inverse[m - 1], reduced[m - 1]);
+    for (int k = m - 2; k >= 0; --k) {
+      Mat34 rhs = reduced[k];
+      for (int a = 0; a < 3; ++a) {
+        for (int j = 0; j < 4; ++j) {
+          for (int b = 0; b < 3; ++b) {
+            rhs[4 * a + j] -= upper[k][3 * a + b] * reduced[k + 1][4 * b + j];
+          }
+        }
+      }
+      reduced[k] = multiply(pivot_inverse[k], rhs);
+    }
+    // Schur complement for the last block
+    Mat3 schur = diag[m];
+    Vec3 rhs_last{-grad[m][0], -grad[m][1], -grad[m][2]};
+    for (int k = 0; k < m; ++k) {
+      for (int a = 0; a < 3; ++a) {
+        for (int b = 0; b < 3; ++b) {
+          // (E_k^T X_k)[a][b] = sum_c E_k[c][a] * X_k[c][b]
+          for (int c = 0; c < 3; ++c) {
+            schur[3 * a + b] -= border[k][3 * c + a] * reduced[k][4 * c + b];
+          }
+        }
+        for (int c = 0; c < 3; ++c) {
+          rhs_last[a] -= border[k][3 * c + a] * reduced[k][4 * c + 3];
+        }
+      }
+    }
+    const auto schur_inverse = inverse(schur);
+    Vec3 last{};
+    for (int a = 0; a < 3; ++a) {
+      for (int b = 0; b < 3; ++b) {
+        last[a] += schur_inverse[3 * a + b] * rhs_last[b];
+      }
+      step[3 * m + a] = last[a];
+    }
+    for (int k = 0; k < m; ++k) {
+      for (int a = 0; a < 3; ++a) {
+        double v = reduced[k][4 * a + 3];
+        for (int b = 0; b < 3; ++b) {
+          v -= reduced[k][4 * a + b] * last[b];
+        }
+        step[3 * k + a] = v;
+      }
+    }
+  }
+
+  /**
+   * The largest step along `step` that stays strictly feasible. Every slack
+   * is a quadratic function of the step length.
+   */
+  double max_step() const {
+    double alpha = std::numeric_limits<double>::infinity();
+    auto limit = [&alpha](const double a, const double b, const double c) {
+      // smallest positive root of a*x^2 + b*x + c with c > 0
+      if (a == 0) {
+        if (b < 0) {
+          alpha = std::min(alpha, -c / b);
+        }
+        return;
+      }
+      const double disc = b * b - 4 * a * c;
+      if (disc < 0) {
+        return; // no root, a > 0
+      }
+      // numerically stable roots
+      const double q = -0.5 * (b + std::copysign(std::sqrt(disc), b));
+      for (const double root : {q / a, c / q}) {
+        if (root > 0) {
+          alpha = std::min(alpha, root);
+        }
+      }
+    };
+    for (int i = 0; i < n; ++i) {
+      if (has_segment(i)) {
+        const int j = prev(i);
+        const double dx = z[3 * i] - z[3 * j];
+        const double dy = z[3 * i + 1] - z[3 * j + 1];
+        const double fi = z[3 * i + 2];
+        const double sx = step[3 * i] - step[3 * j];
+        const double sy = step[3 * i + 1] - step[3 * j + 1];
+        const double sf = step[3 * i + 2];
+        limit(0.0, sf, fi);
+        limit(sf * sf - sx * sx - sy * sy, 2 * (fi * sf - dx * sx - dy * sy),
+              fi * fi - dx * dx - dy * dy);
+      }
+      if (!fixed[3 * i]) {
+        const double qx = z[3 * i] - cx[i];
+        const double qy = z[3 * i + 1] - cy[i];
+        const double sx = step[3 * i];
+        const double sy = step[3 * i + 1];
+        limit(-sx * sx - sy * sy, -2 * (qx * sx + qy * sy),
+              r[i] * r[i] - qx * qx - qy * qy);
+      }
+    }
+    return alpha;
+  }
+
+  /**
+   * Minimizes the barrier function for the given t with a damped Newton
+   * method.
+   */
+  void center(const double t) {
+    for (int it = 0; it < MAX_NEWTON_ITERATIONS; ++it) {
+      assemble(t);
+      solve_newton_system();
+      double decrement = 0.0;
+      for (int k = 0; k < n; ++k) {
+        for (int a = 0; a < 3; ++a) {
+          decrement -= grad[k][a] * step[3 * k + a];
+        }
+      }
+      if (!(decrement > NEWTON_TOLERANCE)) {
+        return; // centered (or numerically not possible to improve)
+      }
+      double alpha = std::min(1.0, 0.99 * max_step());
+      bool improved = false;
+      while (alpha > MIN_STEP) {
+        for (int i = 0; i < 3 * n; ++i) {
+          candidate[i] = z[i] + alpha * step[i];
+        }
+        if (barrier_change(candidate, t) <= -0.25 * alpha * decrement) {
+          z.swap(candidate);
+          improved = true;
+          break;
+        }
+        alpha *= 0.5;
+      }
+      if (!improved) {
+        return;
+      }
+    }
+  }
+
+  static constexpr double MU = 50.0;
+  static constexpr int MAX_OUTER_ITERATIONS = 40;
+  static constexpr int MAX_NEWTON_ITERATIONS = 100;
+  static constexpr double NEWTON_TOLERANCE = 1e-8;
+  static constexpr double MIN_STEP = 1e-12;
+
+  int n = 0;
+  bool path = false;
+  double tolerance;
+  double offset_x = 0.0, offset_y = 0.0, scale = 1.0;
+  std::vector<double> cx, cy, r;
+  std::vector<char> fixed; // per variable
+  std::vector<double> z; // (x_i, y_i, f_i) for all circles
+  double barrier_parameter = 0.0;
+  std::vector<Mat3> diag, upper, border, pivot_inverse;
+  std::vector<Vec3> grad;
+  std::vector<Mat34> reduced;
+  std::vector<double> step;
+  std::vector<double> candidate;
+};
+} // namespace
+
+std::pair<Trajectory, std::vector<bool>>
+NativeTrajectorySolver::solve(const std::vector<Circle> &circle_sequence,
+                              bool path) {
+  if (circle_sequence.empty()) {
+    return {Trajectory{}, {}};
+  }
+  BarrierTrajectorySolver solver(tolerance);
+  solver.setup(circle_sequence, path);
+  solver.optimize();
+  return solver.get_solution(circle_sequence);
+}
+
+std::vector<std::pair<Trajectory, std::vector<bool>>>
+NativeTrajectorySolver::solve_batch(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path) {
+  // The siblings have the same structure, so we keep the workspace. Warm
+  // starting from a sibling's solution does not pay off for the barrier
+  // method, as it has to start far from the boundary anyway.
+  BarrierTrajectorySolver solver(tolerance);
+  std::vector<std::pair<Trajectory, std::vector<bool>>> results;
+  results.reserve(circle_sequences.size());
+  for (const auto &circle_sequence : circle_sequences) {
+    if (circle_sequence.empty()) {
+      results.emplace_back(Trajectory{}, std::vector<bool>{});
+      continue;
+    }
+    solver.setup(circle_sequence, path);
+    solver.optimize();
+    results.push_back(solver.get_solution(circle_sequence));
+  }
+  return results;
+}
+
+std::vector<CutoffSolution> NativeTrajectorySolver::solve_batch_with_cutoff(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path,
+    const double cutoff) {
+  return solve_batch_with_tolerance(circle_sequences, path, cutoff, tolerance,
+                                    false);
+}
+
+std::vector<CutoffSolution> NativeTrajectorySolver::solve_batch_loosely(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path,
+    const double cutoff) {
+  return solve_batch_with_tolerance(circle_sequences, path, cutoff,
+                                    loose_tolerance, true);
+}
+
+std::vector<CutoffSolution> NativeTrajectorySolver::solve_batch_with_tolerance(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path,
+    const double cutoff, const double tolerance_, const bool loose) {
+  BarrierTrajectorySolver solver(tolerance_);
+  std::vector<CutoffSolution> results;
+  results.reserve(circle_sequences.size());
+  for (const auto &circle_sequence : circle_sequences) {
+    if (circle_sequence.empty()) {
+      results.push_back({std::make_pair(Trajectory{}, std::vector<bool>{}), 0.0});
+      continue;
+    }
+    solver.setup(circle_sequence, path);
+    if (const auto lb = solver.optimize(circle_sequence, cutoff)) {
+      results.push_back({{}, *lb});
+      continue;
+    }
+    auto solution = solver.get_solution(circle_sequence);
+    const double length = solution.first.length();
+    // The loose hitting points are still good enough for a tight dual bound.
+    const double lower_bound =
+        loose ? std::min(length, solver.get_lower_bound(circle_sequence))
+              : length;
+    results.push_back({std::move(solution), lower_bound});
+  }
+  return results;
+}
+} // namespace cetsp
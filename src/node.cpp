@@ -3,52 +3,198 @@
 //
 
 #include "cetsp/node.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
 namespace cetsp {
 
 static bool is_segments_intersect(const Point &p11, const Point &p12,
                                   const Point &p21, const Point &p22);
 
+// The bounds are propagated through the whole tree, so all nodes of a tree
+// share one lock, which the children take over from their parent. The
+// propagation goes down the tree and the outdated bounds are updated from
+// the children, so the public methods take the lock and call the `_locked`
+// methods, which expect it to be held. The propagation is cheap compared to
+// the node evaluation, so there is little contention even with many threads.
+// For this, the `_locked` methods never compute a relaxed solution. The
+// bounds are initialized by `get_lower_bound` before the lock is taken.
+// Reading an up-to-date bound and the pruning state, which the workers do
+// for every node they consider, does not need the lock at all.
+
+Node::~Node() {
+  // Pruned nodes are neither tracked nor have children, so the subtree
+  // freed by `prune_locked` does not take the lock again.
+  if (lower_bound_handle.tracker != nullptr || !children.empty()) {
+    std::lock_guard<std::mutex> lock(*tree_mutex);
+    if (lower_bound_handle.tracker != nullptr) {
+      lower_bound_handle.tracker->remove(lower_bound_handle);
+    }
+    // The children may outlive the node, e.g., in the open nodes.
+    for (auto &child : children) {
+      child->parent = nullptr;
+    }
+  }
+}
+
 void Node::add_lower_bound(const double lb) {
-  if (get_lower_bound() < lb) {
+  get_lower_bound(); // computes the relaxed solution without the lock
+  std::lock_guard<std::mutex> lock(*tree_mutex);
+  add_lower_bound_locked(lb);
+}
+
+void Node::add_lower_bound_locked(const double lb) {
+  if (get_lower_bound_locked() < lb) {
     lazy_lower_bound_value = lb;
-    // propagate to parent
-    if (parent != nullptr && parent->get_lower_bound() < lb) {
-      parent->reevaluate_children();
+    publish_lower_bound_locked();
+    if (lower_bound_handle.tracker != nullptr) {
+      lower_bound_handle.tracker->update(lower_bound_handle, lb);
+    }
+    // The ancestors are only updated when their bound is requested, as
+    // walking up for every change is expensive in large trees.
+    if (parent != nullptr) {
+      parent->invalidate_children_bound();
     }
     // Potentially also propagate to children.
     if (!children.empty()) {
       for (auto &child : children) {
-        child->add_lower_bound(lb);
+        child->add_lower_bound_locked(lb);
       }
     }
   }
 }
 
 auto Node::get_lower_bound() -> double {
-  if (!lazy_lower_bound_value) {
-    lazy_lower_bound_value = get_relaxed_solution().obj();
-    if (parent != nullptr) {
-      if (lazy_lower_bound_value < parent->get_lower_bound()) {
-        lazy_lower_bound_value = parent->get_lower_bound();
-      }
+  const double published =
+      published_lower_bound.load(std::memory_order_acquire);
+  if (!std::isnan(published)) {
+    return published;
+  }
+  {
+    std::lock_guard<std::mutex> lock(*tree_mutex);
+    if (lazy_lower_bound_value) {
+      return get_lower_bound_locked();
     }
   }
+  // May trigger the computation of the trajectory, which should not block
+  // the other threads. If the computation has stopped at a cutoff or is
+  // loose, its certified bound is used instead.
+  const double obj = _relaxed_solution.get_lower_bound();
+  // The ancestors are only walked with the lock held, as other workers may
+  // prune and free them in the meantime.
+  std::lock_guard<std::mutex> lock(*tree_mutex);
+  if (!lazy_lower_bound_value) {
+    lazy_lower_bound_value =
+        parent != nullptr ? std::max(obj, parent->get_lower_bound_locked())
+                          : obj;
+    publish_lower_bound_locked();
+  }
+  return get_lower_bound_locked();
+}
+
+double Node::get_lower_bound_locked() {
+  if (!lazy_lower_bound_value) {
+    // Not initialized by `get_lower_bound`. Computing the relaxed solution
+    // here would block all workers of the tree. The bound of the parent is
+    // still valid, but it is not kept, such that the exact bound is used as
+    // soon as it is known.
+    return parent != nullptr ? parent->get_lower_bound_locked() : 0.0;
+  }
+  if (children_bound_outdated) {
+    reevaluate_children();
+    publish_lower_bound_locked();
+  }
   return *lazy_lower_bound_value;
 }
 
+void Node::publish_lower_bound_locked() {
+  published_lower_bound.store(
+      lazy_lower_bound_value && !children_bound_outdated
+          ? *lazy_lower_bound_value
+          : std::numeric_limits<double>::quiet_NaN(),
+      std::memory_order_release);
+}
+
+void Node::track_lower_bound(details::LowerBoundTracker *tracker) {
+  get_lower_bound(); // computes the relaxed solution without the lock
+  std::lock_guard<std::mutex> lock(*tree_mutex);
+  track_lower_bound_locked(tracker);
+}
+
+void Node::track_lower_bound_locked(details::LowerBoundTracker *tracker) {
+  if (pruned || lower_bound_handle.tracker != nullptr) {
+    return;
+  }
+  tracker->insert(lower_bound_handle, get_lower_bound_locked());
+}
+
+void Node::retire_lower_bound() {
+  std::lock_guard<std::mutex> lock(*tree_mutex);
+  if (lower_bound_handle.tracker != nullptr) {
+    lower_bound_handle.tracker->retire(lower_bound_handle,
+                                       get_lower_bound_locked());
+  }
+}
+
 bool Node::is_feasible() { return _relaxed_solution.is_feasible(); }
 
+void Node::defer_evaluation(const double objective_estimate) {
+  assert(parent != nullptr);
+  parent->get_lower_bound(); // computes the relaxed solution without the lock
+  std::lock_guard<std::mutex> lock(*tree_mutex);
+  // The bound of the parent is valid for the child without solving its SOCP.
+  lazy_lower_bound_value = parent->get_lower_bound_locked();
+  publish_lower_bound_locked();
+  deferred_objective_estimate = objective_estimate;
+}
+
+void Node::evaluate_deferred(const double cutoff, const bool loose) {
+  if (!is_deferred()) {
+    return;
+  }
+  // without the lock, as it solves the SOCP
+  trigger_lazy_evaluation({this}, cutoff, loose);
+  deferred_objective_estimate.reset();
+  add_lower_bound(_relaxed_solution.get_lower_bound());
+}
+
+bool Node::refine() {
+  if (!_relaxed_solution.refine()) { // without the lock, as it solves the SOCP
+    return false;
+  }
+  add_lower_bound(_relaxed_solution.obj());
+  return true;
+}
+
 void Node::branch(std::vector<std::shared_ptr<Node>> &children_) {
-  if (is_pruned()) {
+  // The children are tracked and their bounds are propagated with the lock
+  // held, so their relaxed solutions have to be computed before.
+  get_lower_bound();
+  for (auto &child : children_) {
+    child->get_lower_bound();
+  }
+  std::lock_guard<std::mutex> lock(*tree_mutex);
+  if (pruned) {
     throw std::invalid_argument("Cannot branch on pruned node.");
   }
   assert(!is_feasible());
   if (children_.empty()) {
-    prune();
+    prune_locked(true);
     children = std::vector<std::shared_ptr<Node>>{};
   } else {
     children = children_;
-    reevaluate_children();
+    // the children have been created with this node as parent
+    assert(std::all_of(
+        children.begin(), children.end(),
+        [&](const auto &child) { return child->tree_mutex == tree_mutex; }));
+    if (lower_bound_handle.tracker != nullptr) {
+      // the children replace the node as open leaves
+      for (auto &child : children) {
+        child->track_lower_bound_locked(lower_bound_handle.tracker);
+      }
+      lower_bound_handle.tracker->remove(lower_bound_handle);
+    }
+    invalidate_children_bound();
   }
 }
 
@@ -56,27 +202,73 @@ auto Node::get_relaxed_solution() -> const PartialSequenceSolution & {
   return _relaxed_solution;
 }
 
+size_t Node::release_relaxed_solution() {
+  get_lower_bound(); // has to be known without the relaxed solution
+  return _relaxed_solution.release_computed_data();
+}
+
+size_t Node::compact() {
+  assert(!children.empty());
+  return release_relaxed_solution();
+}
+
+auto Node::is_pruned() const -> bool {
+  return pruned.load(std::memory_order_acquire);
+}
+
 void Node::prune(bool infeasible) {
+  std::lock_guard<std::mutex> lock(*tree_mutex);
+  prune_locked(infeasible);
+}
+
+void Node::prune_locked(bool infeasible) {
   if (pruned) {
     return;
   }
-  pruned = true;
+  pruned.store(true, std::memory_order_release);
+  if (lower_bound_handle.tracker != nullptr) {
+    // The bound of a node pruned because of the gap still counts.
+    if (infeasible) {
+      lower_bound_handle.tracker->remove(lower_bound_handle);
+    } else {
+      lower_bound_handle.tracker->retire(lower_bound_handle,
+                                         get_lower_bound_locked());
+    }
+  }
   if (infeasible) {
-    add_lower_bound(std::numeric_limits<double>::infinity());
+    add_lower_bound_locked(std::numeric_limits<double>::infinity());
   }
   for (auto &child : children) {
-    child->prune(infeasible);
+    child->prune_locked(infeasible);
+    child->parent = nullptr;
   }
+  // Nothing in the subtree is needed anymore, so free it as a whole.
+  children.clear();
+  children.shrink_to_fit();
 }
 
 void Node::reevaluate_children() {
+  children_bound_outdated = false;
   if (!children.empty()) {
     auto lb = std::transform_reduce(
         children.begin(), children.end(),
         std::numeric_limits<double>::infinity(),
         [](double a, double b) { return std::min(a, b); },
-        [](std::shared_ptr<Node> &node) { return node->get_lower_bound(); });
-    add_lower_bound(lb);
+        [](std::shared_ptr<Node> &node) {
+          return node->get_lower_bound_locked();
+        });
+    // The children are at least as high and the ancestors are already
+    // marked as outdated, so no further propagation is needed.
+    lazy_lower_bound_value = std::max(*lazy_lower_bound_value, lb);
+  }
+}
+
+void Node::invalidate_children_bound() {
+  // If a node is outdated, its ancestors are as well.
+  for (Node *node = this; node != nullptr && !node->children_bound_outdated;
+       node = node->parent) {
+    node->children_bound_outdated = true;
+    node->publish_lower_bound_locked();
   }
 }
 
@@ -6,44 +6,116 @@
 
 namespace cetsp::details {
 void LazyTrajectoryComputation::compute_trajectory() const {
-  if (instance->is_path()) {
-    compute_path_trajectory();
-  } else {
-    compute_tour_trajectory();
-  };
+  compute_batch({this});
 }
-void LazyTrajectoryComputation::compute_tour_trajectory() const {
-  // compute the optimal tour trajectory through the sequence
+
+std::vector<Circle> LazyTrajectoryComputation::get_circles() const {
+  const auto &sequence = get_sequence();
   std::vector<Circle> circles;
-  circles.reserve(sequence.size());
+  circles.reserve(sequence.size() + 2);
+  if (instance->is_path()) {
+    // the fixed beginning of the path
+    circles.emplace_back(instance->path->first, 0);
+  }
   for (auto i : sequence) {
     assert(i < static_cast<int>(instance->size()));
     circles.push_back((*instance).at(i));
   }
-  assert(circles.size() == sequence.size());
-  auto soc = compute_trajectory_with_information(circles, false);
+  if (instance->is_path()) {
+    // the fixed ending of the path
+    circles.emplace_back(instance->path->second, 0);
+  }
+  return circles;
+}
+
+void LazyTrajectoryComputation::set_solution(
+    std::pair<Trajectory, std::vector<bool>> &&soc) const {
+  if (instance->is_path()) {
+    // remove the spanning information of the fixed endpoints
+    const int n = static_cast<int>(soc.second.size());
+    for (int i = 1; i < n - 1; ++i) {
+      soc.second[i - 1] = soc.second[i];
+    }
+    soc.second.pop_back();
+    soc.second.pop_back();
+  }
+  assert(soc.second.size() == record->size());
   data = std::move(soc);
+  forget_released();
+  parent_trajectory.reset();
 }
-void LazyTrajectoryComputation::compute_path_trajectory() const {
-  // compute the optimal path trajectory through the sequence
-  std::vector<Circle> circles;
-  circles.reserve(sequence.size() + 2);
-  circles.emplace_back(instance->path->first, 0);
-  for (auto i : sequence) {
-    circles.push_back((*instance).at(i));
+
+void LazyTrajectoryComputation::set_result(CutoffSolution &&result) const {
+  incremental = result.incremental;
+  if (result.solution) {
+    if (result.lower_bound < result.solution->first.length()) {
+      certified_bound = result.lower_bound; // loose
+    } else {
+      certified_bound.reset();
+    }
+    set_solution(std::move(*result.solution));
+  } else {
+    // The parent trajectory is kept, in case the trajectory is needed later.
+    certified_bound = result.lower_bound;
   }
-  circles.emplace_back(instance->path->second, 0);
-  assert(circles.size() == sequence.size() + 2);
-  auto soc = compute_trajectory_with_information(circles, true);
-  const int n = static_cast<int>(soc.second.size());
-  for (int i = 1; i < n - 1; ++i) {
-    soc.second[i - 1] = soc.second[i];
+}
+
+void LazyTrajectoryComputation::compute_batch(
+    const std::vector<const LazyTrajectoryComputation *> &batch,
+    const double cutoff, const bool loose) {
+  // Tours and paths are not mixed as all share the same instance.
+  std::vector<const LazyTrajectoryComputation *> todo;
+  std::vector<std::vector<Circle>> circle_sequences;
+  std::vector<const ParentTrajectory *> parents;
+  std::vector<int> inserted_at;
+  for (const auto *lazy : batch) {
+    if (lazy->data ||
+        (lazy->is_above_cutoff() && *lazy->certified_bound > cutoff)) {
+      continue; // still proved to be above the cutoff
+    }
+    todo.push_back(lazy);
+    circle_sequences.push_back(lazy->get_circles());
+    parents.push_back(lazy->parent_trajectory.get());
+    // the circles of a path start with its fixed beginning
+    inserted_at.push_back(lazy->parent_insertion +
+                          (lazy->instance->is_path() ? 1 : 0));
+  }
+  if (todo.empty()) {
+    return;
+  }
+  const bool path = todo.front()->instance->is_path();
+  auto results = compute_trajectories_incrementally(
+      circle_sequences, path, parents, inserted_at, cutoff, loose);
+  for (size_t i = 0; i < todo.size(); ++i) {
+    todo[i]->set_result(std::move(results[i]));
   }
-  soc.second.pop_back(); // remove last element
-  data = std::move(soc);
 }
 
 } // namespace cetsp::details
+std::shared_ptr<const cetsp::details::ParentTrajectory>
+cetsp::PartialSequenceSolution::get_parent_trajectory() const {
+  // The points of a path also contain the fixed endpoints. For a tour, we
+  // skip the closing point.
+  const auto &points = get_trajectory().points;
+  const auto &spanning = spanning_trajectory.get_spanning_information();
+  auto parent = std::make_shared<details::ParentTrajectory>();
+  if (instance->is_path()) {
+    parent->hitting_points = points;
+    parent->spanning.push_back(true);
+    parent->spanning.insert(parent->spanning.end(), spanning.begin(),
+                            spanning.end());
+    parent->spanning.push_back(true);
+  } else {
+    parent->hitting_points.assign(points.begin(), points.end() - 1);
+    parent->spanning = spanning;
+  }
+  return parent;
+}
+std::shared_ptr<const cetsp::details::ParentCoverage>
+cetsp::PartialSequenceSolution::get_parent_coverage() const {
+  return std::make_shared<const details::ParentCoverage>(
+      *instance, get_trajectory(), FEASIBILITY_TOL);
+}
 void cetsp::PartialSequenceSolution::simplify() {
   if (simplified) {
     return;
@@ -57,7 +129,7 @@ void cetsp::PartialSequenceSolution::simplify() {
     points.push_back(trajectory_begin());
   }
   // add all spanning circles and their hitting points
-  const auto &sequence = spanning_trajectory.sequence;
+  const auto &sequence = spanning_trajectory.get_sequence();
   for (int i = 0; i < sequence.size(); ++i) {
     if (is_sequence_index_spanning(i)) {
       points.push_back(get_sequence_hitting_point(i));
@@ -75,7 +147,7 @@ void cetsp::PartialSequenceSolution::simplify() {
     points.push_back(points.front());
   }
   // update the trajectory and sequence. Feasibility etc. doesn't change.
-  spanning_trajectory.sequence = std::move(simplified_sequence);
+  spanning_trajectory.set_sequence(std::move(simplified_sequence));
   spanning_trajectory.update(Trajectory(points), std::move(is_spanning));
   simplified = true;
 }
@@ -97,11 +169,52 @@ bool cetsp::PartialSequenceSolution::is_feasible() const {
   }
   return *_feasible;
 }
+size_t cetsp::PartialSequenceSolution::get_computed_data_size() const {
+  return spanning_trajectory.get_data_size() + distances.memory_usage();
+}
+
+bool cetsp::PartialSequenceSolution::refine() const {
+  if (!spanning_trajectory.refine()) {
+    return false;
+  }
+  distances.clear();
+  _feasible.reset();
+  feasible_below = 0;
+  return true;
+}
+
+size_t cetsp::PartialSequenceSolution::release_computed_data() const {
+  const auto size = get_computed_data_size();
+  if (is_computed() && !is_exact()) {
+    // The feasibility of a loose trajectory may not hold for the exact one.
+    _feasible.reset();
+    feasible_below = 0;
+  }
+  spanning_trajectory.release_data();
+  spanning_trajectory.release_sequence();
+  distances.clear();
+  return size;
+}
+
 bool cetsp::PartialSequenceSolution::covers(int i) const {
-  const auto &sequence = spanning_trajectory.sequence;
-  if (std::any_of(sequence.begin(), sequence.end(),
-                  [i](const auto &j) { return i == j; })) {
+  // The grid check is cheaper than searching the sequence.
+  if (distances.is_covered(i, &get_trajectory(), FEASIBILITY_TOL)) {
     return true;
   }
-  return distance(i) <= FEASIBILITY_TOL;
+  const auto &sequence = spanning_trajectory.get_sequence();
+  return std::any_of(sequence.begin(), sequence.end(),
+                     [i](const auto &j) { return i == j; });
+}
+
+std::optional<int>
+cetsp::PartialSequenceSolution::get_farthest_uncovered_circle() const {
+  std::vector<char> in_sequence(instance->size(), 0);
+  for (const auto i : spanning_trajectory.get_sequence()) {
+    in_sequence[i] = 1;
+  }
+  const auto farthest = distances.farthest(&get_trajectory(), in_sequence);
+  if (!farthest || farthest->second <= FEASIBILITY_TOL) {
+    return {};
+  }
+  return farthest->first;
 }
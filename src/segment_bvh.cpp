@@ -0,0 +1,107 @@
+#include "cetsp/utils/segment_bvh.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace cetsp::utils {
+
+SegmentBvh::SegmentBvh(const double *px, const double *py, const size_t m) {
+  assert(m > 0);
+  const size_t num_segments = std::max<size_t>(1, m - 1);
+  ax.reserve(num_segments);
+  ay.reserve(num_segments);
+  bx.reserve(num_segments);
+  by.reserve(num_segments);
+  double scale = 1.0;
+  for (size_t j = 0; j < num_segments; ++j) {
+    const size_t l = std::min(j + 1, m - 1);
+    ax.push_back(px[j]);
+    ay.push_back(py[j]);
+    bx.push_back(px[l]);
+    by.push_back(py[l]);
+    scale = std::max({scale, std::abs(px[j]), std::abs(py[j]),
+                      std::abs(px[l]), std::abs(py[l])});
+  }
+  // A segment is never farther than its box, up to the rounding.
+  slack = 1e-12 * scale;
+  nodes.reserve(num_segments);
+  build(0, static_cast<unsigned>(num_segments));
+}
+
+unsigned SegmentBvh::build(const unsigned begin, const unsigned end) {
+  constexpr unsigned LEAF_SIZE = 4;
+  const auto index = static_cast<unsigned>(nodes.size());
+  nodes.push_back({0, 0, 0, 0, begin, end, 0, 0});
+  if (end - begin <= LEAF_SIZE) {
+    Node &node = nodes[index];
+    node.x0 = std::min(ax[begin], bx[begin]);
+    node.y0 = std::min(ay[begin], by[begin]);
+    node.x1 = std::max(ax[begin], bx[begin]);
+    node.y1 = std::max(ay[begin], by[begin]);
+    for (auto k = begin + 1; k < end; ++k) {
+      node.x0 = std::min({node.x0, ax[k], bx[k]});
+      node.y0 = std::min({node.y0, ay[k], by[k]});
+      node.x1 = std::max({node.x1, ax[k], bx[k]});
+      node.y1 = std::max({node.y1, ay[k], by[k]});
+    }
+    return index;
+  }
+  const auto mid = begin + (end - begin) / 2;
+  const auto left = build(begin, mid);
+  const auto right = build(mid, end);
+  Node &node = nodes[index];
+  node.left = left;
+  node.right = right;
+  node.x0 = std::min(nodes[left].x0, nodes[right].x0);
+  node.y0 = std::min(nodes[left].y0, nodes[right].y0);
+  node.x1 = std::max(nodes[left].x1, nodes[right].x1);
+  node.y1 = std::max(nodes[left].y1, nodes[right].y1);
+  return index;
+}
+
+double SegmentBvh::squared_box_distance(const Node &node, const double x,
+                                        const double y) const {
+  const double dx = std::max({node.x0 - x, 0.0, x - node.x1});
+  const double dy = std::max({node.y0 - y, 0.0, y - node.y1});
+  return dx * dx + dy * dy;
+}
+
+double SegmentBvh::distance(const double x, const double y) const {
+  double best = std::numeric_limits<double>::infinity();
+  // The boxes are compared with a slack, such that no segment is skipped
+  // whose rounded distance could be smaller.
+  auto is_pruned = [&](double squared_distance) {
+    const double bound = best + slack;
+    return squared_distance > bound * bound;
+  };
+  // The depth is logarithmic, as the splits are in the middle.
+  unsigned stack[128];
+  int size = 0;
+  stack[size++] = 0;
+  while (size > 0) {
+    const auto &node = nodes[stack[--size]];
+    if (is_pruned(squared_box_distance(node, x, y))) {
+      continue;
+    }
+    if (node.left == node.right) { // leaf
+      for (auto k = node.begin; k < node.end; ++k) {
+        best = std::min(best,
+                        distance_to_segment({ax[k], ay[k]}, {bx[k], by[k]},
+                                            {x, y}));
+      }
+      continue;
+    }
+    // the closer child is visited first
+    const double dl = squared_box_distance(nodes[node.left], x, y);
+    const double dr = squared_box_distance(nodes[node.right], x, y);
+    if (dl <= dr) {
+      stack[size++] = node.right;
+      stack[size++] = node.left;
+    } else {
+      stack[size++] = node.left;
+      stack[size++] = node.right;
+    }
+  }
+  return best;
+}
+} // namespace cetsp::utils
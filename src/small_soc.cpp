@@ -0,0 +1,429 @@
+/**
+ * Fast paths for the trajectory through very short or degenerate sequences,
+ * which are solved far more often than their size suggests: The root nodes
+ * have only a few circles and the insertion costs of TripleMap and
+ * InsertionCostCalculator are trajectories through three circles.
+ *
+ * - Without radii, the trajectory is just the polygon through the centers.
+ * - One or two circles have a closed form.
+ * - Three circles are solved by the same barrier method as the native
+ *   solver, but with a dense Newton system of fixed size on the stack.
+ */
+#include "cetsp/common.h"
+#include "cetsp/soc.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace cetsp::details {
+namespace {
+constexpr double SPANNING_TOLERANCE = 0.01; // as for the other solvers
+
+bool is_spanning(const Circle &circle, const Point &p) {
+  return circle.center.dist(p) >= (1 - SPANNING_TOLERANCE) * circle.radius;
+}
+
+std::pair<Trajectory, std::vector<bool>>
+make_solution(const std::vector<Circle> &circle_sequence,
+              std::vector<Point> points, const bool path) {
+  std::vector<bool> spanning(circle_sequence.size());
+  for (size_t i = 0; i < circle_sequence.size(); ++i) {
+    spanning[i] = is_spanning(circle_sequence[i], points[i]);
+  }
+  if (!path) {
+    points.push_back(points[0]);
+  }
+  return {Trajectory(std::move(points)), std::move(spanning)};
+}
+
+/**
+ * Two circles: the closest points, or a common point if they intersect.
+ * The tour goes back and forth, so it is the same as the path.
+ */
+std::vector<Point> solve_two(const Circle &a, const Circle &b) {
+  const double d = a.center.dist(b.center);
+  if (d <= 0) {
+    return {a.center, a.center};
+  }
+  const double ux = (b.center.x - a.center.x) / d;
+  const double uy = (b.center.y - a.center.y) / d;
+  auto along = [&](const double s) {
+    return Point(a.center.x + s * ux, a.center.y + s * uy);
+  };
+  if (d <= a.radius + b.radius) {
+    // the middle of the part of the center line that lies in both circles
+    const double s =
+        0.5 * (std::max(0.0, d - b.radius) + std::min(a.radius, d));
+    const auto p = along(s);
+    return {p, p};
+  }
+  return {along(a.radius), along(d - b.radius)};
+}
+
+/**
+ * The barrier method of NativeTrajectorySolver for a fixed number of
+ * circles. The Newton system is small enough to be solved densely, and all
+ * data lives on the stack.
+ */
+template <int N> class SmallBarrierSolver {
+  static constexpr int M = 3 * N; // (x_i, y_i, f_i) per circle
+  using Vector = std::array<double, M>;
+  using Matrix = std::array<double, M * M>;
+
+public:
+  SmallBarrierSolver(const std::vector<Circle> &circle_sequence,
+                     const bool path)
+      : path{path} {
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = min_x, max_x = -min_x, max_y = -min_x, max_r = 0.0;
+    for (const auto &c : circle_sequence) {
+      min_x = std::min(min_x, c.center.x);
+      min_y = std::min(min_y, c.center.y);
+      max_x = std::max(max_x, c.center.x);
+      max_y = std::max(max_y, c.center.y);
+      max_r = std::max(max_r, c.radius);
+    }
+    offset_x = 0.5 * (min_x + max_x);
+    offset_y = 0.5 * (min_y + max_y);
+    scale = std::max({max_x - min_x, max_y - min_y, max_r});
+    if (!(scale > 0)) {
+      scale = 1.0;
+    }
+    fixed.fill(false);
+    for (int i = 0; i < N; ++i) {
+      cx[i] = (circle_sequence[i].center.x - offset_x) / scale;
+      cy[i] = (circle_sequence[i].center.y - offset_y) / scale;
+      r[i] = circle_sequence[i].radius / scale;
+      if (r[i] <= 0) {
+        fixed[3 * i] = fixed[3 * i + 1] = true;
+      }
+    }
+    if (path) {
+      fixed[2] = true; // there is no segment into the first circle
+    }
+    z.fill(0.0);
+    for (int i = 0; i < N; ++i) {
+      z[3 * i] = cx[i];
+      z[3 * i + 1] = cy[i];
+    }
+    for (int i = 0; i < N; ++i) {
+      if (has_segment(i)) {
+        z[3 * i + 2] = segment_length(z, i) + 1.0;
+        barrier_parameter += 2;
+      }
+      if (!fixed[3 * i]) {
+        barrier_parameter += 2;
+      }
+    }
+  }
+
+  void optimize() {
+    double t = 1.0;
+    for (int outer = 0; outer < MAX_OUTER_ITERATIONS; ++outer) {
+      center(t);
+      if (barrier_parameter / t <= TOLERANCE) {
+        return;
+      }
+      t *= MU;
+    }
+  }
+
+  std::vector<Point> get_hitting_points(
+      const std::vector<Circle> &circle_sequence) const {
+    std::vector<Point> points;
+    points.reserve(N + 1);
+    for (int i = 0; i < N; ++i) {
+      if (fixed[3 * i]) {
+        points.push_back(circle_sequence[i].center);
+      } else {
+        points.emplace_back(offset_x + scale * z[3 * i],
+                            offset_y + scale * z[3 * i + 1]);
+      }
+    }
+    return points;
+  }
+
+private:
+  [[nodiscard]] bool has_segment(const int i) const { return !path || i > 0; }
+
+  static int prev(const int i) { return i == 0 ? N - 1 : i - 1; }
+
+  static double segment_length(const Vector &v, const int i) {
+    const int j = prev(i);
+    return std::hypot(v[3 * i] - v[3 * j], v[3 * i + 1] - v[3 * j + 1]);
+  }
+
+  static double cone_slack(const Vector &v, const int i) {
+    const int j = prev(i);
+    const double dx = v[3 * i] - v[3 * j];
+    const double dy = v[3 * i + 1] - v[3 * j + 1];
+    return v[3 * i + 2] * v[3 * i + 2] - dx * dx - dy * dy;
+  }
+
+  [[nodiscard]] double disk_slack(const Vector &v, const int i) const {
+    const double qx = v[3 * i] - cx[i];
+    const double qy = v[3 * i + 1] - cy[i];
+    return r[i] * r[i] - qx * qx - qy * qy;
+  }
+
+  /**
+   * See BarrierTrajectorySolver::barrier_change.
+   */
+  double barrier_change(const Vector &v, const double t) const {
+    double change = 0.0;
+    for (int i = 0; i < N; ++i) {
+      if (has_segment(i)) {
+        const double g = cone_slack(v, i);
+        if (v[3 * i + 2] <= 0 || g <= 0) {
+          return std::numeric_limits<double>::infinity();
+        }
+        change += t * (v[3 * i + 2] - z[3 * i + 2]) -
+                  std::log(g / cone_slack(z, i));
+      }
+      if (!fixed[3 * i]) {
+        const double h = disk_slack(v, i);
+        if (h <= 0) {
+          return std::numeric_limits<double>::infinity();
+        }
+        change -= std::log(h / disk_slack(z, i));
+      }
+    }
+    return change;
+  }
+
+  void assemble(const double t, Matrix &hessian, Vector &grad) const {
+    hessian.fill(0.0);
+    grad.fill(0.0);
+    auto add = [&hessian](const int a, const int b, const double v) {
+      hessian[M * a + b] += v;
+    };
+    for (int i = 0; i < N; ++i) {
+      if (has_segment(i)) {
+        // -log(f^2 - ||d||^2) with d = p_i - p_j
+        const int j = prev(i);
+        const double d[2] = {z[3 * i] - z[3 * j], z[3 * i + 1] - z[3 * j + 1]};
+        const double fi = z[3 * i + 2];
+        const double g = fi * fi - d[0] * d[0] - d[1] * d[1];
+        const double g2 = g * g;
+        for (int a = 0; a < 2; ++a) {
+          for (int b = 0; b < 2; ++b) {
+            const double h = 4 * d[a] * d[b] / g2 + (a == b ? 2 / g : 0.0);
+            add(3 * i + a, 3 * i + b, h);
+            add(3 * j + a, 3 * j + b, h);
+            add(3 * i + a, 3 * j + b, -h);
+            add(3 * j + a, 3 * i + b, -h);
+          }
+          const double h_df = -4 * fi * d[a] / g2;
+          add(3 * i + a, 3 * i + 2, h_df);
+          add(3 * i + 2, 3 * i + a, h_df);
+          add(3 * j + a, 3 * i + 2, -h_df);
+          add(3 * i + 2, 3 * j + a, -h_df);
+          grad[3 * i + a] += 2 * d[a] / g;
+          grad[3 * j + a] -= 2 * d[a] / g;
+        }
+        add(3 * i + 2, 3 * i + 2, 4 * fi * fi / g2 - 2 / g);
+        grad[3 * i + 2] += t - 2 * fi / g;
+      }
+      if (!fixed[3 * i]) {
+        // -log(r^2 - ||p_i - c_i||^2)
+        const double q[2] = {z[3 * i] - cx[i], z[3 * i + 1] - cy[i]};
+        const double h = r[i] * r[i] - q[0] * q[0] - q[1] * q[1];
+        for (int a = 0; a < 2; ++a) {
+          for (int b = 0; b < 2; ++b) {
+            add(3 * i + a, 3 * i + b,
+                4 * q[a] * q[b] / (h * h) + (a == b ? 2 / h : 0.0));
+          }
+          grad[3 * i + a] += 2 * q[a] / h;
+        }
+      }
+    }
+    for (int a = 0; a < M; ++a) {
+      if (fixed[a]) {
+        for (int b = 0; b < M; ++b) {
+          hessian[M * a + b] = hessian[M * b + a] = 0.0;
+        }
+        hessian[M * a + a] = 1.0;
+        grad[a] = 0.0;
+      }
+    }
+  }
+
+  /**
+   * Solves the positive definite system in place by a Cholesky
+   * decomposition.
+   * @return The Newton step for the gradient.
+   */
+  static Vector solve(Matrix &a, const Vector &grad) {
+    for (int j = 0; j < M; ++j) {
+      double d = a[M * j + j];
+      for (int k = 0; k < j; ++k) {
+        d -= a[M * j + k] * a[M * j + k];
+      }
+      d = std::sqrt(std::max(d, std::numeric_limits<double>::min()));
+      a[M * j + j] = d;
+      for (int i = j + 1; i < M; ++i) {
+        double v = a[M * i + j];
+        for (int k = 0; k < j; ++k) {
+          v -= a[M * i + k] * a[M * j + k];
+        }
+        a[M * i + j] = v / d;
+      }
+    }
+    Vector x;
+    for (int i = 0; i < M; ++i) {
+      double v = -grad[i];
+      for (int k = 0; k < i; ++k) {
+        v -= a[M * i + k] * x[k];
+      }
+      x[i] = v / a[M * i + i];
+    }
+    for (int i = M - 1; i >= 0; --i) {
+      double v = x[i];
+      for (int k = i + 1; k < M; ++k) {
+        v -= a[M * k + i] * x[k];
+      }
+      x[i] = v / a[M * i + i];
+    }
+    return x;
+  }
+
+  /**
+   * See BarrierTrajectorySolver::max_step.
+   */
+  double max_step(const Vector &step) const {
+    double alpha = std::numeric_limits<double>::infinity();
+    auto limit = [&alpha](const double a, const double b, const double c) {
+      if (a == 0) {
+        if (b < 0) {
+          alpha = std::min(alpha, -c / b);
+        }
+        return;
+      }
+      const double disc = b * b - 4 * a * c;
+      if (disc < 0) {
+        return;
+      }
+      const double q = -0.5 * (b + std::copysign(std::sqrt(disc), b));
+      for (const double root : {q / a, c / q}) {
+        if (root > 0) {
+          alpha = std::min(alpha, root);
+        }
+      }
+    };
+    for (int i = 0; i < N; ++i) {
+      if (has_segment(i)) {
+        const int j = prev(i);
+        const double dx = z[3 * i] - z[3 * j];
+        const double dy = z[3 * i + 1] - z[3 * j + 1];
+        const double fi = z[3 * i + 2];
+        const double sx = step[3 * i] - step[3 * j];
+        const double sy = step[3 * i + 1] - step[3 * j + 1];
+        const double sf = step[3 * i + 2];
+        limit(0.0, sf, fi);
+        limit(sf * sf - sx * sx - sy * sy, 2 * (fi * sf - dx * sx - dy * sy),
+              fi * fi - dx * dx - dy * dy);
+      }
+      if (!fixed[3 * i]) {
+        const double qx = z[3 * i] - cx[i];
+        const double qy = z[3 * i + 1] - cy[i];
+        const double sx = step[3 * i];
+        const double sy = step[3 * i + 1];
+        limit(-sx * sx - sy * sy, -2 * (qx * sx + qy * sy),
+              r[i] * r[i] - qx * qx - qy * qy);
+      }
+    }
+    return alpha;
+  }
+
+  void center(const double t) {
+    Matrix hessian;
+    Vector grad;
+    for (int it = 0; it < MAX_NEWTON_ITERATIONS; ++it) {
+      assemble(t, hessian, grad);
+      const auto step = solve(hessian, grad);
+      double decrement = 0.0;
+      for (int a = 0; a < M; ++a) {
+        decrement -= grad[a] * step[a];
+      }
+      if (!(decrement > NEWTON_TOLERANCE)) {
+        return;
+      }
+      double alpha = std::min(1.0, 0.99 * max_step(step));
+      bool improved = false;
+      while (alpha > MIN_STEP) {
+        Vector candidate;
+        for (int a = 0; a < M; ++a) {
+          candidate[a] = z[a] + alpha * step[a];
+        }
+        if (barrier_change(candidate, t) <= -0.25 * alpha * decrement) {
+          z = candidate;
+          improved = true;
+          break;
+        }
+        alpha *= 0.5;
+      }
+      if (!improved) {
+        return;
+      }
+    }
+  }
+
+  // the same parameters as for the native solver
+  static constexpr double TOLERANCE = 1e-9;
+  static constexpr double MU = 50.0;
+  static constexpr int MAX_OUTER_ITERATIONS = 40;
+  static constexpr int MAX_NEWTON_ITERATIONS = 100;
+  static constexpr double NEWTON_TOLERANCE = 1e-8;
+  static constexpr double MIN_STEP = 1e-12;
+
+  bool path;
+  double offset_x = 0.0, offset_y = 0.0, scale = 1.0;
+  std::array<double, N> cx{}, cy{}, r{};
+  std::array<bool, M> fixed{};
+  Vector z{};
+  double barrier_parameter = 0.0;
+};
+
+template <int N>
+std::vector<Point> solve_small(const std::vector<Circle> &circle_sequence,
+                               const bool path) {
+  SmallBarrierSolver<N> solver(circle_sequence, path);
+  solver.optimize();
+  return solver.get_hitting_points(circle_sequence);
+}
+} // namespace
+
+std::optional<std::pair<Trajectory, std::vector<bool>>>
+compute_small_trajectory(const std::vector<Circle> &circle_sequence,
+                         const bool path) {
+  const auto n = circle_sequence.size();
+  if (n == 0) {
+    return {};
+  }
+  if (std::all_of(circle_sequence.begin(), circle_sequence.end(),
+                  [](const Circle &c) { return c.radius <= 0; })) {
+    std::vector<Point> centers;
+    centers.reserve(n + 1);
+    for (const auto &c : circle_sequence) {
+      centers.push_back(c.center);
+    }
+    return make_solution(circle_sequence, std::move(centers), path);
+  }
+  switch (n) {
+  case 1:
+    return make_solution(circle_sequence, {circle_sequence[0].center}, path);
+  case 2:
+    return make_solution(
+        circle_sequence, solve_two(circle_sequence[0], circle_sequence[1]),
+        path);
+  case 3:
+    return make_solution(circle_sequence, solve_small<3>(circle_sequence, path),
+                         path);
+  default:
+    return {};
+  }
+}
+} // namespace cetsp::details
@@ -1,108 +1,958 @@
 #include "cetsp/soc.h"
 #include "cetsp/common.h"
-#include <gurobi_c++.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 #include <vector>
+#ifndef CETSP_WITHOUT_GUROBI
+#include <gurobi_c++.h>
+#endif
 namespace cetsp {
 
-std::pair<Trajectory, std::vector<bool>>
-compute_trajectory_with_information(const std::vector<Circle> &circle_sequence,
-                                    bool path) {
-  constexpr auto SPANNING_TOLERANCE = 0.01;
+#ifndef CETSP_WITHOUT_GUROBI
+namespace {
+/**
+ * The SOCP for the optimal trajectory through a fixed number of circles.
+ * The structure of the model only depends on the number of circles and if
+ * we want a tour or a path. The circles only appear in the right hand sides
+ * of the constraints, such that the model can be reused for any sequence of
+ * the same length by just rewriting them.
+ */
+class TrajectoryModel {
+public:
+  using Formulation = GurobiTrajectorySolver::Formulation;
 
-  static GRBEnv env;
-  GRBModel model(&env);
-
-  const auto n = circle_sequence.size();
-  std::vector<GRBVar> x;
-  x.resize(n);
-  std::vector<GRBVar> y;
-  y.resize(n);
-  std::vector<GRBVar> f;
-  f.resize(n);
-  std::vector<GRBVar> w;
-  w.resize(n);
-  std::vector<GRBVar> u;
-  u.resize(n);
-  std::vector<GRBVar> s;
-  s.resize(n);
-  std::vector<GRBVar> t;
-  t.resize(n);
-  GRBLinExpr obj = 0;
-
-  for (unsigned i = 0; i < n; ++i) {
-    x[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
-                        /*obj=*/0.0, /*type=*/GRB_CONTINUOUS);
-    y[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
-                        /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
-                        /*name=*/);
-    f[i] = model.addVar(/*lb=*/0, /*ub=*/GRB_INFINITY,
-                        /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
-                        /*name=*/);
-    w[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
-                        /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
-                        /*name=*/);
-    u[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
-                        /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
-                        /*name=*/);
-    s[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
-                        /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
-                        /*name=*/);
-    t[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
-                        /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
-                        /*name=*/);
-    obj += f[i];
-  }
-
-  model.setObjective(obj, GRB_MINIMIZE);
-
-  for (unsigned i = 0; i < n; ++i) {
-    model.addQConstr(f[i] * f[i] >= w[i] * w[i] + u[i] * u[i]);
-    const auto r = circle_sequence[i].radius;
-    model.addQConstr(s[i] * s[i] + t[i] * t[i] <= r * r);
-
-    const auto cx = circle_sequence[i].center.x;
-    const auto cy = circle_sequence[i].center.y;
-    model.addConstr(s[i] == cx - x[i]);
-    model.addConstr(t[i] == cy - y[i]);
-  }
-
-  for (unsigned i = 0; i < n; ++i) {
-    if (path && i == 0) {
-      model.addConstr(w[i] == 0);
-      model.addConstr(u[i] == 0);
+  TrajectoryModel(GRBEnv &env, const unsigned n, const bool path,
+                  const Formulation formulation = Formulation::STANDARD)
+      : model(&env), n{n}, formulation{formulation} {
+    if (formulation == Formulation::LEAN) {
+      build_lean(path);
     } else {
-      const auto prev_c = (i == 0 ? n - 1 : i - 1);
-      assert(prev_c >= 0);
-      model.addConstr(w[i] == x[prev_c] - x[i]);
-      model.addConstr(u[i] == y[prev_c] - y[i]);
-    }
-  }
-  model.set(GRB_IntParam_OutputFlag, 0);
-  // tuned via the built-in tune() function of Gurobi.
-  model.set(GRB_IntParam_Presolve, 0);
-  model.set(GRB_IntParam_SimplexPricing, 3);
-  // model.set(GRB_IntParam_PrePasses, 8);
-  model.optimize();
-  std::vector<Point> points;
-  points.reserve(n + 1);
-  std::vector<bool> spanning_circles(n);
-  for (unsigned i = 0; i < n; i++) {
-    points.emplace_back(x[i].get(GRB_DoubleAttr_X), y[i].get(GRB_DoubleAttr_X));
-    const auto si = s[i].get(GRB_DoubleAttr_X);
-    const auto ti = t[i].get(GRB_DoubleAttr_X);
-    const auto r = circle_sequence[i].radius;
-    bool is_spanning =
-        std::sqrt(si * si + ti * ti) >= (1 - SPANNING_TOLERANCE) * r;
-    spanning_circles[i] = is_spanning;
+      build_standard(path);
+    }
+    model.set(GRB_IntParam_OutputFlag, 0);
+    // tuned via the built-in tune() function of Gurobi.
+    model.set(GRB_IntParam_Presolve, 0);
+    model.set(GRB_IntParam_SimplexPricing, 3);
+    // model.set(GRB_IntParam_PrePasses, 8);
   }
-  if (!path) {
-    points.push_back(points[0]);
+
+  /**
+   * Rewrite the circle centers and radii in the model.
+   */
+  void set_circles(const std::vector<Circle> &circle_sequence) {
+    assert(circle_sequence.size() == n);
+    for (unsigned i = 0; i < n; ++i) {
+      const auto &circle = circle_sequence[i];
+      disk_constraints[i].set(GRB_DoubleAttr_QCRHS,
+                              circle.radius * circle.radius);
+    }
+    if (formulation == Formulation::STANDARD) {
+      for (unsigned i = 0; i < n; ++i) {
+        x_constraints[i].set(GRB_DoubleAttr_RHS, circle_sequence[i].center.x);
+        y_constraints[i].set(GRB_DoubleAttr_RHS, circle_sequence[i].center.y);
+      }
+      return;
+    }
+    // The lean formulation has the differences of the centers of the
+    // segments in the right hand sides.
+    const unsigned first = n - x_constraints.size();
+    for (unsigned k = 0; k < x_constraints.size(); ++k) {
+      const auto &c = circle_sequence[k + first].center;
+      const auto &prev_c = circle_sequence[(k + first + n - 1) % n].center;
+      x_constraints[k].set(GRB_DoubleAttr_RHS, prev_c.x - c.x);
+      y_constraints[k].set(GRB_DoubleAttr_RHS, prev_c.y - c.y);
+    }
+  }
+
+  std::pair<Trajectory, std::vector<bool>>
+  optimize(const std::vector<Circle> &circle_sequence, const bool path) {
+    set_circles(circle_sequence);
+    model.optimize();
+    check_status(model.get(GRB_IntAttr_Status), false);
+    return get_solution(circle_sequence, path);
   }
-  return {Trajectory(points), spanning_circles};
+
+  /**
+   * Like `optimize`, but Gurobi may stop as soon as the objective is proved
+   * to be above the cutoff.
+   * @param loose Stop the barrier at a loose convergence tolerance. The lower
+   * bound is then certified by `compute_trajectory_lower_bound`.
+   */
+  CutoffSolution optimize(const std::vector<Circle> &circle_sequence,
+                          const bool path, const double cutoff,
+                          const bool loose = false) {
+    set_circles(circle_sequence);
+    model.set(GRB_DoubleParam_Cutoff, std::min(cutoff, GRB_INFINITY));
+    if (loose) {
+      model.set(GRB_DoubleParam_BarQCPConvTol, LOOSE_CONVERGENCE_TOLERANCE);
+    }
+    model.optimize();
+    const int status = model.get(GRB_IntAttr_Status);
+    // The model is pooled, so the parameters must not stay.
+    model.set(GRB_DoubleParam_Cutoff, GRB_INFINITY);
+    if (loose) {
+      model.set(GRB_DoubleParam_BarQCPConvTol, DEFAULT_CONVERGENCE_TOLERANCE);
+    }
+    // The barrier of Gurobi also stops at the cutoff for this SOCP, and only
+    // if the optimum is above it (checked with Gurobi 13).
+    if (status == GRB_CUTOFF) {
+      return {{}, cutoff};
+    }
+    // A loose barrier often ends as suboptimal, which is fine as the lower
+    // bound is certified below.
+    check_status(status, loose);
+    auto solution = get_solution(circle_sequence, path);
+    const double length = solution.first.length();
+    if (!loose) {
+      return {std::move(solution), length};
+    }
+    const auto &points = solution.first.points;
+    const double lb = compute_trajectory_lower_bound(
+        circle_sequence, {points.begin(), points.begin() + n}, path);
+    return {std::move(solution), std::min(length, lb)};
+  }
+
+  GRBModel &get_model() { return model; }
+
+private:
+  /**
+   * Seven variables and six constraints per circle, added one by one.
+   */
+  void build_standard(const bool path) {
+    x.resize(n);
+    y.resize(n);
+    f.resize(n);
+    w.resize(n);
+    u.resize(n);
+    s.resize(n);
+    t.resize(n);
+    x_constraints.resize(n);
+    y_constraints.resize(n);
+    disk_constraints.resize(n);
+    GRBLinExpr obj = 0;
+
+    for (unsigned i = 0; i < n; ++i) {
+      x[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
+                          /*obj=*/0.0, /*type=*/GRB_CONTINUOUS);
+      y[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
+                          /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
+                          /*name=*/);
+      f[i] = model.addVar(/*lb=*/0, /*ub=*/GRB_INFINITY,
+                          /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
+                          /*name=*/);
+      w[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
+                          /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
+                          /*name=*/);
+      u[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
+                          /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
+                          /*name=*/);
+      s[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
+                          /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
+                          /*name=*/);
+      t[i] = model.addVar(/*lb=*/-GRB_INFINITY, /*ub=*/GRB_INFINITY,
+                          /*obj=*/0.0, /*type=*/GRB_CONTINUOUS
+                          /*name=*/);
+      obj += f[i];
+    }
+
+    model.setObjective(obj, GRB_MINIMIZE);
+
+    for (unsigned i = 0; i < n; ++i) {
+      model.addQConstr(f[i] * f[i] >= w[i] * w[i] + u[i] * u[i]);
+      // The circle data is only set in `set_circles`. The zeros are just
+      // placeholders.
+      disk_constraints[i] =
+          model.addQConstr(s[i] * s[i] + t[i] * t[i], GRB_LESS_EQUAL, 0.0);
+      // s[i] == cx - x[i] and t[i] == cy - y[i]
+      x_constraints[i] = model.addConstr(s[i] + x[i], GRB_EQUAL, 0.0);
+      y_constraints[i] = model.addConstr(t[i] + y[i], GRB_EQUAL, 0.0);
+    }
+
+    for (unsigned i = 0; i < n; ++i) {
+      if (path && i == 0) {
+        model.addConstr(w[i] == 0);
+        model.addConstr(u[i] == 0);
+      } else {
+        const auto prev_c = (i == 0 ? n - 1 : i - 1);
+        model.addConstr(w[i] == x[prev_c] - x[i]);
+        model.addConstr(u[i] == y[prev_c] - y[i]);
+      }
+    }
+  }
+
+  /**
+   * The hitting point is only given by its offset (s, t) to the center, so
+   * x and y and their linking constraints are eliminated and the centers
+   * move into the right hand sides of the segment constraints. The segment
+   * vector (w, u) has to stay, as Gurobi only accepts cones over variables.
+   * A path has no segment into its first circle. This results in five
+   * variables and four constraints per circle, with everything but the
+   * quadratic constraints added in bulk.
+   */
+  void build_lean(const bool path) {
+    const unsigned first = path ? 1 : 0;
+    const unsigned m = n - first; // number of segments
+    const std::vector<double> free_lb(n, -GRB_INFINITY);
+    const std::vector<double> ones(m, 1.0);
+    auto take = [](GRBVar *vars, const unsigned count) {
+      std::vector<GRBVar> result(vars, vars + count);
+      delete[] vars;
+      return result;
+    };
+    s = take(model.addVars(free_lb.data(), nullptr, nullptr, nullptr, nullptr,
+                           static_cast<int>(n)),
+             n);
+    t = take(model.addVars(free_lb.data(), nullptr, nullptr, nullptr, nullptr,
+                           static_cast<int>(n)),
+             n);
+    // The objective is set directly via the coefficients of f.
+    f = take(model.addVars(nullptr, nullptr, ones.data(), nullptr, nullptr,
+                           static_cast<int>(m)),
+             m);
+    w = take(model.addVars(free_lb.data(), nullptr, nullptr, nullptr, nullptr,
+                           static_cast<int>(m)),
+             m);
+    u = take(model.addVars(free_lb.data(), nullptr, nullptr, nullptr, nullptr,
+                           static_cast<int>(m)),
+             m);
+
+    // w[k] == x[prev] - x[i] == s[prev] - s[i] + (cx[prev] - cx[i])
+    std::vector<GRBLinExpr> lhs(2 * m);
+    for (unsigned k = 0; k < m; ++k) {
+      const unsigned i = k + first;
+      const unsigned prev = (i + n - 1) % n;
+      lhs[k] = w[k] - s[prev] + s[i];
+      lhs[m + k] = u[k] - t[prev] + t[i];
+    }
+    // The circle data is only set in `set_circles`.
+    const std::vector<char> senses(2 * m, GRB_EQUAL);
+    const std::vector<double> rhs(2 * m, 0.0);
+    GRBConstr *constraints = model.addConstrs(
+        lhs.data(), senses.data(), rhs.data(), nullptr, static_cast<int>(2 * m));
+    x_constraints.assign(constraints, constraints + m);
+    y_constraints.assign(constraints + m, constraints + 2 * m);
+    delete[] constraints;
+
+    // The C++ API has no bulk version for quadratic constraints.
+    for (unsigned k = 0; k < m; ++k) {
+      model.addQConstr(f[k] * f[k] >= w[k] * w[k] + u[k] * u[k]);
+    }
+    disk_constraints.resize(n);
+    for (unsigned i = 0; i < n; ++i) {
+      disk_constraints[i] =
+          model.addQConstr(s[i] * s[i] + t[i] * t[i], GRB_LESS_EQUAL, 0.0);
+    }
+  }
+
+  static void check_status(const int status, const bool allow_suboptimal) {
+    if (status != GRB_OPTIMAL &&
+        !(allow_suboptimal && status == GRB_SUBOPTIMAL)) {
+      throw std::runtime_error(
+          "Gurobi could not solve the SOCP of the trajectory (status " +
+          std::to_string(status) + ").");
+    }
+  }
+
+  std::pair<Trajectory, std::vector<bool>>
+  get_solution(const std::vector<Circle> &circle_sequence, const bool path) {
+    constexpr auto SPANNING_TOLERANCE = 0.01;
+    std::vector<Point> points;
+    points.reserve(n + 1);
+    std::vector<bool> spanning_circles(n);
+    for (unsigned i = 0; i < n; i++) {
+      const auto si = s[i].get(GRB_DoubleAttr_X);
+      const auto ti = t[i].get(GRB_DoubleAttr_X);
+      if (formulation == Formulation::LEAN) {
+        const auto &c = circle_sequence[i].center;
+        points.emplace_back(c.x + si, c.y + ti);
+      } else {
+        points.emplace_back(x[i].get(GRB_DoubleAttr_X),
+                            y[i].get(GRB_DoubleAttr_X));
+      }
+      const auto r = circle_sequence[i].radius;
+      bool is_spanning =
+          std::sqrt(si * si + ti * ti) >= (1 - SPANNING_TOLERANCE) * r;
+      spanning_circles[i] = is_spanning;
+    }
+    if (!path) {
+      points.push_back(points[0]);
+    }
+    return {Trajectory(points), spanning_circles};
+  }
+
+  static constexpr double DEFAULT_CONVERGENCE_TOLERANCE = 1e-6; // of Gurobi
+  static constexpr double LOOSE_CONVERGENCE_TOLERANCE = 1e-3;
+
+  GRBModel model;
+  unsigned n;
+  Formulation formulation;
+  std::vector<GRBVar> x, y, f, w, u, s, t; // x and y only if standard
+  // The constraints with the circle centers in the right hand side.
+  std::vector<GRBConstr> x_constraints, y_constraints;
+  std::vector<GRBQConstr> disk_constraints;
+};
+
+/**
+ * Keeps already built models for reuse. A model is taken out of the pool
+ * for the time of a solve, such that every concurrently solving thread works
+ * on its own model. Thus, the pool holds at most one model per worker thread
+ * and key. The pool survives the threads, which is important as the child
+ * evaluation creates new threads for every branch.
+ */
+class TrajectoryModelPool {
+public:
+  using Formulation = TrajectoryModel::Formulation;
+  // (number of circles, path, formulation)
+  using Key = std::tuple<unsigned, bool, Formulation>;
+
+  std::unique_ptr<TrajectoryModel> acquire(GRBEnv &env, const unsigned n,
+                                           const bool path,
+                                           const Formulation formulation) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto &models = free_models[{n, path, formulation}];
+      if (!models.empty()) {
+        auto model = std::move(models.back());
+        models.pop_back();
+        num_pooled -= 1;
+        return model;
+      }
+    }
+    // Building the model does not need the lock.
+    return std::make_unique<TrajectoryModel>(env, n, path, formulation);
+  }
+
+  void release(const unsigned n, const bool path,
+               const Formulation formulation,
+               std::unique_ptr<TrajectoryModel> &&model) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (num_pooled >= MAX_POOLED_MODELS) {
+      return; // just let the model be deleted to bound the memory.
+    }
+    free_models[{n, path, formulation}].push_back(std::move(model));
+    num_pooled += 1;
+  }
+
+private:
+  static constexpr size_t MAX_POOLED_MODELS = 512;
+  std::mutex mutex;
+  std::map<Key, std::vector<std::unique_ptr<TrajectoryModel>>> free_models;
+  size_t num_pooled = 0;
+};
+
+GRBEnv &get_env() {
+  static GRBEnv env;
+  return env;
+}
+
+TrajectoryModelPool &get_model_pool() {
+  static TrajectoryModelPool pool;
+  return pool;
+}
+} // namespace
+
+std::pair<Trajectory, std::vector<bool>>
+GurobiTrajectorySolver::solve(const std::vector<Circle> &circle_sequence,
+                              bool path) {
+  auto &env = get_env();
+  auto &pool = get_model_pool();
+  const auto n = static_cast<unsigned>(circle_sequence.size());
+  auto model = pool.acquire(env, n, path, formulation);
+  auto result = model->optimize(circle_sequence, path);
+  pool.release(n, path, formulation, std::move(model));
+  return result;
+}
+
+std::vector<std::pair<Trajectory, std::vector<bool>>>
+GurobiTrajectorySolver::solve_batch(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path) {
+  auto &env = get_env();
+  auto &pool = get_model_pool();
+  // The children of a node usually all have the same length.
+  std::map<unsigned, std::unique_ptr<TrajectoryModel>> models;
+  std::vector<std::pair<Trajectory, std::vector<bool>>> results;
+  results.reserve(circle_sequences.size());
+  for (const auto &circle_sequence : circle_sequences) {
+    const auto n = static_cast<unsigned>(circle_sequence.size());
+    auto &model = models[n];
+    if (!model) {
+      model = pool.acquire(env, n, path, formulation);
+    }
+    results.push_back(model->optimize(circle_sequence, path));
+  }
+  for (auto &[n, model] : models) {
+    pool.release(n, path, formulation, std::move(model));
+  }
+  return results;
+}
+
+namespace {
+std::vector<CutoffSolution>
+solve_batch_with_gurobi(const std::vector<std::vector<Circle>> &circle_sequences,
+                        const bool path, const double cutoff, const bool loose,
+                        const GurobiTrajectorySolver::Formulation formulation) {
+  auto &env = get_env();
+  auto &pool = get_model_pool();
+  std::map<unsigned, std::unique_ptr<TrajectoryModel>> models;
+  std::vector<CutoffSolution> results;
+  results.reserve(circle_sequences.size());
+  for (const auto &circle_sequence : circle_sequences) {
+    const auto n = static_cast<unsigned>(circle_sequence.size());
+    auto &model = models[n];
+    if (!model) {
+      model = pool.acquire(env, n, path, formulation);
+    }
+    results.push_back(model->optimize(circle_sequence, path, cutoff, loose));
+  }
+  for (auto &[n, model] : models) {
+    pool.release(n, path, formulation, std::move(model));
+  }
+  return results;
+}
+} // namespace
+
+std::vector<CutoffSolution> GurobiTrajectorySolver::solve_batch_with_cutoff(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path,
+    const double cutoff) {
+  return solve_batch_with_gurobi(circle_sequences, path, cutoff, false,
+                                 formulation);
+}
+
+std::vector<CutoffSolution> GurobiTrajectorySolver::solve_batch_loosely(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path,
+    const double cutoff) {
+  return solve_batch_with_gurobi(circle_sequences, path, cutoff, true,
+                                 formulation);
+}
+#endif
+
+namespace {
+std::shared_ptr<TrajectorySolver> &trajectory_solver() {
+#ifndef CETSP_WITHOUT_GUROBI
+  static std::shared_ptr<TrajectorySolver> solver =
+      std::make_shared<GurobiTrajectorySolver>();
+#else
+  static std::shared_ptr<TrajectorySolver> solver =
+      std::make_shared<NativeTrajectorySolver>();
+#endif
+  return solver;
+}
+} // namespace
+
+void set_trajectory_solver(std::shared_ptr<TrajectorySolver> solver) {
+  std::atomic_store(&trajectory_solver(), std::move(solver));
+}
+
+std::shared_ptr<TrajectorySolver> get_trajectory_solver() {
+  return std::atomic_load(&trajectory_solver());
+}
+
+std::pair<Trajectory, std::vector<bool>>
+compute_trajectory_with_information(const std::vector<Circle> &circle_sequence,
+                                    bool path) {
+  if (auto small = details::compute_small_trajectory(circle_sequence, path)) {
+    return std::move(*small);
+  }
+  return get_trajectory_solver()->solve(circle_sequence, path);
 }
 
 Trajectory compute_tour(const std::vector<Circle> &circle_sequence,
                         const bool path) {
   return compute_trajectory_with_information(circle_sequence, path).first;
 }
+
+namespace {
+/**
+ * Segments without length have no direction, and any direction in the unit
+ * ball gives a valid bound. However, only the right ones give a tight bound.
+ * If the hitting points of the circles `first` to `last` coincide, the
+ * change of the direction from `in` (the last segment before) to `out` (the
+ * first segment after) has to be distributed on these circles, such that
+ * every circle only takes a change against its outer normal at the hitting
+ * point. We try every single circle and every pair of touched circles and
+ * take the best bound.
+ * @return The directions of the segments first+1, ..., last.
+ */
+std::vector<Point> distribute_direction_change(
+    const std::vector<Circle> &circle_sequence,
+    const std::vector<Point> &hitting_points, const int first, const int last,
+    const Point &in, const Point &out, const Point &origin) {
+  const int n = static_cast<int>(circle_sequence.size());
+  const int k = last - first + 1; // number of circles
+  const Point delta{in.x - out.x, in.y - out.y};
+  auto circle = [&](const int j) -> const Circle & {
+    return circle_sequence[(first + j) % n];
+  };
+  auto contribution = [&](const int j, const Point &g) {
+    const auto &c = circle(j);
+    return g.x * (c.center.x - origin.x) + g.y * (c.center.y - origin.y) -
+           c.radius * std::sqrt(g.x * g.x + g.y * g.y);
+  };
+  // negative outer normals of the touched circles
+  std::vector<std::pair<int, Point>> normals;
+  for (int j = 0; j < k && normals.size() < 16; ++j) {
+    const auto &c = circle(j);
+    const auto &p = hitting_points[(first + j) % n];
+    const double d = c.center.dist(p);
+    if (d > 0 && d >= (1 - 1e-6) * c.radius) {
+      normals.emplace_back(j, Point{(c.center.x - p.x) / d,
+                                    (c.center.y - p.y) / d});
+    }
+  }
+  // best assignment as (value, j1, g1, j2, g2)
+  int best_j1 = 0, best_j2 = -1;
+  Point best_g1 = delta, best_g2{0, 0};
+  double best = -std::numeric_limits<double>::infinity();
+  for (int j = 0; j < k; ++j) {
+    const double value = contribution(j, delta);
+    if (value > best) {
+      best = value;
+      best_j1 = j;
+      best_g1 = delta;
+      best_j2 = -1;
+    }
+  }
+  for (size_t u = 0; u < normals.size(); ++u) {
+    for (size_t v = u + 1; v < normals.size(); ++v) {
+      const auto &a = normals[u].second;
+      const auto &b = normals[v].second;
+      const double det = a.x * b.y - a.y * b.x;
+      if (std::abs(det) < 1e-12) {
+        continue;
+      }
+      const double alpha = (delta.x * b.y - delta.y * b.x) / det;
+      const double beta = (a.x * delta.y - a.y * delta.x) / det;
+      if (alpha < 0 || beta < 0) {
+        continue;
+      }
+      const Point g1{alpha * a.x, alpha * a.y};
+      const Point g2{beta * b.x, beta * b.y};
+      // The direction between the two circles has to stay in the unit ball.
+      const Point between{in.x - g1.x, in.y - g1.y};
+      if (between.x * between.x + between.y * between.y > 1) {
+        continue;
+      }
+      const double value = contribution(normals[u].first, g1) +
+                           contribution(normals[v].first, g2);
+      if (value > best) {
+        best = value;
+        best_j1 = normals[u].first;
+        best_g1 = g1;
+        best_j2 = normals[v].first;
+        best_g2 = g2;
+      }
+    }
+  }
+  std::vector<Point> directions;
+  directions.reserve(k - 1);
+  Point current = in;
+  for (int j = 0; j + 1 < k; ++j) {
+    if (j == best_j1) {
+      current = {current.x - best_g1.x, current.y - best_g1.y};
+    } else if (j == best_j2) {
+      current = {current.x - best_g2.x, current.y - best_g2.y};
+    }
+    directions.push_back(current);
+  }
+  return directions;
+}
+} // namespace
+
+double compute_trajectory_lower_bound(const std::vector<Circle> &circle_sequence,
+                                      const std::vector<Point> &hitting_points,
+                                      const bool path) {
+  // Every choice of directions l_i with ||l_i|| <= 1 for the segments gives
+  // the lower bound
+  //   sum_i ||p_i - p_{i-1}|| >= sum_i l_i * (p_i - p_{i-1})
+  //                           = sum_i p_i * (l_i - l_{i+1})
+  //                          >= sum_i min_{p in D_i} p * (l_i - l_{i+1}).
+  // The segment i goes from p_{i-1} to p_i. A path has no segment 0 and n,
+  // which is the same as the direction 0.
+  const int n = static_cast<int>(circle_sequence.size());
+  assert(hitting_points.size() == circle_sequence.size());
+  if (n == 0) {
+    return 0.0;
+  }
+  const Point &origin = hitting_points[0]; // reduces cancellation
+  double total_length = 0.0;
+  for (int i = path ? 1 : 0; i < n; ++i) {
+    total_length += hitting_points[i == 0 ? n - 1 : i - 1].dist(hitting_points[i]);
+  }
+  const double min_length = 1e-9 * total_length;
+  std::vector<Point> directions(n + 1, Point{0, 0});
+  std::vector<bool> defined(n + 1, path);
+  for (int i = path ? 1 : 0; i < n; ++i) {
+    const auto &a = hitting_points[i == 0 ? n - 1 : i - 1];
+    const auto &b = hitting_points[i];
+    const double length = a.dist(b);
+    defined[i] = length > min_length;
+    if (defined[i]) {
+      directions[i] = {(b.x - a.x) / length, (b.y - a.y) / length};
+    }
+  }
+  // Fill the runs of undefined directions. For a tour, we start after some
+  // defined direction. If there is none, the tour is a point and all
+  // directions are zero.
+  const int m = path ? n + 1 : n; // number of directions
+  int start = 0;
+  while (start < m && !defined[start]) {
+    ++start;
+  }
+  if (start < m) {
+    for (int i = 1; i < m; ++i) {
+      const int a = (start + i - 1) % m; // defined
+      if (defined[(a + 1) % m]) {
+        continue;
+      }
+      int b = a + 1; // the next defined direction (unwrapped)
+      while (!defined[b % m]) {
+        ++b;
+      }
+      // circles a, ..., b-1 share the hitting point
+      auto filled = distribute_direction_change(
+          circle_sequence, hitting_points, a, b - 1, directions[a],
+          directions[b % m], origin);
+      for (int j = a + 1; j < b; ++j) {
+        directions[j % m] = filled[j - a - 1];
+        defined[j % m] = true;
+      }
+      i = b - start - 1;
+      if (b - start >= m) {
+        break;
+      }
+    }
+  }
+  if (!path) {
+    directions[n] = directions[0];
+  }
+  double bound = 0.0;
+  for (int i = 0; i < n; ++i) {
+    const auto &circle = circle_sequence[i];
+    const double gx = directions[i].x - directions[i + 1].x;
+    const double gy = directions[i].y - directions[i + 1].y;
+    bound += gx * (circle.center.x - origin.x) +
+             gy * (circle.center.y - origin.y) -
+             circle.radius * std::sqrt(gx * gx + gy * gy);
+  }
+  return bound;
+}
+
+namespace {
+/**
+ * Re-optimizes only the hitting points of the circles at distance at most
+ * `window` to `inserted_at`. The rest is fixed to the hitting points of the
+ * parent. The first and last circle of the window are fixed to the parent's
+ * points and are connected by a path through the free circles.
+ */
+class TrajectoryWindow {
+public:
+  TrajectoryWindow(const std::vector<Circle> &circle_sequence, const bool path,
+                   const details::ParentTrajectory &parent,
+                   const int inserted_at, const int window)
+      : circle_sequence{circle_sequence}, path{path}, parent{parent},
+        inserted_at{inserted_at},
+        n{static_cast<int>(circle_sequence.size())} {
+    left = inserted_at - window - 1;
+    right = inserted_at + window + 1;
+    if (path) {
+      left = std::max(left, 0);
+      right = std::min(right, n - 1);
+    }
+  }
+
+  /**
+   * The first window for a sequence of `n` circles. It frees at most half
+   * of the sequence, such that also short sequences are tried.
+   */
+  static int get_initial_window(const int n) {
+    constexpr int MAX_INITIAL_WINDOW = 4;
+    return std::clamp((n / 2 - 1) / 2, 0, MAX_INITIAL_WINDOW);
+  }
+
+  /**
+   * False if the window is too large to be worth it or if the insertion
+   * cannot be handled.
+   */
+  [[nodiscard]] bool is_valid() const {
+    if (path && (inserted_at == 0 || inserted_at == n - 1)) {
+      return false; // the endpoints of a path cannot be moved
+    }
+    return right - left - 1 <= n / 2;
+  }
+
+  /**
+   * True if all circles that are not fixed anyway are free, such that a
+   * larger window would not change anything. Only possible for short
+   * sequences, as the window is limited to half of the sequence.
+   */
+  [[nodiscard]] bool is_complete() const {
+    if (path) {
+      return left == 0 && right == n - 1;
+    }
+    return right - left - 1 >= n - 1;
+  }
+
+  [[nodiscard]] std::vector<Circle> get_circles() const {
+    std::vector<Circle> window_circles;
+    window_circles.reserve(right - left + 1);
+    window_circles.emplace_back(parent_point(index(left)), 0);
+    for (int i = left + 1; i < right; ++i) {
+      window_circles.push_back(circle_sequence[index(i)]);
+    }
+    window_circles.emplace_back(parent_point(index(right)), 0);
+    return window_circles;
+  }
+
+  /**
+   * Combines the solution of the window with the parent's trajectory.
+   * @param loose Accept a larger gap to the lower bound, which is returned
+   * instead of the length.
+   * @return The trajectory if it is proved to be optimal, and the lower bound
+   * of the combined trajectory in any case.
+   */
+  CutoffSolution combine(const std::pair<Trajectory, std::vector<bool>> &local,
+                         const bool loose) const {
+    constexpr double TOLERANCE = 1e-6;       // relative
+    constexpr double LOOSE_TOLERANCE = 1e-4; // relative
+    std::vector<Point> points;
+    points.reserve(n + 1);
+    std::vector<bool> spanning(n);
+    for (int i = 0; i < n; ++i) {
+      if (i != inserted_at) {
+        points.push_back(parent_point(i));
+        spanning[i] = parent.spanning[i < inserted_at ? i : i - 1];
+      } else {
+        points.push_back(circle_sequence[i].center); // overwritten below
+      }
+    }
+    for (int i = left + 1; i < right; ++i) {
+      points[index(i)] = local.first.points[i - left];
+      spanning[index(i)] = local.second[i - left];
+    }
+    const double lb =
+        compute_trajectory_lower_bound(circle_sequence, points, path);
+    if (!path) {
+      points.push_back(points[0]);
+    }
+    Trajectory trajectory(std::move(points));
+    const double length = trajectory.length();
+    if (length - lb > (loose ? LOOSE_TOLERANCE : TOLERANCE) * length) {
+      return {{}, lb};
+    }
+    return {std::make_pair(std::move(trajectory), std::move(spanning)),
+            loose ? std::min(lb, length) : length, true};
+  }
+
+private:
+  [[nodiscard]] int index(const int i) const { return ((i % n) + n) % n; }
+
+  [[nodiscard]] const Point &parent_point(const int i) const {
+    return parent.hitting_points[i < inserted_at ? i : i - 1];
+  }
+
+  const std::vector<Circle> &circle_sequence;
+  bool path;
+  const details::ParentTrajectory &parent;
+  int inserted_at;
+  int n;
+  int left, right;
+};
+
+bool is_compatible(const std::vector<Circle> &circle_sequence,
+                   const details::ParentTrajectory *parent) {
+  return parent != nullptr &&
+         parent->hitting_points.size() + 1 == circle_sequence.size() &&
+         parent->spanning.size() == parent->hitting_points.size();
+}
+} // namespace
+
+std::vector<std::pair<Trajectory, std::vector<bool>>>
+compute_trajectories_with_information(
+    const std::vector<std::vector<Circle>> &circle_sequences, bool path) {
+  std::vector<std::optional<std::pair<Trajectory, std::vector<bool>>>> results;
+  results.reserve(circle_sequences.size());
+  std::vector<size_t> remaining;
+  std::vector<std::vector<Circle>> remaining_sequences;
+  for (size_t i = 0; i < circle_sequences.size(); ++i) {
+    results.push_back(
+        details::compute_small_trajectory(circle_sequences[i], path));
+    if (!results.back()) {
+      remaining.push_back(i);
+      remaining_sequences.push_back(circle_sequences[i]);
+    }
+  }
+  if (!remaining.empty()) {
+    auto solved =
+        get_trajectory_solver()->solve_batch(remaining_sequences, path);
+    for (size_t j = 0; j < remaining.size(); ++j) {
+      results[remaining[j]] = std::move(solved[j]);
+    }
+  }
+  std::vector<std::pair<Trajectory, std::vector<bool>>> solutions;
+  solutions.reserve(results.size());
+  for (auto &result : results) {
+    solutions.push_back(std::move(*result));
+  }
+  return solutions;
+}
+
+std::vector<std::pair<Trajectory, std::vector<bool>>>
+compute_trajectories_incrementally(
+    const std::vector<std::vector<Circle>> &circle_sequences, const bool path,
+    const std::vector<const details::ParentTrajectory *> &parents,
+    const std::vector<int> &inserted_at) {
+  auto results = compute_trajectories_incrementally(
+      circle_sequences, path, parents, inserted_at,
+      std::numeric_limits<double>::infinity());
+  std::vector<std::pair<Trajectory, std::vector<bool>>> solutions;
+  solutions.reserve(results.size());
+  for (auto &result : results) {
+    solutions.push_back(std::move(*result.solution));
+  }
+  return solutions;
+}
+
+std::vector<CutoffSolution> compute_trajectories_incrementally(
+    const std::vector<std::vector<Circle>> &circle_sequences, const bool path,
+    const std::vector<const details::ParentTrajectory *> &parents,
+    const std::vector<int> &inserted_at, const double cutoff,
+    const bool loose) {
+  assert(parents.size() == circle_sequences.size() &&
+         inserted_at.size() == circle_sequences.size());
+  auto solver = get_trajectory_solver();
+  const auto k = circle_sequences.size();
+  std::vector<std::optional<CutoffSolution>> results(k);
+  std::vector<size_t> pending;
+  std::vector<int> window(k); // the current window of each sequence
+  for (size_t i = 0; i < k; ++i) {
+    if (is_compatible(circle_sequences[i], parents[i])) {
+      pending.push_back(i);
+      window[i] = TrajectoryWindow::get_initial_window(
+          static_cast<int>(circle_sequences[i].size()));
+    }
+  }
+  // All sequences of a stage are solved as a batch. The ones that cannot be
+  // proved to be optimal are tried again with a doubled window, unless their
+  // bound already exceeds the cutoff or the window cannot grow anymore.
+  while (!pending.empty()) {
+    std::vector<TrajectoryWindow> windows;
+    std::vector<size_t> in_stage;
+    for (auto i : pending) {
+      TrajectoryWindow w(circle_sequences[i], path, *parents[i],
+                         inserted_at[i], window[i]);
+      window[i] = std::max(1, 2 * window[i]);
+      if (w.is_valid()) {
+        windows.push_back(std::move(w));
+        in_stage.push_back(i);
+      }
+    }
+    if (windows.empty()) {
+      break;
+    }
+    std::vector<std::vector<Circle>> window_circles;
+    window_circles.reserve(windows.size());
+    for (const auto &w : windows) {
+      window_circles.push_back(w.get_circles());
+    }
+    std::vector<std::pair<Trajectory, std::vector<bool>>> local;
+    if (loose) {
+      for (auto &result : solver->solve_batch_loosely(
+               window_circles, true, std::numeric_limits<double>::infinity())) {
+        local.push_back(std::move(*result.solution));
+      }
+    } else {
+      local = solver->solve_batch(window_circles, true);
+    }
+    pending.clear();
+    for (size_t j = 0; j < windows.size(); ++j) {
+      auto combined = windows[j].combine(local[j], loose);
+      if (combined.solution || combined.lower_bound > cutoff) {
+        results[in_stage[j]] = std::move(combined);
+      } else if (!windows[j].is_complete()) {
+        pending.push_back(in_stage[j]);
+      }
+    }
+  }
+  // Everything else is solved completely.
+  std::vector<size_t> remaining;
+  std::vector<std::vector<Circle>> remaining_sequences;
+  for (size_t i = 0; i < k; ++i) {
+    if (results[i]) {
+      continue;
+    }
+    if (auto small =
+            details::compute_small_trajectory(circle_sequences[i], path)) {
+      const double length = small->first.length();
+      results[i] = CutoffSolution{std::move(*small), length};
+      continue;
+    }
+    remaining.push_back(i);
+    remaining_sequences.push_back(circle_sequences[i]);
+  }
+  if (!remaining.empty()) {
+    auto full =
+        loose ? solver->solve_batch_loosely(remaining_sequences, path, cutoff)
+              : solver->solve_batch_with_cutoff(remaining_sequences, path,
+                                                cutoff);
+    for (size_t j = 0; j < remaining.size(); ++j) {
+      results[remaining[j]] = std::move(full[j]);
+    }
+  }
+  std::vector<CutoffSolution> solutions;
+  solutions.reserve(k);
+  for (auto &result : results) {
+    solutions.push_back(std::move(*result));
+  }
+  return solutions;
+}
+
+std::pair<Trajectory, std::vector<bool>>
+compute_trajectory_incrementally(const std::vector<Circle> &circle_sequence,
+                                 const bool path,
+                                 const details::ParentTrajectory &parent,
+                                 const int inserted_at) {
+  return std::move(compute_trajectories_incrementally(
+      {circle_sequence}, path, {&parent}, {inserted_at})[0]);
+}
+
+#ifndef CETSP_WITHOUT_GUROBI
+namespace details {
+std::pair<Trajectory, std::vector<bool>> compute_trajectory_with_new_model(
+    const std::vector<Circle> &circle_sequence, bool path,
+    GurobiTrajectorySolver::Formulation formulation) {
+  TrajectoryModel model(get_env(), circle_sequence.size(), path, formulation);
+  return model.optimize(circle_sequence, path);
+}
+
+TrajectoryModelMeasurement
+measure_trajectory_model(const std::vector<Circle> &circle_sequence,
+                         bool path,
+                         GurobiTrajectorySolver::Formulation formulation) {
+  using namespace std::chrono;
+  auto &env = get_env();
+  const auto start = steady_clock::now();
+  TrajectoryModel model(env, circle_sequence.size(), path, formulation);
+  model.get_model().update(); // Gurobi builds the model lazily
+  const auto built = steady_clock::now();
+  auto solution = model.optimize(circle_sequence, path);
+  const auto solved = steady_clock::now();
+  auto &grb_model = model.get_model();
+  return {grb_model.get(GRB_IntAttr_NumVars),
+          grb_model.get(GRB_IntAttr_NumConstrs),
+          grb_model.get(GRB_IntAttr_NumQConstrs),
+          duration<double, std::micro>(built - start).count(),
+          duration<double, std::micro>(solved - built).count(),
+          std::move(solution)};
+}
+} // namespace details
+#endif
 } // namespace cetsp
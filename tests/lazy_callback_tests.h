@@ -18,11 +18,13 @@ class LazyCB : public cetsp::B2BNodeCallback {
 public:
   LazyCB(std::vector<cetsp::Circle> circles) : circles{std::move(circles)} {}
   virtual void add_lazy_constraints(cetsp::EventContext &e) {
-    for (auto &c : circles) {
-      if (!e.get_relaxed_solution().get_trajectory().covers(c, 0.001)) {
+    const auto distances =
+        e.get_relaxed_solution().get_trajectory().distances(circles);
+    for (size_t i = 0; i < circles.size(); ++i) {
+      if (distances[i] > 0.001) {
         // it is stupid to just add a random  circle, but fine enough for
         // testing.
-        e.add_lazy_circle(c);
+        e.add_lazy_circle(circles[i]);
         std::cout << "Add circle." << std::endl;
         return;
       }
@@ -57,4 +59,25 @@ TEST_CASE("Lazy Callback") {
   CHECK(bnb.get_lower_bound() >= 39.0);
 }
 
+TEST_CASE("Lazy Callback Parallel") {
+  std::vector<cetsp::Circle> circles;
+  for (double x = 0; x <= 10; x += 2.0) {
+    for (double y = 0; y <= 10; y += 2.0) {
+      circles.push_back({{x, y}, 1});
+    }
+  }
+  cetsp::Instance instance(cetsp::Instance(
+      {{{0, 0}, 1}, {{10, 0}, 1}, {{10, 10}, 1}, {{0, 10}, 1}}));
+  cetsp::ConvexHullRoot root_node_strategy{};
+  cetsp::FarthestCircle branching_strategy{true, 8};
+  cetsp::DfsBfs search_strategy;
+  cetsp::BranchAndBoundAlgorithm bnb(&instance,
+                                     root_node_strategy.get_root_node(instance),
+                                     branching_strategy, search_strategy);
+  bnb.add_node_callback(std::make_unique<LazyCB>(circles));
+  // the workers share the instance, so the circles cannot be added
+  CHECK_THROWS(bnb.optimize_parallel(30, 4, 0.01));
+  CHECK(instance.size() == 4);
+}
+
 #endif // CETSP_LAZY_CALLBACK_TESTS_H
@@ -2,7 +2,16 @@
 #include "./lazy_callback_tests.h"
 #include "cetsp/bnb.h"
 #include "cetsp/common.h"
+#include "cetsp/details/circle_grid.h"
 #include "cetsp/details/convex_hull_order.h"
+#include "cetsp/details/incremental_coverage.h"
+#include "cetsp/details/insertion_bound.h"
+#include "cetsp/details/slab_allocator.h"
+#include "cetsp/details/sequence_record.h"
+#include "cetsp/details/open_node_budget.h"
+#include "cetsp/details/open_node_purge.h"
+#include "cetsp/details/lower_bound_tracker.h"
+#include "cetsp/details/transposition_table.h"
 #include "cetsp/heuristics.h"
 #include "cetsp/node.h"
 #include "cetsp/relaxed_solution.h"
@@ -12,6 +21,10 @@
 #include "cetsp/strategies/rules/global_convex_hull_rule.h"
 #include "cetsp/strategies/search_strategy.h"
 #include "cetsp/utils/geometry.h"
-#include "cetsp/details/missing_disks_lb.h"
+#include "cetsp/utils/segment_bvh.h"
+#include "cetsp/utils/thread_pool.h"
 #include "doctest/doctest.h"
+#ifndef CETSP_WITHOUT_GUROBI
+#include "cetsp/details/missing_disks_lb.h"
+#endif
 